@@ -0,0 +1,322 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QDirIterator>
+#include "converter.h"
+#include "tools/concurrency.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// ---------------
+// transformations
+// ---------------
+
+channels_t remap(const channel_map_t<channels_t>& mapping, channels_t channels) {
+    channels_t result;
+    for (channel_t channel : channels)
+        result |= mapping[channel];
+    return result;
+}
+
+/// absolute ticks of each event, tracks are merged keeping their relative order on ties
+StandardMidiFile::track_type mergeTracks(StandardMidiFile::container_type& tracks) {
+    std::vector<std::pair<uint64_t, Event>> items;
+    uint64_t lastTimestamp = 0;
+    for (auto& track : tracks) {
+        uint64_t timestamp = 0;
+        for (auto& item : track) {
+            timestamp += item.first;
+            if (item.second.is(family_t::end_of_track))
+                lastTimestamp = std::max(lastTimestamp, timestamp);
+            else
+                items.emplace_back(timestamp, std::move(item.second));
+        }
+    }
+    std::stable_sort(items.begin(), items.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    StandardMidiFile::track_type result;
+    result.reserve(items.size() + 1);
+    uint64_t timestamp = 0;
+    for (auto& item : items) {
+        result.emplace_back(static_cast<uint32_t>(item.first - timestamp), std::move(item.second).with_track(0));
+        timestamp = item.first;
+    }
+    result.emplace_back(static_cast<uint32_t>(std::max(lastTimestamp, timestamp) - timestamp), Event::end_of_track());
+    return result;
+}
+
+/// conductor track for non-voice events followed by one track per channel
+StandardMidiFile::container_type splitTracks(StandardMidiFile::track_type track) {
+    std::array<StandardMidiFile::track_type, channels_t::capacity() + 1> tracks;
+    std::array<uint64_t, channels_t::capacity() + 1> lastTimestamps {};
+    uint64_t timestamp = 0;
+    for (auto& item : track) {
+        timestamp += item.first;
+        if (item.second.is(family_t::end_of_track))
+            continue;
+        size_t index = 0;
+        if (item.second.is(families_t::standard_voice()) && item.second.channels())
+            index = 1 + *item.second.channels().begin();
+        tracks[index].emplace_back(static_cast<uint32_t>(timestamp - lastTimestamps[index]), std::move(item.second));
+        lastTimestamps[index] = timestamp;
+    }
+    StandardMidiFile::container_type result;
+    for (size_t index=0 ; index < tracks.size() ; ++index) {
+        if (index != 0 && tracks[index].empty())
+            continue;
+        const auto trackNumber = static_cast<track_t>(result.size());
+        for (auto& item : tracks[index])
+            item.second.set_track(trackNumber);
+        tracks[index].emplace_back(static_cast<uint32_t>(timestamp - lastTimestamps[index]), Event::end_of_track());
+        result.push_back(std::move(tracks[index]));
+    }
+    return result;
+}
+
+StandardMidiFile::track_type makeTrack(const TimedEvents& events, track_t track) {
+    StandardMidiFile::track_type result;
+    result.reserve(events.size() + 1);
+    timestamp_t timestamp = 0.;
+    for (const auto& item : events) {
+        result.emplace_back(decay_value<uint32_t>(item.timestamp - timestamp), Event{item.event}.with_track(track));
+        timestamp = item.timestamp;
+    }
+    result.emplace_back(0, Event::end_of_track());
+    return result;
+}
+
+void processSequence(Sequence& sequence, const ConverterOptions& options) {
+    bool clockChanged = false;
+    for (auto& item : sequence) {
+        if (options.tempoFactor != 1. && item.event.is(family_t::tempo)) {
+            item.event = Event::tempo(extraction_ns::get_bpm(item.event) * options.tempoFactor).with_track(item.event.track());
+            clockChanged = true;
+        } else if (item.event.is(families_t::standard_voice())) {
+            item.event.set_channels(remap(options.mapping, item.event.channels()));
+        }
+    }
+    if (clockChanged)
+        sequence.update_clock();
+}
+
+/// tracks are already filtered, the metronome is added before merging so that format 0 keeps it
+void processFile(StandardMidiFile& file, const Sequence& sequence, const ConverterOptions& options) {
+    if (options.format == StandardMidiFile::simultaneous_format && file.tracks.size() == 1)
+        file.tracks = splitTracks(std::move(file.tracks.front()));
+    if (options.metronome)
+        file.tracks.push_back(makeTrack(sequence.make_metronome(), static_cast<track_t>(file.tracks.size())));
+    if (options.format == StandardMidiFile::single_track_format && file.tracks.size() > 1) {
+        auto track = mergeTracks(file.tracks);
+        file.tracks.clear();
+        file.tracks.push_back(std::move(track));
+    }
+    if (options.format != -1)
+        file.format = static_cast<StandardMidiFile::format_type>(options.format);
+    else if (file.tracks.size() > 1)
+        file.format = StandardMidiFile::simultaneous_format;
+}
+
+// ------------
+// command line
+// ------------
+
+bool parseTracks(const QString& text, Sequence::blacklist_type& tracks) {
+    for (const auto& token : text.split(',', QString::SkipEmptyParts)) {
+        bool ok = false;
+        const auto track = token.trimmed().toUInt(&ok);
+        if (!ok || track > std::numeric_limits<track_t>::max())
+            return false;
+        tracks.elements.insert(static_cast<track_t>(track));
+    }
+    return true;
+}
+
+/// mapping given as 'from:to' pairs of 1-based channels, e.g. '10:11,2:1'
+bool parseMapping(const QString& text, channel_map_t<channels_t>& mapping) {
+    for (const auto& token : text.split(',', QString::SkipEmptyParts)) {
+        const auto pair = token.split(':');
+        bool fromOk = false, toOk = false;
+        const auto from = pair.size() == 2 ? pair[0].toUInt(&fromOk) : 0;
+        const auto to = pair.size() == 2 ? pair[1].toUInt(&toOk) : 0;
+        if (!fromOk || !toOk || from < 1 || from > channels_t::capacity() || to < 1 || to > channels_t::capacity())
+            return false;
+        mapping[from - 1] = channels_t::wrap(static_cast<channel_t>(to - 1));
+    }
+    return true;
+}
+
+std::string toLocal(const QString& path) {
+    return path.toLocal8Bit().constData();
+}
+
+}
+
+//===========
+// Converter
+//===========
+
+ConverterOptions::ConverterOptions() {
+    for (channel_t channel=0 ; channel < channels_t::capacity() ; ++channel)
+        mapping[channel] = channels_t::wrap(channel);
+}
+
+ConverterReport convertFile(const std::string& input, const std::string& output, const ConverterOptions& options) {
+    ConverterReport report;
+    report.input = input;
+    report.output = output;
+    const auto t0 = clock_type::now();
+    auto file = dumping::read_file(input);
+    const auto t1 = clock_type::now();
+    report.readTime = t1 - t0;
+    if (file.tracks.empty()) {
+        report.error = "can't read file";
+        return report;
+    }
+    auto sequence = Sequence::from_file(std::move(file));
+    processSequence(sequence, options);
+    file = sequence.to_file(options.tracks);
+    processFile(file, sequence, options);
+    report.events = sequence.size();
+    const auto t2 = clock_type::now();
+    report.processTime = t2 - t1;
+    if (file.tracks.empty())
+        report.error = "no track left";
+    else if (dumping::write_file(file, output) == 0)
+        report.error = "can't write file";
+    report.writeTime = clock_type::now() - t2;
+    return report;
+}
+
+int runConverter(int argc, char* argv[]) {
+    QCoreApplication app{argc, argv};
+    QCoreApplication::setApplicationName("MIDILab");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Converts a midi file or a directory tree of midi files");
+    parser.addHelpOption();
+    parser.addPositionalArgument("convert", "Command selecting the batch converter");
+    parser.addPositionalArgument("input", "Midi file or directory scanned recursively");
+    parser.addPositionalArgument("output", "Output file or directory mirroring the input tree");
+    parser.addOptions({
+        {{"f", "format"}, "Output format, 0 (single track) or 1 (one track per channel if the input has a single track)", "format"},
+        {"keep-tracks", "Comma-separated list of the only tracks written", "tracks"},
+        {"strip-tracks", "Comma-separated list of tracks discarded", "tracks"},
+        {"remap", "Comma-separated list of 1-based channel pairs 'from:to'", "mapping"},
+        {"metronome", "Adds a metronome track"},
+        {"tempo", "Factor applied to all tempo changes", "factor"},
+        {{"j", "jobs"}, "Number of parallel jobs, defaults to the number of cores", "jobs"},
+    });
+    parser.process(app);
+
+    auto fail = [&](const QString& message) {
+        std::cerr << toLocal(message) << std::endl;
+        return 2;
+    };
+
+    // parse options
+    const auto arguments = parser.positionalArguments();
+    if (arguments.size() != 3)
+        return fail("expected an input and an output, see --help");
+    ConverterOptions options;
+    if (parser.isSet("format")) {
+        options.format = parser.value("format").toInt();
+        if (parser.value("format") != "0" && parser.value("format") != "1")
+            return fail("format must be 0 or 1");
+    }
+    if (parser.isSet("keep-tracks") && parser.isSet("strip-tracks"))
+        return fail("--keep-tracks and --strip-tracks are exclusive");
+    if (parser.isSet("keep-tracks")) {
+        options.tracks.is_blacklist = false;
+        if (!parseTracks(parser.value("keep-tracks"), options.tracks))
+            return fail("invalid track list");
+    }
+    if (parser.isSet("strip-tracks") && !parseTracks(parser.value("strip-tracks"), options.tracks))
+        return fail("invalid track list");
+    if (parser.isSet("remap") && !parseMapping(parser.value("remap"), options.mapping))
+        return fail("invalid channel mapping");
+    options.metronome = parser.isSet("metronome");
+    if (parser.isSet("tempo")) {
+        bool ok = false;
+        options.tempoFactor = parser.value("tempo").toDouble(&ok);
+        if (!ok || options.tempoFactor <= 0.)
+            return fail("tempo factor must be positive");
+    }
+    const auto jobs = parser.value("jobs").toUInt();
+
+    // list the files, output directories are created beforehand so that workers never race on them
+    const QFileInfo input{arguments[1]};
+    const QString output = arguments[2];
+    std::vector<std::pair<std::string, std::string>> files;
+    if (input.isDir()) {
+        const QDir inputDir{input.absoluteFilePath()};
+        QDirIterator it{inputDir.path(), QStringList{} << "*.mid" << "*.midi" << "*.kar", QDir::Files, QDirIterator::Subdirectories};
+        while (it.hasNext()) {
+            const auto path = it.next();
+            const QFileInfo target{QDir{output}.filePath(inputDir.relativeFilePath(path))};
+            if (!QDir{}.mkpath(target.absolutePath()))
+                return fail("can't create directory " + target.absolutePath());
+            files.emplace_back(toLocal(path), toLocal(target.absoluteFilePath()));
+        }
+    } else if (input.isFile()) {
+        const QFileInfo target{QFileInfo{output}.isDir() ? QDir{output}.filePath(input.fileName()) : output};
+        files.emplace_back(toLocal(input.absoluteFilePath()), toLocal(target.absoluteFilePath()));
+    } else {
+        return fail("can't find " + arguments[1]);
+    }
+
+    // convert, each report is printed as soon as its file is done
+    std::mutex reportMutex;
+    size_t failures = 0;
+    ConverterReport::duration_type busyTime {0.};
+    const auto t0 = clock_type::now();
+    {
+        TaskPool pool{jobs};
+        for (const auto& file : files) {
+            pool.submit([&, file] {
+                const auto report = convertFile(file.first, file.second, options);
+                std::lock_guard<std::mutex> guard{reportMutex};
+                busyTime += report.readTime + report.processTime + report.writeTime;
+                std::cout << std::fixed << std::setprecision(1);
+                if (report.error.empty()) {
+                    std::cout << "ok    " << report.input << " (" << report.events << " events, read " << report.readTime.count()
+                              << " ms, process " << report.processTime.count() << " ms, write " << report.writeTime.count() << " ms)" << std::endl;
+                } else {
+                    ++failures;
+                    std::cout << "error " << report.input << ": " << report.error << std::endl;
+                }
+            });
+        }
+        pool.wait();
+        std::cout << files.size() << " files converted with " << pool.size() << " jobs, " << failures << " errors" << std::endl;
+    }
+    const ConverterReport::duration_type elapsed = clock_type::now() - t0;
+    std::cout << "elapsed " << elapsed.count() << " ms, busy " << busyTime.count() << " ms" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
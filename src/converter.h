@@ -0,0 +1,66 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CONVERTER_H
+#define CONVERTER_H
+
+#include "core/sequence.h"
+
+//===========
+// Converter
+//===========
+
+/**
+ * Headless conversion of midi files, run with 'MIDILab convert [options] <input> <output>'.
+ * Each file goes through read_file, the sequence transformations and write_file,
+ * files of a directory tree are spread on a TaskPool and reported as soon as they are done.
+ */
+
+struct ConverterOptions {
+
+    ConverterOptions();
+
+    int format {-1}; /*!< 0 or 1 to force the output format, -1 keeps the format chosen by Sequence::to_file */
+    Sequence::blacklist_type tracks {true}; /*!< tracks written */
+    channel_map_t<channels_t> mapping; /*!< channels replacing each input channel */
+    bool metronome {false}; /*!< adds a metronome track, see Sequence::make_metronome */
+    double tempoFactor {1.}; /*!< applied to all tempo events */
+
+};
+
+struct ConverterReport {
+
+    using duration_type = std::chrono::duration<double, std::milli>;
+
+    std::string input;
+    std::string output;
+    std::string error; /*!< empty on success */
+    size_t events {0};
+    duration_type readTime {0.};
+    duration_type processTime {0.};
+    duration_type writeTime {0.};
+
+};
+
+ConverterReport convertFile(const std::string& input, const std::string& output, const ConverterOptions& options);
+
+int runConverter(int argc, char* argv[]); /*!< returns the process exit code */
+
+#endif // CONVERTER_H
@@ -133,9 +133,35 @@ using map_type = std::array<T, channels_t::capacity()>;
 template<size_t N>
 using array_type = std::array<channels_t, N>;
 
-// sparse map<T, channels>
+// sparse map<T, channels> with disjoint channels, entries are stored inline in order of their first channel
 template<typename T>
-using rmap_type = std::unordered_map<T, channels_t>;
+class rmap_type {
+
+public:
+    using value_type = std::pair<T, channels_t>;
+    using storage_type = std::array<value_type, channels_t::capacity()>;
+    using const_iterator = typename storage_type::const_iterator;
+
+    auto begin() const { return m_items.begin(); }
+    auto end() const { return m_items.begin() + m_size; }
+    auto size() const { return m_size; }
+    auto empty() const { return m_size == 0; }
+
+    void insert(const T& value, channels_t channels) {
+        for (size_t i=0 ; i < m_size ; ++i) {
+            if (m_items[i].first == value) {
+                m_items[i].second |= channels;
+                return;
+            }
+        }
+        m_items[m_size++] = value_type{value, channels};
+    }
+
+private:
+    storage_type m_items;
+    size_t m_size {0};
+
+};
 
 template<size_t N>
 void clear(array_type<N>& array, channels_t channels = channels_t::full()) {
@@ -180,8 +206,19 @@ void store(map_type<T>& map, channels_t channels, U value) {
 template<typename T>
 auto reverse(const map_type<T>& map, channels_t channels) {
     rmap_type<T> rmap;
+    if (!channels)
+        return rmap;
+    // fast path: all channels share the same value
+    const auto& value = map[*channels.begin()];
+    auto it = channels.begin();
+    while (it != channels.end() && map[*it] == value)
+        ++it;
+    if (it == channels.end()) {
+        rmap.insert(value, channels);
+        return rmap;
+    }
     for (channel_t c : channels)
-        rmap[map[c]].set(c);
+        rmap.insert(map[c], channels_t::wrap(c));
     return rmap;
 }
 
@@ -577,6 +614,9 @@ struct families_t : flags_t<families_t, family_t, 64> {
 
 };
 
+template<> inline auto marshall<families_t>(const families_t& families) { return marshall(families.to_integral()); }
+template<> inline auto unmarshall<families_t>(const std::string& string) { return families_t::from_integral(unmarshall<families_t::storage_type>(string)); }
+
 //=======
 // Event
 //=======
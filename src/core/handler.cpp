@@ -19,9 +19,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <limits>
 #include <sstream>
 #include <boost/optional.hpp>
 #include "handler.h"
+#include "scheduler.h"
 #include "note.h"
 
 namespace  {
@@ -565,18 +567,84 @@ Listeners::iterator Listeners::end() {
 
 namespace  {
 
+bool count_traffic(const Listener& listener, const Message& message) {
+    auto& traffic = *listener.traffic;
+    if (!listener.filter.match_message(message)) {
+        traffic.filtered.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    const auto& event = message.event;
+    traffic.messages.fetch_add(1, std::memory_order_relaxed);
+    traffic.bytes.fetch_add(event.dynamic_data() ? event.dynamic_size() : event.static_size(), std::memory_order_relaxed);
+    return true;
+}
+
 template<typename MessageT>
 void listen_message(const Listener& listener, MessageT&& message) {
-    if (listener.filter.match_message(message))
+    if (count_traffic(listener, message))
         listener.handler->send_message(std::forward<MessageT>(message));
 }
 
+bool is_switch_controller(byte_t controller) {
+    using namespace controller_ns;
+    for (byte_t button : general_purpose_button_controllers)
+        if (controller == button)
+            return true;
+    return hold_pedal_controller <= controller && controller <= hold_2_pedal_controller;
+}
+
+bool is_protected(const Message& message) {
+    // switches are protected like note-off, losing a release would hold notes forever
+    if (message.event.is(family_t::controller))
+        return is_switch_controller(extraction_ns::controller(message.event));
+    return message.event.is(families_t::extended()) || message.event.is(family_t::note_off);
+}
+
+bool is_parameter_controller(byte_t controller) {
+    using namespace controller_ns;
+    for (const auto& parameter : {bank_select_controller, data_entry_controller, non_registered_parameter_controller, registered_parameter_controller})
+        if (controller == parameter.coarse || controller == parameter.fine)
+            return true;
+    return controller == data_button_increment_controller || controller == data_button_decrement_controller || is_channel_mode_message(controller);
+}
+
+bool is_coalescable(const Message& message) {
+    // parameter controllers and switches are excluded as each value matters relatively to the notes
+    if (message.event.is(family_t::controller)) {
+        const auto controller = extraction_ns::controller(message.event);
+        return !is_parameter_controller(controller) && !is_switch_controller(controller);
+    }
+    return message.event.is(families_t::fuse(family_t::pitch_wheel, family_t::channel_pressure, family_t::aftertouch));
+}
+
+bool is_coalescable_with(const Message& pending, const Message& message) {
+    if (pending.source != message.source || pending.event.family() != message.event.family()
+            || pending.event.channels() != message.event.channels() || pending.event.track() != message.event.track())
+        return false;
+    if (message.event.is(family_t::controller))
+        return extraction_ns::controller(pending.event) == extraction_ns::controller(message.event);
+    if (message.event.is(family_t::aftertouch))
+        return extraction_ns::note(pending.event) == extraction_ns::note(message.event);
+    return true;
+}
+
+template<typename PredicateT>
+bool erase_first(Messages& messages, PredicateT predicate) {
+    const auto it = std::find_if(messages.begin(), messages.end(), predicate);
+    if (it == messages.end())
+        return false;
+    messages.erase(it);
+    return true;
+}
+
 }
 
 //=========
 // Handler
 //=========
 
+constexpr std::chrono::milliseconds Handler::block_timeout;
+
 const SystemExtension<Handler::State> Handler::open_ext {"Open"};
 const SystemExtension<Handler::State> Handler::close_ext {"Close"};
 
@@ -595,7 +663,7 @@ Handler::~Handler() {
 }
 
 bool Handler::is_busy() const {
-    return m_pending_messages.is_busy();
+    return m_pending_messages.is_busy() || m_scheduled_messages != 0;
 }
 
 const std::string& Handler::name() const {
@@ -630,6 +698,55 @@ void Handler::set_synchronizer(Synchronizer* synchronizer) {
     m_synchronizer = synchronizer;
 }
 
+Scheduler* Handler::scheduler() const {
+    return m_scheduler;
+}
+
+void Handler::set_scheduler(Scheduler* scheduler) {
+    m_scheduler = scheduler;
+}
+
+bool Handler::is_fusable() const {
+    return false;
+}
+
+Handler::Execution Handler::execution() const {
+    return m_execution;
+}
+
+void Handler::set_execution(Execution execution) {
+    m_execution = execution;
+}
+
+Handler::QueueLimit Handler::queue_limit() const {
+    return {m_queue_capacity, m_queue_policy};
+}
+
+void Handler::set_queue_limit(QueueLimit limit) {
+    m_queue_policy = limit.policy;
+    m_queue_capacity = limit.capacity;
+}
+
+Handler::QueueStatistics Handler::queue_statistics() const {
+    QueueStatistics statistics;
+    statistics.peak = m_queue_counters.peak.load(std::memory_order_relaxed);
+    statistics.blocked = m_queue_counters.blocked.load(std::memory_order_relaxed);
+    statistics.dropped = m_queue_counters.dropped.load(std::memory_order_relaxed);
+    statistics.coalesced = m_queue_counters.coalesced.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+size_t Handler::queue_size() const {
+    return m_pending_messages.size();
+}
+
+void Handler::reset_queue_statistics() {
+    m_queue_counters.peak.store(0, std::memory_order_relaxed);
+    m_queue_counters.blocked.store(0, std::memory_order_relaxed);
+    m_queue_counters.dropped.store(0, std::memory_order_relaxed);
+    m_queue_counters.coalesced.store(0, std::memory_order_relaxed);
+}
+
 Interceptor* Handler::interceptor() const {
     return m_interceptor;
 }
@@ -657,10 +774,74 @@ families_t Handler::forwarded_families() const {
 }
 
 void Handler::send_message(Message message) {
-    if (!m_pending_messages.produce(std::move(message)))
+    push_message(std::move(message), true);
+}
+
+void Handler::push_message(Message message, bool blocking) {
+    if (!m_synchronizer->is_inline(this) && message.hops != std::numeric_limits<decltype(message.hops)>::max())
+        ++message.hops;
+    bool busy;
+    const size_t capacity = m_queue_capacity.load(std::memory_order_relaxed);
+    if (capacity == 0) {
+        busy = m_pending_messages.produce(std::move(message));
+    } else {
+        const auto policy = m_queue_policy.load(std::memory_order_relaxed);
+        if (blocking && policy == Overload::block && m_pending_messages.size() >= capacity) {
+            // if the consumer never comes (e.g. it is this very thread), the message is admitted as with drop_oldest
+            m_queue_counters.blocked.fetch_add(1, std::memory_order_relaxed);
+            m_pending_messages.wait_for(block_timeout, [capacity](const auto& pending) { return pending.size() < capacity; });
+        }
+        busy = m_pending_messages.produce(std::move(message), [this, capacity, policy](auto& pending, auto&& message) {
+            admit_message(pending, std::move(message), capacity, policy);
+        });
+    }
+    if (!busy)
         m_synchronizer->sync_handler(this);
 }
 
+void Handler::admit_message(Messages& pending, Message message, size_t capacity, Overload policy) {
+    if (policy == Overload::coalesce && is_coalescable(message)) {
+        const auto it = std::find_if(pending.rbegin(), pending.rend(), [&](const auto& other) { return is_coalescable_with(other, message); });
+        if (it != pending.rend()) {
+            // the update is replaced in place unless notes of its channels are queued after it
+            const auto channels = message.event.channels();
+            const bool reordered = std::any_of(it.base(), pending.end(), [channels](const auto& other) {
+                return other.event.is(families_t::standard_note()) && other.event.channels().any(channels);
+            });
+            if (reordered) {
+                pending.erase(std::next(it).base());
+                pending.push_back(std::move(message));
+            } else {
+                *it = std::move(message);
+            }
+            m_queue_counters.coalesced.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    if (pending.size() >= capacity) {
+        const bool keep_notes = policy == Overload::drop_non_notes;
+        const auto droppable = [keep_notes](const Message& other) {
+            return !is_protected(other) && !(keep_notes && other.event.is(families_t::standard_note()));
+        };
+        const bool room = erase_first(pending, droppable);
+        if (room || !is_protected(message))
+            m_queue_counters.dropped.fetch_add(1, std::memory_order_relaxed);
+        if (!room && !is_protected(message))
+            return; // drop the incoming message
+    }
+    pending.push_back(std::move(message));
+    // only producers update the peak and they hold the queue lock
+    if (pending.size() > m_queue_counters.peak.load(std::memory_order_relaxed))
+        m_queue_counters.peak.store(pending.size(), std::memory_order_relaxed);
+}
+
+void Handler::send_message_at(Message message, const Message::time_type& due) {
+    if (m_scheduler && due > Message::clock_type::now())
+        m_scheduler->schedule(this, std::move(message), due);
+    else
+        send_message(std::move(message));
+}
+
 void Handler::flush_messages() {
     m_pending_messages.consume([this](const auto& messages) {
 #ifdef MIDILAB_ENABLE_TIMING
@@ -712,6 +893,17 @@ void Handler::produce_message(Event event) {
     forward_message({std::move(event), this});
 }
 
+void Handler::forward_message_at(const Message& message, const Message::time_type& due) {
+    std::lock_guard<std::mutex> guard{m_listeners_mutex};
+    for (const auto& listener : m_listeners)
+        if (count_traffic(listener, message))
+            listener.handler->send_message_at(message, due);
+}
+
+void Handler::produce_message_at(Event event, const Message::time_type& due) {
+    forward_message_at({std::move(event), this}, due);
+}
+
 Handler::Result Handler::handle_open(State state) {
     activate_state(state);
     return Result::success;
@@ -733,3 +925,49 @@ families_t Handler::handled_families() const {
 families_t Handler::produced_families() const {
     return families_t::full();
 }
+
+//====================
+// InlineSynchronizer
+//====================
+
+namespace {
+
+thread_local size_t inline_depth {0}; /*!< number of nested inline flushes on the current thread */
+
+}
+
+constexpr size_t InlineSynchronizer::default_max_depth;
+
+InlineSynchronizer::InlineSynchronizer(Synchronizer* fallback, size_t max_depth) : m_fallback{fallback}, m_max_depth{max_depth} {
+
+}
+
+bool InlineSynchronizer::fusion() const {
+    return m_fusion;
+}
+
+void InlineSynchronizer::set_fusion(bool fusion) {
+    m_fusion = fusion;
+}
+
+void InlineSynchronizer::sync_handler(Handler* target) {
+    if (is_inline(target)) {
+        ++inline_depth;
+        target->flush_messages();
+        --inline_depth;
+    } else {
+        m_fallback->sync_handler(target);
+    }
+}
+
+bool InlineSynchronizer::is_inline(const Handler* target) const {
+    // past the depth limit, messages are queued through the fallback
+    if (inline_depth >= m_max_depth)
+        return false;
+    switch (target->execution()) {
+    case Handler::Execution::automatic: return m_fusion && target->is_fusable();
+    case Handler::Execution::queued: return false;
+    case Handler::Execution::inlined: return true;
+    }
+    return false;
+}
@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define CORE_HANDLER_H
 
 #include <chrono>
+#include <memory>
 #include <boost/logic/tribool.hpp>
 #include <boost/variant.hpp>
 #include <boost/lockfree/queue.hpp>
@@ -33,6 +34,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 class Interceptor;
 class Synchronizer;
+class Scheduler;
 class Handler;
 
 //=========
@@ -55,6 +57,9 @@ struct Message final {
 
     Event event; /*!< actual event to be handled */
     Handler* source; /*!< first producer of the event */
+    uint8_t hops {0}; /*!< number of queues crossed through synchronizers, saturated */
+    uint16_t origin {0}; /*!< identifier set by the producer and kept while forwarded, 0 if unused (see LoadGenerator) */
+    uint32_t stamp {0}; /*!< value attached by the producer along with origin */
     #ifdef MIDILAB_ENABLE_TIMING
     time_type time_point  {clock_type::now()}; /*!< construction time */
     #endif
@@ -204,11 +209,21 @@ private:
  * A listener represents a handler that will receive messages forwarded from another one.
  * It is associated to a filter that will allow selecting the messages truly received
  *
+ * Traffic counters are updated on each forwarded message with relaxed atomics,
+ * they are shared between copies of the listener so that observers may sample them at a low rate.
+ *
  */
 
+struct ListenerTraffic final {
+    std::atomic<size_t> messages {0}; /*!< messages matching the filter */
+    std::atomic<size_t> bytes {0}; /*!< size of the events matching the filter */
+    std::atomic<size_t> filtered {0}; /*!< messages rejected by the filter */
+};
+
 struct Listener final {
     Handler* handler;
     Filter filter;
+    std::shared_ptr<ListenerTraffic> traffic {std::make_shared<ListenerTraffic>()};
 };
 
 //==========
@@ -320,6 +335,46 @@ public:
         closed /*!< handling failed because handler was closed */
     };
 
+    // pending messages may be limited, the policy decides what happens when the queue is full
+    // extended events, note-off events and switch controllers are never dropped, the incoming message is dropped if no pending one can be
+    // - block: the sender waits for the consumer (at most block_timeout, then drops the oldest message), the scheduler never waits
+    // - drop_oldest: the oldest pending message is dropped
+    // - drop_non_notes: the oldest pending message that is not a note is dropped
+    // - coalesce: controller, pitch wheel & pressure updates replace the last pending one of the same channels, then drop_oldest
+    //   switches are never coalesced and an update moves to the back if notes of its channels are pending after the replaced one
+
+    enum class Overload {
+        block,
+        drop_oldest,
+        drop_non_notes,
+        coalesce
+    };
+
+    struct QueueLimit {
+        size_t capacity {0}; /*!< maximum number of pending messages, 0 means unbounded */
+        Overload policy {Overload::drop_oldest};
+    };
+
+    struct QueueStatistics {
+        size_t peak {0}; /*!< highest number of pending messages observed */
+        size_t blocked {0}; /*!< messages whose sender had to wait */
+        size_t dropped {0}; /*!< messages discarded */
+        size_t coalesced {0}; /*!< messages merged into a pending one */
+    };
+
+    static constexpr std::chrono::milliseconds block_timeout {50};
+
+    // execution tells how a handler would rather be synchronized, it is honored by the InlineSynchronizer
+    // - automatic: inlined if the handler is fusable and fusion is enabled
+    // - queued: handled by the threads of a synchronizer
+    // - inlined: handled synchronously in the sender's context
+
+    enum class Execution {
+        automatic,
+        queued,
+        inlined
+    };
+
     static const SystemExtension<State> open_ext; /*!< Specific action with key "Open" */
     static const SystemExtension<State> close_ext; /*!< Specific action with key "Close" */
 
@@ -338,7 +393,7 @@ public:
     // properties
     // ----------
 
-    bool is_busy() const; /*!< true if there are pending messages waiting to be handled */
+    bool is_busy() const; /*!< true if there are pending or scheduled messages waiting to be handled */
 
     const std::string& name() const;
     void set_name(std::string name);
@@ -352,6 +407,27 @@ public:
     Synchronizer* synchronizer() const;
     void set_synchronizer(Synchronizer* synchronizer);
 
+    Scheduler* scheduler() const;
+    void set_scheduler(Scheduler* scheduler);
+
+    /**
+     * A fusable handler is cheap and never blocks, it may then be fused into its producers:
+     * messages sent to a fused handler are handled synchronously in the sender's context instead of waking a thread.
+     * Chains of fused handlers are executed in a row, messages are only queued at the boundary of a non-fused handler.
+     * @see InlineSynchronizer
+     */
+
+    virtual bool is_fusable() const; /*!< default is false */
+
+    Execution execution() const;
+    void set_execution(Execution execution);
+
+    QueueLimit queue_limit() const;
+    void set_queue_limit(QueueLimit limit);
+    QueueStatistics queue_statistics() const;
+    void reset_queue_statistics();
+    size_t queue_size() const; /*!< number of messages pending, approximate */
+
     Interceptor* interceptor() const;
     void set_interceptor(Interceptor* interceptor);
 
@@ -373,6 +449,7 @@ public:
     // ------------------
 
     void send_message(Message message); /*!< add pending message and notifies the synchronizer */
+    void send_message_at(Message message, const Message::time_type& due); /*!< delays send_message until due time (immediate without scheduler) */
     void flush_messages(); /*!< will synchronously pass pending messages to the interceptor */
     Result receive_message(const Message& message) noexcept; /*!< calls handle_* after checking mode and state */
 
@@ -385,6 +462,8 @@ protected:
     void forward_message(const Message& message); /*!< sends message to all listeners matching their filters */
     void forward_message(Message&& message);
     void produce_message(Event event); /*!< creates and forwards a new message */
+    void forward_message_at(const Message& message, const Message::time_type& due); /*!< same as forward_message at due time */
+    void produce_message_at(Event event, const Message::time_type& due);
 
     // --------
     // behavior
@@ -398,15 +477,31 @@ protected:
 
 private:
 
+    friend class Scheduler;
+
+    void push_message(Message message, bool blocking); /*!< implements send_message, the scheduler thread must not block */
+    void admit_message(Messages& pending, Message message, size_t capacity, Overload policy); /*!< called with the queue locked */
+
     // ----------
     // attributes
     // ----------
 
     Queue<Messages> m_pending_messages;
+    std::atomic<size_t> m_scheduled_messages {0}; /*!< messages held by the scheduler */
     std::string m_name;
     const Mode m_mode;
     std::atomic<State::storage_type> m_state {};
     Synchronizer* m_synchronizer {nullptr};
+    Scheduler* m_scheduler {nullptr};
+    std::atomic<Execution> m_execution {Execution::automatic};
+    std::atomic<size_t> m_queue_capacity {0};
+    std::atomic<Overload> m_queue_policy {Overload::drop_oldest};
+    struct {
+        std::atomic<size_t> peak {0};
+        std::atomic<size_t> blocked {0};
+        std::atomic<size_t> dropped {0};
+        std::atomic<size_t> coalesced {0};
+    } m_queue_counters;
     Interceptor* m_interceptor {nullptr};
     mutable std::mutex m_listeners_mutex;
     Listeners m_listeners;
@@ -454,6 +549,7 @@ class Synchronizer {
 public:
     virtual ~Synchronizer() = default;
     virtual void sync_handler(Handler* target) = 0;
+    virtual bool is_inline(const Handler* /*target*/) const { return false; } /*!< true if target would be flushed in the sender's context (calling thread) */
 
 };
 
@@ -486,4 +582,39 @@ private:
 
 };
 
+//====================
+// InlineSynchronizer
+//====================
+
+/**
+ * The InlineSynchronizer flushes handlers directly in the sender's context according to their execution,
+ * saving a thread wakeup for handlers too cheap to deserve it.
+ *
+ * Handlers that must be queued are passed to the fallback synchronizer, so are handlers reached
+ * beyond max_depth nested flushes on the same thread, which bounds the recursion through long chains.
+ * Re-entrancy is prevented by the handler's queue: a handler being flushed stays busy, so that messages
+ * it receives meanwhile (from another thread or through a cycle) are consumed by the running flush,
+ * in order and one at a time.
+ */
+
+class InlineSynchronizer final : public Synchronizer {
+
+public:
+    static constexpr size_t default_max_depth = 8;
+
+    explicit InlineSynchronizer(Synchronizer* fallback, size_t max_depth = default_max_depth);
+
+    bool fusion() const;
+    void set_fusion(bool fusion); /*!< inline fusable handlers with automatic execution (default true) */
+
+    void sync_handler(Handler* target) override;
+    bool is_inline(const Handler* target) const override;
+
+private:
+    Synchronizer* m_fallback;
+    const size_t m_max_depth;
+    std::atomic_bool m_fusion {true};
+
+};
+
 #endif // CORE_HANDLER_H
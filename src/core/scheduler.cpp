@@ -0,0 +1,219 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <algorithm>
+#include "scheduler.h"
+
+namespace {
+
+/// comparator making m_ready a min-heap of due times
+const auto later_due = [](const auto& lhs, const auto& rhs) { return lhs.due > rhs.due; };
+
+}
+
+//===========
+// Scheduler
+//===========
+
+constexpr size_t Scheduler::level_bits;
+constexpr size_t Scheduler::level_size;
+constexpr size_t Scheduler::level_count;
+constexpr Scheduler::spin_duration Scheduler::spin_margin;
+
+Scheduler::Scheduler() {
+    m_thread = std::thread{[this] { run(); }};
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> guard{m_mutex};
+        m_running = false;
+    }
+    m_condition_variable.notify_one();
+    m_thread.join();
+}
+
+void Scheduler::schedule(Handler* target, Message message, time_type due) {
+    ++target->m_scheduled_messages;
+    std::lock_guard<std::mutex> guard{m_mutex};
+    m_incoming.push_back(Item{target, std::move(message), due});
+    // the timing thread only needs to be awaken if it sleeps past this due time
+    if (due < m_wakeup)
+        m_condition_variable.notify_one();
+}
+
+void Scheduler::cancel(Handler* target) {
+    if (target->m_scheduled_messages == 0)
+        return;
+    std::lock_guard<std::mutex> guard{m_mutex};
+    m_cancelled.insert(target);
+    m_condition_variable.notify_one();
+}
+
+void Scheduler::run() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (m_running) {
+        ingest();
+        m_wakeup = time_type::min();
+        lock.unlock();
+        const auto now = clock_type::now();
+        advance(tick_at(now));
+        release(now);
+        const auto next = deadline();
+        lock.lock();
+        if (!m_incoming.empty() || !m_cancelled.empty() || !m_running)
+            continue;
+        m_wakeup = next;
+        if (next == time_type::max()) {
+            m_condition_variable.wait(lock);
+        } else if (clock_type::now() + spin_margin < next) {
+            m_condition_variable.wait_until(lock, next - spin_margin);
+        } else {
+            // too close to trust the system scheduler, poll the clock
+            lock.unlock();
+            while (clock_type::now() < next)
+                std::this_thread::yield();
+            lock.lock();
+        }
+    }
+    // drop everything left so that targets are no longer busy
+    for (const auto& item : m_incoming)
+        drop(item);
+    for (const auto& item : m_ready)
+        drop(item);
+    for (const auto& item : m_overflow)
+        drop(item);
+    for (const auto& level : m_wheel)
+        for (const auto& slot : level)
+            for (const auto& item : slot)
+                drop(item);
+}
+
+void Scheduler::ingest() {
+    if (!m_cancelled.empty()) {
+        auto purge = [this](Items& items) {
+            const auto it = std::partition(items.begin(), items.end(), [this](const auto& item) { return m_cancelled.count(item.target) == 0; });
+            const auto count = static_cast<size_t>(std::distance(it, items.end()));
+            std::for_each(it, items.end(), [this](const auto& item) { drop(item); });
+            items.erase(it, items.end());
+            return count;
+        };
+        for (auto& level : m_wheel)
+            for (auto& slot : level)
+                m_count -= purge(slot);
+        m_count -= purge(m_overflow);
+        purge(m_ready);
+        std::make_heap(m_ready.begin(), m_ready.end(), later_due);
+        purge(m_incoming);
+        m_cancelled.clear();
+    }
+    for (auto& item : m_incoming)
+        insert(std::move(item));
+    m_incoming.clear();
+}
+
+void Scheduler::insert(Item item) {
+    const auto tick = tick_at(item.due);
+    if (tick <= m_tick) {
+        m_ready.push_back(std::move(item));
+        std::push_heap(m_ready.begin(), m_ready.end(), later_due);
+        return;
+    }
+    ++m_count;
+    // the lowest level whose block contains both ticks, so that the slot is visited before the block ends
+    for (size_t level=0 ; level < level_count ; ++level) {
+        const auto shift = level_bits * (level + 1);
+        if ((tick >> shift) == (m_tick >> shift)) {
+            m_wheel[level][(tick >> (level_bits * level)) & (level_size - 1)].push_back(std::move(item));
+            return;
+        }
+    }
+    m_overflow.push_back(std::move(item));
+}
+
+void Scheduler::advance(uint64_t tick) {
+    if (m_count == 0) {
+        m_tick = std::max(m_tick, tick);
+        return;
+    }
+    while (m_tick < tick) {
+        ++m_tick;
+        // higher levels first, their items may fall in the slots cascaded next
+        for (size_t level=level_count-1 ; level != 0 ; --level)
+            if ((m_tick & ((uint64_t{1} << (level_bits * level)) - 1)) == 0)
+                cascade(level);
+        auto& slot = m_wheel[0][m_tick & (level_size - 1)];
+        m_count -= slot.size();
+        for (auto& item : slot) {
+            m_ready.push_back(std::move(item));
+            std::push_heap(m_ready.begin(), m_ready.end(), later_due);
+        }
+        slot.clear();
+    }
+}
+
+void Scheduler::cascade(size_t level) {
+    Items items;
+    items.swap(m_wheel[level][(m_tick >> (level_bits * level)) & (level_size - 1)]);
+    if (level == level_count - 1) {
+        items.insert(items.end(), std::make_move_iterator(m_overflow.begin()), std::make_move_iterator(m_overflow.end()));
+        m_overflow.clear();
+    }
+    m_count -= items.size();
+    for (auto& item : items)
+        insert(std::move(item));
+}
+
+void Scheduler::release(time_type now) {
+    while (!m_ready.empty() && m_ready.front().due <= now) {
+        std::pop_heap(m_ready.begin(), m_ready.end(), later_due);
+        auto item = std::move(m_ready.back());
+        m_ready.pop_back();
+        item.target->push_message(std::move(item.message), false); // a blocking target would delay all other messages
+        drop(item);
+    }
+}
+
+void Scheduler::drop(const Item& item) {
+    --item.target->m_scheduled_messages;
+}
+
+Scheduler::time_type Scheduler::deadline() const {
+    if (!m_ready.empty())
+        return m_ready.front().due;
+    if (m_count == 0)
+        return time_type::max();
+    // next non-empty slot of the lowest level, or the next cascade
+    const auto boundary = (m_tick | (level_size - 1)) + 1;
+    for (auto tick = m_tick + 1 ; tick < boundary ; ++tick)
+        if (!m_wheel[0][tick & (level_size - 1)].empty())
+            return time_at(tick);
+    return time_at(boundary);
+}
+
+uint64_t Scheduler::tick_at(time_type time) const {
+    if (time <= m_origin)
+        return 0;
+    return static_cast<uint64_t>(std::chrono::duration_cast<tick_duration>(time - m_origin).count());
+}
+
+Scheduler::time_type Scheduler::time_at(uint64_t tick) const {
+    return m_origin + tick_duration{tick};
+}
@@ -0,0 +1,106 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef CORE_SCHEDULER_H
+#define CORE_SCHEDULER_H
+
+#include <unordered_set>
+#include "handler.h"
+
+//===========
+// Scheduler
+//===========
+
+/**
+ * The scheduler delays messages until their due time before passing them to the target's queue like Handler::send_message,
+ * the target's synchronizer then processes them as usual.
+ * The timing thread never waits for a full queue, a target with the block policy drops its oldest message instead.
+ *
+ * Pending messages are stored in a hierarchical timer wheel (levels of 64 slots, 1 ms per slot at the lowest level)
+ * that only the timing thread manipulates, producers just append to an incoming queue.
+ * The thread sleeps until the earliest due time and spins the last microseconds to release messages
+ * with a sub-millisecond precision.
+ *
+ * Scheduled messages keep their target busy, so that a handler is not deleted while it may still receive them.
+ * Use cancel when removing a handler to drop its messages.
+ *
+ */
+
+class Scheduler {
+
+public:
+    using clock_type = Message::clock_type;
+    using time_type = Message::time_type;
+    using tick_duration = std::chrono::milliseconds;
+    using spin_duration = std::chrono::microseconds;
+
+    static constexpr size_t level_bits = 6;
+    static constexpr size_t level_size = 1 << level_bits;
+    static constexpr size_t level_count = 4; /*!< ticks beyond 64^4 ms (~4.6 hours) are kept aside until they come closer */
+    static constexpr spin_duration spin_margin {200}; /*!< time spent polling the clock before a due time */
+
+    explicit Scheduler();
+    ~Scheduler();
+
+    void schedule(Handler* target, Message message, time_type due); /*!< thread-safe */
+    void cancel(Handler* target); /*!< drops all messages scheduled for target (asynchronously) */
+
+private:
+    struct Item {
+        Handler* target;
+        Message message;
+        time_type due;
+    };
+
+    using Items = std::vector<Item>;
+    using Slots = std::array<Items, level_size>;
+
+    void run();
+    void ingest(); /*!< processes cancellations & incoming items (m_mutex must be locked) */
+    void insert(Item item);
+    void advance(uint64_t tick); /*!< moves the wheel to tick, due items are moved to the ready list */
+    void cascade(size_t level);
+    void release(time_type now);
+    void drop(const Item& item);
+    time_type deadline() const; /*!< time_type::max() if nothing is scheduled */
+    uint64_t tick_at(time_type time) const;
+    time_type time_at(uint64_t tick) const;
+
+    // shared state
+    std::mutex m_mutex;
+    std::condition_variable m_condition_variable;
+    Items m_incoming;
+    std::unordered_set<Handler*> m_cancelled;
+    bool m_running {true};
+    time_type m_wakeup {time_type::max()}; /*!< time the thread is waiting for */
+
+    // timing thread state
+    const time_type m_origin {clock_type::now()};
+    uint64_t m_tick {0}; /*!< current tick, items of older ticks are ready */
+    std::array<Slots, level_count> m_wheel;
+    Items m_overflow; /*!< items beyond the last level */
+    Items m_ready; /*!< heap of items whose tick is reached, sorted by due time */
+    size_t m_count {0}; /*!< items stored in the wheel & overflow */
+
+    std::thread m_thread;
+
+};
+
+#endif // CORE_SCHEDULER_H
@@ -237,19 +237,25 @@ auto fill_range(std::istream& is, byte_view range) {
     return byte_cview{range.min, range.max};
 }
 
+auto read_storage(const std::string& filename) {
+    std::ifstream ifs{filename, std::ios_base::binary};
+    if (!ifs)
+        throw std::runtime_error{"can't open file"};
+    // check header before loading the whole file
+    std::array<byte_t, 4> header_storage;
+    auto header_buf = fill_range(ifs, range_ns::from_span(header_storage.data(), header_storage.size()));
+    read_prefix(header_buf, make_view("MThd"));
+    // compute the file size and read it
+    std::vector<byte_t> file_storage(static_cast<size_t>(remaining_size(ifs)));
+    fill_range(ifs, range_ns::from_span(file_storage.data(), file_storage.size()));
+    return file_storage;
+}
+
 StandardMidiFile read_file(const std::string& filename) {
     TRACE_MEASURE("read file");
     try  {
-        std::ifstream ifs{filename, std::ios_base::binary};
-        if (!ifs)
-            throw std::runtime_error{"can't open file"};
-        // check header before loading the whole file
-        std::array<byte_t, 4> header_storage;
-        auto header_buf = fill_range(ifs, range_ns::from_span(header_storage.data(), header_storage.size()));
-        read_prefix(header_buf, make_view("MThd"));
-        // compute the file size and read it
-        std::vector<byte_t> file_storage(static_cast<size_t>(remaining_size(ifs)));
-        auto file_buf = fill_range(ifs, range_ns::from_span(file_storage.data(), file_storage.size()));
+        const auto file_storage = read_storage(filename);
+        byte_cview file_buf{file_storage.data(), file_storage.data() + file_storage.size()};
         return read_file(file_buf);
     } catch (const std::exception& err) {
         TRACE_ERROR(filename << ": " << err.what());
@@ -257,6 +263,129 @@ StandardMidiFile read_file(const std::string& filename) {
     }
 }
 
+// -----
+// scan
+// -----
+
+using TempoChange = std::pair<uint64_t, uint32_t>; /*!< tick & microseconds per quarter note */
+
+void scan_track_events(byte_cview& buf, MidiFileSummary& summary, std::vector<TempoChange>& tempo_map) {
+    byte_t running_status = 0;
+    uint64_t timestamp = 0;
+    bool named = false;
+    while (buf) {
+        const auto deltatime = read_variable(buf);
+        timestamp += deltatime;
+        const auto status = read_status(buf, &running_status);
+        ++summary.events;
+        if (status == 0xff) {
+            const auto type = read_byte(buf);
+            const auto data = read_n(buf, read_variable(buf));
+            if (type == 0x2f) {
+                // same workaround as read_track_events for the EOT of some editors
+                if (timestamp == 0x03ffff)
+                    timestamp -= deltatime;
+                break;
+            }
+            if (type == 0x51 && span(data) == 3)
+                tempo_map.emplace_back(timestamp, (data.min[0] << 16) | (data.min[1] << 8) | data.min[2]);
+            else if (type == 0x03 && !named && span(data) != 0) {
+                summary.track_names.emplace_back(data.min, data.max);
+                named = true;
+            }
+        } else if (status == 0xf0 || status == 0xf7) {
+            read_n(buf, read_variable(buf));
+        } else {
+            const auto channel = status & 0xf;
+            switch (status & 0xf0) {
+            case 0x90: {
+                const auto data = read_n(buf, 2).min;
+                if (data[1] != 0) {
+                    ++summary.notes;
+                    summary.drums |= channel == channels_t::drum();
+                }
+                break;
+            }
+            case 0xc0: {
+                const auto program = read_byte(buf);
+                if (channel != channels_t::drum())
+                    summary.programs.set(to_data_byte(program));
+                break;
+            }
+            case 0x80:
+            case 0xa0:
+            case 0xb0:
+            case 0xe0: read_n(buf, 2); break;
+            case 0xd0: read_n(buf, 1); break;
+            default: throw std::logic_error{"unexpected event status"};
+            }
+        }
+    }
+    summary.last_tick = std::max(summary.last_tick, timestamp);
+}
+
+void scan_duration(MidiFileSummary& summary, std::vector<TempoChange>& tempo_map) {
+    summary.tempo_changes = tempo_map.size();
+    if (summary.ppqn & 0x8000) {
+        // SMPTE division: negative frames per second & ticks per frame
+        const auto fps = -static_cast<int8_t>(summary.ppqn >> 8);
+        const auto ticks_per_frame = summary.ppqn & 0xff;
+        if (fps > 0 && ticks_per_frame > 0)
+            summary.duration = static_cast<double>(summary.last_tick) / (fps * ticks_per_frame);
+        return;
+    }
+    if (summary.ppqn == 0)
+        return;
+    std::stable_sort(tempo_map.begin(), tempo_map.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    double microseconds = 0.;
+    uint64_t last_tick = 0;
+    uint32_t mpqn = 500000; // 120 bpm until told otherwise
+    for (const auto& tempo : tempo_map) {
+        if (tempo.first > summary.last_tick)
+            break;
+        microseconds += static_cast<double>(tempo.first - last_tick) * mpqn / summary.ppqn;
+        last_tick = tempo.first;
+        mpqn = tempo.second;
+        if (tempo.first == 0 && mpqn != 0)
+            summary.tempo = 60e6 / mpqn;
+    }
+    microseconds += static_cast<double>(summary.last_tick - last_tick) * mpqn / summary.ppqn;
+    summary.duration = microseconds / 1e6;
+}
+
+MidiFileSummary scan_file(const std::string& filename) {
+    MidiFileSummary summary;
+    std::vector<TempoChange> tempo_map;
+    try {
+        const auto file_storage = read_storage(filename);
+        byte_cview buf{file_storage.data(), file_storage.data() + file_storage.size()};
+        if (read_le<uint32_t>(buf) != 6)
+            throw std::logic_error{"unexpected header size"};
+        summary.format = read_le<uint16_t>(buf);
+        if (summary.format > 2)
+            throw std::logic_error{"unexpected midi file format"};
+        const auto tracks = read_le<uint16_t>(buf);
+        summary.ppqn = read_le<uint16_t>(buf);
+        for (size_t i=0 ; i < tracks ; ++i) {
+            read_prefix(buf, make_view("MTrk"));
+            auto track_buf = read_at_most_n(buf, read_le<uint32_t>(buf));
+            // a corrupted track still accounts for what was read before
+            try {
+                scan_track_events(track_buf, summary, tempo_map);
+            } catch (const std::exception& err) {
+                TRACE_DEBUG(filename << ": track " << i << ": " << err.what());
+            }
+            ++summary.tracks;
+        }
+    } catch (const std::exception& err) {
+        TRACE_DEBUG(filename << ": " << err.what());
+        if (summary.tracks == 0)
+            return MidiFileSummary{};
+    }
+    scan_duration(summary, tempo_map);
+    return summary;
+}
+
 // ------
 // write
 // ------
@@ -571,17 +700,19 @@ Sequence::Sequence(ppqn_t ppqn) : m_clock{ppqn} {
 
 std::set<track_t> Sequence::tracks() const {
     std::set<track_t> results;
-    for (const auto& item : m_events)
-        results.insert(item.event.track());
+    const auto index = this->index();
+    for (const auto& track : index->tracks)
+        results.insert(results.end(), track.first);
     return results;
 }
 
 range_t<uint32_t> Sequence::track_range() const {
     range_t<uint32_t> result{default_track, default_track};
-    if (!m_events.empty()) {
-        const auto its = std::minmax_element(m_events.begin(), m_events.end(), [](const auto& lhs, const auto& rhs) { return lhs.event.track() < rhs.event.track(); });
-        result.min = static_cast<uint32_t>(its.first->event.track());
-        result.max = static_cast<uint32_t>(its.second->event.track()) + 1;
+    const auto index = this->index();
+    const auto& tracks = index->tracks;
+    if (!tracks.empty()) {
+        result.min = static_cast<uint32_t>(tracks.begin()->first);
+        result.max = static_cast<uint32_t>(tracks.rbegin()->first) + 1;
     }
     return result;
 }
@@ -595,33 +726,83 @@ timestamp_t Sequence::last_timestamp() const {
 }
 
 timestamp_t Sequence::last_timestamp(track_t track) const {
-    for (auto it = m_events.rbegin() ; it != m_events.rend() ; ++it)
-        if (it->event.track() == track)
-            return it->timestamp;
-    return 0.;
+    const auto index = this->index();
+    const auto& track_positions = index->track(track);
+    return track_positions.empty() ? 0. : m_events[track_positions.back()].timestamp;
+}
+
+size_t Sequence::copies() const {
+    return static_cast<size_t>(m_origin.use_count());
+}
+
+size_t Sequence::memory() const {
+    size_t result = m_events.capacity() * sizeof(TimedEvent);
+    for (const auto& item : m_events)
+        result += item.event.dynamic_size();
+    return result;
+}
+
+std::shared_ptr<const Sequence::Index> Sequence::index() const {
+    if (auto index = std::atomic_load(&m_index))
+        return index;
+    TRACE_MEASURE("Sequence::index");
+    auto index = std::make_shared<Index>();
+    for (size_t i=0 ; i < m_events.size() ; ++i) {
+        const auto& event = m_events[i].event;
+        const auto position = static_cast<uint32_t>(i);
+        index->families[static_cast<size_t>(event.family())].push_back(position);
+        index->tracks[event.track()].push_back(position);
+    }
+    // another thread may have stored its own index in the meantime, both are identical
+    std::shared_ptr<const Index> expected;
+    std::shared_ptr<const Index> desired = std::move(index);
+    if (!std::atomic_compare_exchange_strong(&m_index, &expected, desired))
+        return expected;
+    return desired;
+}
+
+const Sequence::positions_type& Sequence::Index::family(family_t family) const {
+    return families[static_cast<size_t>(family)];
+}
+
+const Sequence::positions_type& Sequence::Index::track(track_t track) const {
+    static const positions_type no_positions;
+    const auto it = tracks.find(track);
+    return it == tracks.end() ? no_positions : it->second;
+}
+
+void Sequence::invalidate_index() noexcept {
+    if (m_index)
+        std::atomic_store(&m_index, std::shared_ptr<const Index>{});
 }
 
 void Sequence::clear() {
+    invalidate_index();
+    m_origin = std::make_shared<const bool>();
     m_events.clear();
     m_clock.reset();
 }
 
 void Sequence::push_item(TimedEvent item) {
+    invalidate_index();
     m_events.push_back(std::move(item));
 }
 
 void Sequence::insert_item(TimedEvent item) {
+    invalidate_index();
     auto it = std::upper_bound(m_events.begin(), m_events.end(), item.timestamp);
     m_events.emplace(it, std::move(item));
 }
 
 void Sequence::insert_items(const TimedEvents& items) {
+    invalidate_index();
     const auto previous_size = static_cast<std::ptrdiff_t>(m_events.size());
     m_events.insert(m_events.end(), items.begin(), items.end());
     std::inplace_merge(m_events.begin(), m_events.begin() + previous_size, m_events.end());
 }
 
 void Sequence::update_clock() {
+    invalidate_index();
     m_clock.reset();
     for (const auto& item : m_events)
         m_clock.push_timestamp(item.event, item.timestamp);
@@ -25,6 +25,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <chrono>     // std::chrono::duration
 #include <vector>     // std::vector
 #include <set>        // std::set
+#include <map>        // std::map
+#include <memory>     // std::shared_ptr
+#include <bitset>     // std::bitset
 #include "event.h"    // Event
 #include "tools/containers.h"
 
@@ -71,6 +74,33 @@ struct StandardMidiFile {
 
 };
 
+//==================
+// MidiFileSummary
+//==================
+
+/**
+ * Metadata of a midi file computed without building its events
+ * It is cheap enough to index a whole library, the duration is computed from the tempo map
+ *
+ */
+
+struct MidiFileSummary {
+
+    StandardMidiFile::format_type format {StandardMidiFile::simultaneous_format};
+    ppqn_t ppqn {default_ppqn};
+    size_t tracks {0}; /*!< number of tracks parsed, 0 means the file is invalid */
+    uint64_t last_tick {0};
+    double duration {0.}; /*!< in seconds */
+    double tempo {120.}; /*!< initial tempo in bpm */
+    size_t tempo_changes {0};
+    size_t notes {0};
+    size_t events {0};
+    std::bitset<0x80> programs; /*!< programs changed on melodic channels */
+    bool drums {false}; /*!< notes played on the percussion channel */
+    std::vector<std::string> track_names;
+
+};
+
 //=========
 // dumping
 //=========
@@ -89,6 +119,8 @@ Event read_event(byte_cview& buf, bool is_realtime, byte_t* running_status = nul
 StandardMidiFile read_file(const std::string& filename); /*!< return an empty file on error */
 size_t write_file(const StandardMidiFile& file, const std::string& filename, bool use_running_status = true); /*!< return 0 on error */
 
+MidiFileSummary scan_file(const std::string& filename); /*!< skips event data, return an empty summary on error */
+
 }
 
 //============
@@ -217,6 +249,11 @@ private:
  * It offers more flexibility on reading access (random access iterators)
  * compared to a multimap implementation for example
  *
+ * Positions of events by family and by track are indexed lazily on first query.
+ * Mutators drop the index so that it is rebuilt on demand, the index returned stays valid as long as it is held.
+ * Events edited in place through element access must be followed by update_clock, which drops the index as well.
+ * Concurrent queries on a const sequence are safe (the index may be built twice).
+ *
  */
 
 class Sequence {
@@ -231,6 +268,16 @@ public:
     using realtime_type = std::vector<RealtimeItem>;
     using blacklist_type = blacklist_t<track_t>;
 
+    using positions_type = std::vector<uint32_t>; /*!< increasing positions of events, hence sorted by timestamp */
+
+    struct Index {
+        const positions_type& family(family_t family) const;
+        const positions_type& track(track_t track) const; /*!< empty if the track is not used */
+
+        std::array<positions_type, families_t::capacity()> families;
+        std::map<track_t, positions_type> tracks;
+    };
+
     // --------
     // builders
     // --------
@@ -258,6 +305,15 @@ public:
     timestamp_t last_timestamp() const; /*!< maximum event's timestamp in all the tracks */
     timestamp_t last_timestamp(track_t track) const; /*!< maximum event's timestamp in the given track */
 
+    size_t copies() const; /*!< number of living sequences copied from the same origin, including this one */
+    size_t memory() const; /*!< approximated size of the events in bytes */
+
+    // -------
+    // indexes
+    // -------
+
+    std::shared_ptr<const Index> index() const; /*!< built on first call */
+
     // --------
     // mutators
     // --------
@@ -266,7 +322,7 @@ public:
     void push_item(TimedEvent item); /*!< invalidate clock */
     void insert_item(TimedEvent item); /*!< invalidate clock */
     void insert_items(const TimedEvents& items); /*!< invalidate clock */
-    void update_clock();
+    void update_clock(); /*!< invalidate index */
 
     // ----------
     // converters
@@ -299,8 +355,12 @@ public:
     inline auto crend() const noexcept { return m_events.crend(); }
 
 private:
+    void invalidate_index() noexcept;
+
     TimedEvents m_events;
     Clock m_clock;
+    mutable std::shared_ptr<const Index> m_index; /*!< accessed atomically */
+    std::shared_ptr<const bool> m_origin {std::make_shared<const bool>()}; /*!< token shared by copies, for accounting */
 
 };
 
@@ -32,6 +32,10 @@ ChannelMapper::ChannelMapper() : Handler{Mode::thru()} {
         m_mapping[c] = channels_t::wrap(c);
 }
 
+bool ChannelMapper::is_fusable() const {
+    return true;
+}
+
 channel_map_t<channels_t> ChannelMapper::mapping() const {
     std::lock_guard<std::mutex> guard{m_mutex};
     return m_mapping;
@@ -36,6 +36,8 @@ public:
 
     explicit ChannelMapper();
 
+    bool is_fusable() const override;
+
     channel_map_t<channels_t> mapping() const;
     void set_mapping(const channel_map_t<channels_t>& mapping);
     void reset_mapping(channels_t channels = channels_t::full());
@@ -28,6 +28,10 @@ ForwardHandler::ForwardHandler() : Handler{Mode::thru()} {
 
 }
 
+bool ForwardHandler::is_fusable() const {
+    return true;
+}
+
 Handler::Result ForwardHandler::handle_message(const Message& message) {
     forward_message(message);
     return Result::success;
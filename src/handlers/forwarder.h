@@ -32,6 +32,8 @@ class ForwardHandler : public Handler {
 public:
     explicit ForwardHandler();
 
+    bool is_fusable() const override;
+
 protected:
     Result handle_message(const Message& message) override;
 
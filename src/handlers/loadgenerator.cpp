@@ -0,0 +1,308 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include "loadgenerator.h"
+
+namespace {
+
+constexpr auto playing_state = Handler::State::from_integral(0x4);
+constexpr auto spin_margin = std::chrono::microseconds{500}; /*!< time spent polling the clock before a due time */
+constexpr auto sleep_period = std::chrono::milliseconds{10}; /*!< maximum time spent without checking the state */
+constexpr size_t sequence_capacity = 0x10000; /*!< number of distinct sequence numbers (size of track_t) */
+
+using stamp_duration = std::chrono::duration<uint32_t, std::micro>; /*!< wraps after an hour, more than any latency */
+
+uint32_t make_stamp(Clock::time_type time) {
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count());
+}
+
+uint16_t next_origin() {
+    // 0 is reserved for messages without origin
+    static std::atomic<uint16_t> last_origin {0};
+    uint16_t origin;
+    do {
+        origin = ++last_origin;
+    } while (origin == 0);
+    return origin;
+}
+
+const auto stop_notes = Event::controller(channels_t::full(), controller_ns::all_notes_off_controller);
+
+template<typename FlagsT, size_t N>
+void fill_values(vararray_t<typename FlagsT::value_type, N>& values, FlagsT flags) {
+    values.clear();
+    for (auto value : flags)
+        values.push_back(value);
+}
+
+}
+
+//===============
+// LoadGenerator
+//===============
+
+const SystemExtension<double> LoadGenerator::rate_ext {"LoadGenerator.rate"};
+const SystemExtension<size_t> LoadGenerator::burst_ext {"LoadGenerator.burst"};
+const SystemExtension<families_t> LoadGenerator::families_ext {"LoadGenerator.families"};
+const SystemExtension<channels_t> LoadGenerator::channels_ext {"LoadGenerator.channels"};
+const SystemExtension<size_t> LoadGenerator::sysex_size_ext {"LoadGenerator.sysex_size"};
+const SystemExtension<bool> LoadGenerator::poisson_ext {"LoadGenerator.poisson"};
+const SystemExtension<unsigned int> LoadGenerator::seed_ext {"LoadGenerator.seed"};
+
+LoadGenerator::LoadGenerator() : Handler{Mode::io()}, m_origin{next_origin()} {
+    m_pending_notes.fill(-1);
+}
+
+LoadGenerator::~LoadGenerator() {
+    stop();
+}
+
+size_t LoadGenerator::emitted() const {
+    return m_emitted.load();
+}
+
+uint16_t LoadGenerator::origin() const {
+    return m_origin;
+}
+
+Handler::Result LoadGenerator::handle_open(State state) {
+    if (state & State::forward())
+        start();
+    return Handler::handle_open(state);
+}
+
+Handler::Result LoadGenerator::handle_close(State state) {
+    if (state & State::forward())
+        stop();
+    return Handler::handle_close(state);
+}
+
+Handler::Result LoadGenerator::handle_message(const Message& message) {
+    if (message.event.is(family_t::extended_system)) {
+        std::lock_guard<std::mutex> guard{m_mutex};
+        if (rate_ext.affects(message.event)) {
+            const auto rate = rate_ext.decode(message.event);
+            if (rate <= 0.)
+                return Result::fail;
+            m_settings.rate = rate;
+            return Result::success;
+        }
+        if (burst_ext.affects(message.event)) {
+            const auto burst = burst_ext.decode(message.event);
+            if (burst == 0)
+                return Result::fail;
+            m_settings.burst = burst;
+            return Result::success;
+        }
+        if (families_ext.affects(message.event)) {
+            m_settings.families = families_ext.decode(message.event) & generated_families();
+            return Result::success;
+        }
+        if (channels_ext.affects(message.event)) {
+            m_settings.channels = channels_ext.decode(message.event);
+            return Result::success;
+        }
+        if (sysex_size_ext.affects(message.event)) {
+            m_settings.sysex_size = std::max<size_t>(sysex_size_ext.decode(message.event), 3);
+            return Result::success;
+        }
+        if (poisson_ext.affects(message.event)) {
+            m_settings.poisson = poisson_ext.decode(message.event);
+            return Result::success;
+        }
+        if (seed_ext.affects(message.event)) {
+            m_settings.seed = seed_ext.decode(message.event);
+            return Result::success;
+        }
+    }
+    return Result::unhandled;
+}
+
+families_t LoadGenerator::handled_families() const {
+    return families_t::wrap(family_t::extended_system);
+}
+
+families_t LoadGenerator::produced_families() const {
+    return generated_families() | families_t::wrap(family_t::note_off);
+}
+
+void LoadGenerator::start() {
+    if (m_worker.joinable())
+        return;
+    Settings settings;
+    {
+    std::lock_guard<std::mutex> guard{m_mutex};
+    settings = m_settings;
+    }
+    m_emitted = 0;
+    m_pending_notes.fill(-1);
+    activate_state(playing_state);
+    m_worker = std::thread{[this, settings] { run(settings); }};
+}
+
+void LoadGenerator::stop() {
+    deactivate_state(playing_state);
+    if (m_worker.joinable()) {
+        m_worker.join();
+        produce_message(stop_notes);
+    }
+}
+
+void LoadGenerator::run(Settings settings) {
+    std::mt19937 engine{settings.seed};
+    vararray_t<family_t, families_t::capacity()> families;
+    vararray_t<channel_t, channels_t::capacity()> channels;
+    size_t slot = 0;
+    track_t sequence = 0;
+    auto due = clock_type::now();
+    while (true) {
+        // wait until the due time, sleeping while it is far and polling the clock when it is close
+        for (auto now = clock_type::now() ; now < due ; now = clock_type::now()) {
+            if (state().none(playing_state))
+                return;
+            if (due - now > spin_margin)
+                std::this_thread::sleep_for(std::min<clock_type::duration>(due - now - spin_margin, sleep_period));
+        }
+        if (state().none(playing_state))
+            return;
+        // emit the burst
+        fill_values(families, settings.families);
+        fill_values(channels, settings.channels);
+        if (!families.empty() && !channels.empty()) {
+            for (size_t i=0 ; i < settings.burst ; ++i, ++slot) {
+                const auto channel = channels[slot % channels.size()];
+                const auto family = families[(slot / channels.size()) % families.size()];
+                if (auto event = make_event(settings, family, channel, slot)) {
+                    Message message{std::move(event).with_track(sequence++), this};
+                    message.origin = m_origin;
+                    message.stamp = make_stamp(clock_type::now());
+                    forward_message(std::move(message));
+                    ++m_emitted;
+                }
+            }
+        }
+        // refresh settings & compute the next due time
+        {
+        std::lock_guard<std::mutex> guard{m_mutex};
+        if (settings.seed != m_settings.seed)
+            engine.seed(m_settings.seed);
+        settings = m_settings;
+        }
+        const auto mean_interval = static_cast<double>(settings.burst) / settings.rate;
+        const auto interval = settings.poisson ? std::exponential_distribution<double>{1. / mean_interval}(engine) : mean_interval;
+        due += std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>{interval});
+        // do not try to catch up after a stall longer than a second
+        const auto now = clock_type::now();
+        if (due + std::chrono::seconds{1} < now)
+            due = now;
+    }
+}
+
+Event LoadGenerator::make_event(const Settings& settings, family_t family, channel_t channel, size_t slot) {
+    const auto channels = channels_t::wrap(channel);
+    const auto value = to_data_byte(slot);
+    switch (family) {
+    case family_t::note_on:
+    case family_t::note_off: {
+        // alternate note-on & note-off for the same note so that no note remains active
+        auto& pending_note = m_pending_notes[channel];
+        if (pending_note >= 0)
+            return Event::note_off(channels, static_cast<byte_t>(std::exchange(pending_note, -1)));
+        if (family == family_t::note_off)
+            return Event::note_off(channels, to_data_byte(0x24 + slot % 0x30));
+        pending_note = 0x24 + slot % 0x30;
+        return Event::note_on(channels, static_cast<byte_t>(pending_note), 0x40);
+    }
+    case family_t::aftertouch: return Event::aftertouch(channels, 0x3c, value);
+    case family_t::controller: return Event::controller(channels, controller_ns::general_purpose_slider_controllers[0], value);
+    case family_t::program_change: return Event::program_change(channels, value);
+    case family_t::channel_pressure: return Event::channel_pressure(channels, value);
+    case family_t::pitch_wheel: return Event::pitch_wheel(channels, short_ns::cut(static_cast<uint16_t>(slot & 0x3fff)));
+    case family_t::sysex: {
+        // non-commercial sysex filled with a counter
+        std::vector<byte_t> data(settings.sysex_size - 1, value);
+        data.front() = 0x7d;
+        data.back() = 0xf7;
+        return Event::sys_ex({data.data(), data.data() + data.size()});
+    }
+    default: return {};
+    }
+}
+
+//===========
+// LoadProbe
+//===========
+
+const SystemExtension<void> LoadProbe::reset_ext {"LoadProbe.reset"};
+
+double LoadProbe::Statistics::rate() const {
+    const auto elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(span(period)).count();
+    return elapsed > 0. ? (received - 1) / elapsed : 0.;
+}
+
+LoadProbe::LoadProbe() : Handler{Mode::out()} {
+
+}
+
+LoadProbe::Statistics LoadProbe::statistics() const {
+    std::lock_guard<std::mutex> guard{m_mutex};
+    return m_statistics;
+}
+
+void LoadProbe::reset() {
+    std::lock_guard<std::mutex> guard{m_mutex};
+    m_statistics = {};
+    m_expected.clear();
+}
+
+Handler::Result LoadProbe::handle_message(const Message& message) {
+    const auto now = clock_type::now();
+    if (message.event.is(family_t::extended_system) && reset_ext.affects(message.event)) {
+        reset();
+        return Result::success;
+    }
+    std::lock_guard<std::mutex> guard{m_mutex};
+    if (m_statistics.received++ == 0)
+        m_statistics.period.min = now;
+    m_statistics.period.max = now;
+    if (message.origin != 0) {
+        const auto sequence = message.event.track();
+        // check sequence continuity, considering the numbers wrap around
+        auto it = m_expected.find(message.origin);
+        if (it == m_expected.end())
+            it = m_expected.emplace(message.origin, sequence).first;
+        const auto gap = static_cast<track_t>(sequence - it->second);
+        if (gap < sequence_capacity / 2) {
+            m_statistics.lost += gap;
+            it->second = static_cast<track_t>(sequence + 1);
+        } else {
+            ++m_statistics.unordered;
+        }
+        // measure latency
+        // the difference of stamps is exact modulo their range
+        const auto latency = std::chrono::duration_cast<duration_type>(stamp_duration{static_cast<uint32_t>(make_stamp(now) - message.stamp)});
+        m_statistics.min_latency = std::min(m_statistics.min_latency, latency);
+        m_statistics.max_latency = std::max(m_statistics.max_latency, latency);
+        m_statistics.latency += latency;
+        m_statistics.hops += static_cast<double>(message.hops);
+        ++m_statistics.measured;
+    }
+    return Result::success;
+}
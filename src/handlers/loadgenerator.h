@@ -0,0 +1,150 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef HANDLERS_LOAD_GENERATOR_H
+#define HANDLERS_LOAD_GENERATOR_H
+
+#include <random>
+#include <map>
+#include "core/handler.h"
+
+//===============
+// LoadGenerator
+//===============
+
+/**
+ * The LoadGenerator produces a synthetic stream of events meant for stress testing a chain of handlers.
+ *
+ * Events are emitted in bursts, the interval between two bursts being either fixed or
+ * drawn from an exponential distribution (poisson process) so that the average rate is respected.
+ * Families produced are picked in a round-robin fashion, each event being bound to a single channel of the spread.
+ * Note-on events are always paired with a note-off on the next slot of the same channel.
+ *
+ * Each event is tagged with a rolling sequence number stored in its track,
+ * messages carry the identifier of the generator as origin and their emission time in microseconds as stamp,
+ * so that a LoadProbe can compute latency and losses without referring to the generator.
+ *
+ * @warning handlers relying on tracks (TrackFilter, SequenceWriter) will see meaningless values
+ *
+ */
+
+class LoadGenerator : public Handler {
+
+public:
+    using clock_type = Clock::clock_type;
+    using time_type = Clock::time_type;
+
+    static constexpr auto generated_families() { return families_t::standard_voice() | families_t::wrap(family_t::sysex); }
+
+    static const SystemExtension<double> rate_ext; /*!< average number of events per second */
+    static const SystemExtension<size_t> burst_ext; /*!< number of events emitted together */
+    static const SystemExtension<families_t> families_ext; /*!< families generated (restricted to generated_families) */
+    static const SystemExtension<channels_t> channels_ext; /*!< channels used in turn */
+    static const SystemExtension<size_t> sysex_size_ext; /*!< size of sysex payload (including framing bytes) */
+    static const SystemExtension<bool> poisson_ext; /*!< use random intervals instead of fixed ones */
+    static const SystemExtension<unsigned int> seed_ext; /*!< seed used for random intervals, makes runs reproducible */
+
+    explicit LoadGenerator();
+    ~LoadGenerator();
+
+    size_t emitted() const; /*!< number of events emitted since the last start */
+    uint16_t origin() const; /*!< identifier carried by the messages of the generator, reused after 65535 generators */
+
+protected:
+    Result handle_open(State state) override;
+    Result handle_close(State state) override;
+    Result handle_message(const Message& message) override;
+    families_t handled_families() const override;
+    families_t produced_families() const override;
+
+private:
+    struct Settings {
+        double rate {1000.};
+        size_t burst {1};
+        families_t families {families_t::fuse(family_t::note_on, family_t::controller)};
+        channels_t channels {channels_t::melodic()};
+        size_t sysex_size {16};
+        bool poisson {false};
+        unsigned int seed {0};
+    };
+
+    void start();
+    void stop();
+    void run(Settings settings);
+    Event make_event(const Settings& settings, family_t family, channel_t channel, size_t slot);
+
+    Settings m_settings;
+    channel_map_t<int> m_pending_notes; /*!< note waiting for its note-off by channel, -1 if none */
+    std::atomic<size_t> m_emitted {0};
+    const uint16_t m_origin;
+    std::thread m_worker;
+    mutable std::mutex m_mutex; /*!< mutex protecting settings */
+
+};
+
+//===========
+// LoadProbe
+//===========
+
+/**
+ * The LoadProbe is the companion sink of the LoadGenerator.
+ * It measures the arrival latency and detects lost events by following sequence numbers of each generator.
+ * Messages without origin do not come from a LoadGenerator and are only counted.
+ */
+
+class LoadProbe : public Handler {
+
+public:
+    using clock_type = Clock::clock_type;
+    using time_type = Clock::time_type;
+    using duration_type = std::chrono::duration<double, std::micro>;
+
+    struct Statistics {
+        size_t received {0}; /*!< messages received */
+        size_t measured {0}; /*!< messages coming from a generator */
+        size_t lost {0}; /*!< gaps detected in sequence numbers */
+        size_t unordered {0}; /*!< messages received with a past sequence number */
+        duration_type min_latency {duration_type::max()};
+        duration_type max_latency {duration_type::zero()};
+        accumulator_t<duration_type> latency {duration_type::zero()};
+        accumulator_t<double> hops {0.}; /*!< queues crossed by measured messages, see Handler::is_fusable */
+        range_t<time_type> period {}; /*!< arrival time of the first and the last message */
+
+        double rate() const; /*!< messages received per second */
+    };
+
+    static const SystemExtension<void> reset_ext;
+
+    explicit LoadProbe();
+
+    Statistics statistics() const;
+    void reset();
+
+protected:
+    Result handle_message(const Message& message) override;
+
+private:
+    Statistics m_statistics;
+    std::map<uint16_t, track_t> m_expected; /*!< next sequence number expected for each generator origin */
+    mutable std::mutex m_mutex; /*!< mutex protecting statistics */
+
+};
+
+#endif // HANDLERS_LOAD_GENERATOR_H
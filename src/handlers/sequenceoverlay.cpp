@@ -0,0 +1,195 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include "sequenceoverlay.h"
+
+namespace {
+
+auto next_track(const Sequence& sequence) {
+    const auto range = sequence.track_range();
+    return range.max <= std::numeric_limits<track_t>::max() ? static_cast<track_t>(range.max) : default_track;
+}
+
+auto make_drum(byte_t drum, byte_t velocity, track_t track) {
+    return Event::note_on(channels_t::drums(), drum, velocity).with_track(track);
+}
+
+auto beats_per_bar(const TimedEvent& time_signature) {
+    return std::max<uint32_t>(1, extraction_ns::get_meta_cview(time_signature.event).min[0]);
+}
+
+uint32_t ticks_until(timestamp_t first, timestamp_t tick_base, timestamp_t timestamp) {
+    return timestamp <= first ? 0 : static_cast<uint32_t>(std::ceil((timestamp - first) / tick_base));
+}
+
+}
+
+//=================
+// SequenceOverlay
+//=================
+
+timestamp_t SequenceOverlay::preroll(const Sequence& /*sequence*/, timestamp_t /*origin*/) const {
+    return 0.;
+}
+
+//==================
+// MetronomeOverlay
+//==================
+
+MetronomeOverlay::MetronomeOverlay(byte_t velocity) : SequenceOverlay{}, m_velocity{velocity} {
+
+}
+
+void MetronomeOverlay::reset(const Sequence& sequence, timestamp_t /*origin*/, timestamp_t timestamp) {
+    const auto track = next_track(sequence);
+    m_sequence = &sequence;
+    m_click = make_drum(drum_ns::metronome_click_drum, m_velocity, track);
+    m_bell = make_drum(drum_ns::metronome_bell_drum, m_velocity, track);
+    // start from the time signature in effect at timestamp
+    const auto& signatures = sequence.clock().time_signature();
+    m_signature = std::upper_bound(signatures.begin(), signatures.end(), timestamp);
+    if (m_signature != signatures.begin())
+        --m_signature;
+    m_tick = ticks_until(m_signature->timestamp, static_cast<timestamp_t>(sequence.clock().ppqn()), timestamp);
+    update();
+}
+
+const TimedEvent* MetronomeOverlay::peek() const {
+    if (!m_sequence || m_signature == m_sequence->clock().time_signature().end())
+        return nullptr;
+    return &m_item;
+}
+
+void MetronomeOverlay::pop() {
+    ++m_tick;
+    update();
+}
+
+void MetronomeOverlay::update() {
+    // same rules as Sequence::make_metronome
+    const auto last = m_sequence->clock().time_signature().end();
+    const auto tick_base = static_cast<timestamp_t>(m_sequence->clock().ppqn());
+    for ( ; m_signature != last ; ++m_signature, m_tick = 0) {
+        const auto next_it = std::next(m_signature);
+        const auto next_timestamp = next_it == last ? m_sequence->last_timestamp() : next_it->timestamp;
+        const auto timestamp = m_signature->timestamp + m_tick * tick_base;
+        if (timestamp + tick_base / 2 < next_timestamp) {
+            m_item = TimedEvent{timestamp, (m_tick % beats_per_bar(*m_signature) == 0) ? m_bell : m_click};
+            return;
+        }
+    }
+}
+
+//================
+// CountInOverlay
+//================
+
+CountInOverlay::CountInOverlay(uint32_t bars, byte_t velocity) : SequenceOverlay{}, m_bars{bars}, m_velocity{velocity} {
+
+}
+
+timestamp_t CountInOverlay::preroll(const Sequence& sequence, timestamp_t origin) const {
+    return m_bars * beats_per_bar(sequence.clock().last_time_signature(origin)) * static_cast<timestamp_t>(sequence.clock().ppqn());
+}
+
+void CountInOverlay::reset(const Sequence& sequence, timestamp_t origin, timestamp_t timestamp) {
+    const auto track = next_track(sequence);
+    m_click = make_drum(drum_ns::metronome_click_drum, m_velocity, track);
+    m_bell = make_drum(drum_ns::metronome_bell_drum, m_velocity, track);
+    m_tick_base = static_cast<timestamp_t>(sequence.clock().ppqn());
+    m_beats = beats_per_bar(sequence.clock().last_time_signature(origin));
+    m_count = m_bars * m_beats;
+    m_first = origin - preroll(sequence, origin);
+    m_tick = ticks_until(m_first, m_tick_base, timestamp);
+    update();
+}
+
+const TimedEvent* CountInOverlay::peek() const {
+    return m_tick < m_count ? &m_item : nullptr;
+}
+
+void CountInOverlay::pop() {
+    ++m_tick;
+    update();
+}
+
+void CountInOverlay::update() {
+    if (m_tick < m_count)
+        m_item = TimedEvent{m_first + m_tick * m_tick_base, (m_tick % m_beats == 0) ? m_bell : m_click};
+}
+
+//============
+// CueOverlay
+//============
+
+CueOverlay::CueOverlay(std::vector<timestamp_t> cues, byte_t velocity) :
+    SequenceOverlay{}, m_cues{std::move(cues)}, m_cue{m_cues.end()}, m_click{make_drum(drum_ns::metronome_click_drum, velocity, default_track)} {
+
+}
+
+void CueOverlay::reset(const Sequence& sequence, timestamp_t /*origin*/, timestamp_t timestamp) {
+    m_click.set_track(next_track(sequence));
+    m_cue = std::lower_bound(m_cues.cbegin(), m_cues.cend(), timestamp);
+    update();
+}
+
+const TimedEvent* CueOverlay::peek() const {
+    return m_cue != m_cues.end() ? &m_item : nullptr;
+}
+
+void CueOverlay::pop() {
+    ++m_cue;
+    update();
+}
+
+void CueOverlay::update() {
+    if (m_cue != m_cues.end())
+        m_item = TimedEvent{*m_cue, m_click};
+}
+
+//==============
+// ClockOverlay
+//==============
+
+ClockOverlay::ClockOverlay() : SequenceOverlay{}, m_item{0., Event::clock()} {
+
+}
+
+void ClockOverlay::reset(const Sequence& sequence, timestamp_t /*origin*/, timestamp_t timestamp) {
+    m_sequence = &sequence;
+    m_pulse = std::ceil(sequence.clock().timestamp2clock(timestamp));
+    update();
+}
+
+const TimedEvent* ClockOverlay::peek() const {
+    return m_sequence ? &m_item : nullptr;
+}
+
+void ClockOverlay::pop() {
+    ++m_pulse;
+    update();
+}
+
+void ClockOverlay::update() {
+    m_item.timestamp = m_sequence->clock().clock2timestamp(m_pulse);
+}
@@ -0,0 +1,175 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+
+#ifndef HANDLERS_SEQUENCE_OVERLAY_H
+#define HANDLERS_SEQUENCE_OVERLAY_H
+
+#include "core/sequence.h"
+
+//=================
+// SequenceOverlay
+//=================
+
+/**
+ * An overlay generates events on the fly that the SequenceReader merges with its sequence while playing,
+ * the sequence itself is never modified.
+ *
+ * Overlays are stateful generators driven by a single reader,
+ * items must be generated in chronological order.
+ *
+ */
+
+class SequenceOverlay {
+
+public:
+    virtual ~SequenceOverlay() = default;
+
+    virtual timestamp_t preroll(const Sequence& sequence, timestamp_t origin) const; /*!< time needed before origin when playback starts (default 0) */
+    virtual void reset(const Sequence& sequence, timestamp_t origin, timestamp_t timestamp) = 0; /*!< restart generation at timestamp, origin is the position played from */
+    virtual const TimedEvent* peek() const = 0; /*!< next item, nullptr when exhausted */
+    virtual void pop() = 0; /*!< move to the next item */
+
+};
+
+//==================
+// MetronomeOverlay
+//==================
+
+/**
+ * Lazy equivalent of Sequence::make_metronome:
+ * clicks each quarter note and rings each bar according to the time signatures of the sequence.
+ *
+ */
+
+class MetronomeOverlay : public SequenceOverlay {
+
+public:
+    explicit MetronomeOverlay(byte_t velocity = 0x7f);
+
+    void reset(const Sequence& sequence, timestamp_t origin, timestamp_t timestamp) override;
+    const TimedEvent* peek() const override;
+    void pop() override;
+
+private:
+    void update();
+
+    byte_t m_velocity;
+    const Sequence* m_sequence {nullptr};
+    TimedEvents::const_iterator m_signature; /*!< time signature of the current item */
+    uint32_t m_tick {0}; /*!< quarter notes since the time signature */
+    Event m_click;
+    Event m_bell;
+    TimedEvent m_item;
+
+};
+
+//================
+// CountInOverlay
+//================
+
+/**
+ * Plays some bars of metronome before the position playback starts from.
+ * Seeking while playing does not count in again.
+ *
+ */
+
+class CountInOverlay : public SequenceOverlay {
+
+public:
+    explicit CountInOverlay(uint32_t bars = 1, byte_t velocity = 0x7f);
+
+    timestamp_t preroll(const Sequence& sequence, timestamp_t origin) const override;
+    void reset(const Sequence& sequence, timestamp_t origin, timestamp_t timestamp) override;
+    const TimedEvent* peek() const override;
+    void pop() override;
+
+private:
+    void update();
+
+    uint32_t m_bars;
+    byte_t m_velocity;
+    timestamp_t m_first {0.}; /*!< timestamp of the first click */
+    timestamp_t m_tick_base {0.};
+    uint32_t m_beats {0}; /*!< beats per bar */
+    uint32_t m_tick {0};
+    uint32_t m_count {0}; /*!< number of clicks */
+    Event m_click;
+    Event m_bell;
+    TimedEvent m_item;
+
+};
+
+//============
+// CueOverlay
+//============
+
+/**
+ * Clicks at arbitrary timestamps, such as markers.
+ *
+ */
+
+class CueOverlay : public SequenceOverlay {
+
+public:
+    explicit CueOverlay(std::vector<timestamp_t> cues, byte_t velocity = 0x7f); /*!< cues are sorted */
+
+    void reset(const Sequence& sequence, timestamp_t origin, timestamp_t timestamp) override;
+    const TimedEvent* peek() const override;
+    void pop() override;
+
+private:
+    void update();
+
+    std::vector<timestamp_t> m_cues;
+    std::vector<timestamp_t>::const_iterator m_cue;
+    Event m_click;
+    TimedEvent m_item;
+
+};
+
+//==============
+// ClockOverlay
+//==============
+
+/**
+ * Generates MIDI clock pulses (24 per quarter note) aligned on the quarter notes of the sequence.
+ *
+ */
+
+class ClockOverlay : public SequenceOverlay {
+
+public:
+    explicit ClockOverlay();
+
+    void reset(const Sequence& sequence, timestamp_t origin, timestamp_t timestamp) override;
+    const TimedEvent* peek() const override;
+    void pop() override;
+
+private:
+    void update();
+
+    const Sequence* m_sequence {nullptr};
+    double m_pulse {0.};
+    TimedEvent m_item;
+
+};
+
+#endif // HANDLERS_SEQUENCE_OVERLAY_H
@@ -20,6 +20,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include "sequencereader.h"
 #include <algorithm>
+#include <cmath>
+#include <unordered_map>
 
 namespace {
 
@@ -27,6 +29,15 @@ const auto stop_sounds = Event::controller(channels_t::full(), controller_ns::al
 const auto stop_notes = Event::controller(channels_t::full(), controller_ns::all_notes_off_controller);
 const auto stop_all = Event::reset();
 
+const Event& silence_event(SequenceReader::Silence silence) {
+    switch (silence) {
+    case SequenceReader::Silence::notes: return stop_notes;
+    case SequenceReader::Silence::sounds: return stop_sounds;
+    case SequenceReader::Silence::all: break;
+    }
+    return stop_all;
+}
+
 auto make_lower(const Sequence& sequence) { return SequenceReader::position_type{sequence.begin(), sequence.first_timestamp()}; }
 auto make_lower(const Sequence& sequence, timestamp_t timestamp) { return SequenceReader::position_type{std::lower_bound(sequence.begin(), sequence.end(), timestamp), timestamp}; }
 auto make_upper(const Sequence& sequence, timestamp_t timestamp) { return SequenceReader::position_type{std::upper_bound(sequence.begin(), sequence.end(), timestamp), timestamp}; }
@@ -34,6 +45,21 @@ auto make_upper(const Sequence& sequence) { return SequenceReader::position_type
 
 constexpr auto playing_state = Handler::State::from_integral(0x4);
 
+constexpr size_t max_transitions = 16; /*!< transitions within a single step, bounds loops shorter than the period */
+
+constexpr auto chased_families = families_t::fuse(family_t::controller, family_t::program_change, family_t::channel_pressure, family_t::pitch_wheel);
+
+constexpr uint16_t max_song_position = 0x3fff;
+
+SequenceReader::time_type reception_time(const Message& message) {
+#ifdef MIDILAB_ENABLE_TIMING
+    return message.time_point;
+#else
+    static_cast<void>(message);
+    return SequenceReader::clock_type::now();
+#endif
+}
+
 }
 
 //================
@@ -44,40 +70,80 @@ const SystemExtension<void> SequenceReader::toggle_ext {"SequenceReader.toggle"}
 const SystemExtension<void> SequenceReader::pause_ext {"SequenceReader.pause"};
 const SystemExtension<double> SequenceReader::distorsion_ext {"SequenceReader.distorsion"};
 
-SequenceReader::SequenceReader() : Handler{Mode::io()} {
-    m_position = m_limits.min = make_lower(m_sequence);
-    m_limits.max = make_upper(m_sequence);
+constexpr std::chrono::milliseconds SequenceReader::period;
+constexpr std::chrono::milliseconds SequenceReader::gap_tolerance;
+constexpr double SequenceReader::pll_frequency_gain;
+constexpr double SequenceReader::pll_phase_gain;
+
+void SequenceReader::JitterAccumulator::add(double value) {
+    ++count;
+    sum += value;
+    sum2 += value * value;
+    max = std::max(max, value);
+}
+
+SequenceReader::Jitter SequenceReader::JitterAccumulator::get() const {
+    if (count == 0)
+        return {0, 0., 0., 0.};
+    const auto mean = sum / count;
+    return {count, mean, std::sqrt(std::max(0., sum2 / count - mean * mean)), max};
+}
+
+void SequenceReader::JitterSnapshot::store(const Jitter& jitter) {
+    mean = jitter.mean;
+    deviation = jitter.deviation;
+    max = jitter.max;
+    count = jitter.count;
+}
+
+SequenceReader::Jitter SequenceReader::JitterSnapshot::load() const {
+    return {count, mean, deviation, max};
+}
+
+SequenceReader::SequenceReader() : Handler{Mode::io()}, m_sequence{std::make_shared<const Sequence>()} {
+    m_position = m_limits.min = make_lower(*m_sequence);
+    m_limits.max = make_upper(*m_sequence);
+    publish();
+    m_worker = std::thread{[this] { run(); }};
 }
 
 SequenceReader::~SequenceReader() {
-    stop_playing(stop_all, false, false);
+    stop_playing(Silence::all, false, false);
+    m_running = false;
+    push({Command::Kind::stop, Silence::all, false, false, 0.}); // wakes up the worker, nothing is sent
+    m_worker.join();
 }
 
-const Sequence& SequenceReader::sequence() const {
-    return m_sequence;
+SequenceReader::sequence_type SequenceReader::sequence() const {
+    return std::atomic_load(&m_sequence);
 }
 
-void SequenceReader::set_sequence(Sequence sequence) {
-    stop_playing(stop_all, false, false);
+void SequenceReader::set_sequence(sequence_type sequence) {
+    stop_playing(Silence::all, false, false);
     std::lock_guard<std::mutex> guard{m_mutex};
-    m_sequence = std::move(sequence);
-    m_position = m_limits.min = make_lower(m_sequence);
-    m_limits.max = make_upper(m_sequence);
+    assign(std::move(sequence));
+    m_position = m_limits.min = make_lower(*m_sequence);
+    m_limits.max = make_upper(*m_sequence);
+    reset_overlays(m_position.second);
+    publish();
 }
 
-void SequenceReader::replace_sequence(Sequence sequence) {
+void SequenceReader::replace_sequence(sequence_type sequence) {
     std::lock_guard<std::mutex> guard{m_mutex};
-    m_sequence = std::move(sequence);
-    m_position = make_lower(m_sequence, m_position.second);
-    m_limits.min = make_lower(m_sequence, m_limits.min.second);
-    m_limits.max = make_upper(m_sequence, m_limits.max.second);
+    assign(std::move(sequence));
+    m_position = make_lower(*m_sequence, m_position.second);
+    m_limits.min = make_lower(*m_sequence, m_limits.min.second);
+    m_limits.max = make_upper(*m_sequence, m_limits.max.second);
+    m_base_time = m_sequence->clock().last_base_time(m_position.second);
+    reset_overlays(m_position.second);
+    publish();
 }
 
-const std::map<byte_t, Sequence>& SequenceReader::sequences() const {
+const std::map<byte_t, SequenceReader::sequence_type>& SequenceReader::sequences() const {
     return m_sequences;
 }
 
-void SequenceReader::load_sequence(byte_t id, Sequence sequence) {
+void SequenceReader::load_sequence(byte_t id, sequence_type sequence) {
     m_sequences[id] = std::move(sequence);
 }
 
@@ -89,16 +155,65 @@ bool SequenceReader::select_sequence(byte_t id) {
     return true;
 }
 
-double SequenceReader::distorsion() const {
+void SequenceReader::insert_overlay(overlay_type overlay) {
     std::lock_guard<std::mutex> guard{m_mutex};
-    return m_distorsion;
+    overlay->reset(*m_sequence, m_position.second, m_position.second);
+    m_overlays.push_back(std::move(overlay));
+}
+
+void SequenceReader::remove_overlay(const overlay_type& overlay) {
+    std::lock_guard<std::mutex> guard{m_mutex};
+    m_overlays.erase(std::remove(m_overlays.begin(), m_overlays.end(), overlay), m_overlays.end());
+}
+
+void SequenceReader::set_looping(bool looping) {
+    push({Command::Kind::loop, Silence::all, false, false, looping ? 1. : 0.});
+}
+
+void SequenceReader::set_chasing(bool chasing) {
+    push({Command::Kind::chase, Silence::all, false, false, chasing ? 1. : 0.});
+}
+
+SequenceReader::sequence_type SequenceReader::next_sequence() const {
+    return std::atomic_load(&m_next_sequence);
+}
+
+void SequenceReader::set_next_sequence(sequence_type sequence) {
+    std::lock_guard<std::mutex> guard{m_mutex};
+    std::atomic_store(&m_next_sequence, std::move(sequence));
+    publish();
+}
+
+SequenceReader::Sync SequenceReader::sync() const {
+    return m_snapshot_sync;
+}
+
+void SequenceReader::set_sync(Sync sync) {
+    m_snapshot_sync = sync;
+    push({Command::Kind::sync, Silence::all, false, false, static_cast<double>(sync)});
+}
+
+SequenceReader::Jitter SequenceReader::master_jitter() const {
+    return m_snapshot_master_jitter.load();
+}
+
+SequenceReader::Jitter SequenceReader::slave_jitter() const {
+    return m_snapshot_slave_jitter.load();
+}
+
+SequenceReader::duration_type SequenceReader::max_gap() const {
+    return duration_type{m_max_gap.load()};
+}
+
+double SequenceReader::distorsion() const {
+    return m_snapshot_distorsion;
 }
 
 Handler::Result SequenceReader::set_distorsion(double distorsion) {
     if (distorsion < 0)
         return Result::fail;
-    std::lock_guard<std::mutex> guard{m_mutex};
-    m_distorsion = distorsion;
+    m_snapshot_distorsion = distorsion;
+    push({Command::Kind::distorsion, Silence::all, false, false, distorsion});
     return Result::success;
 }
 
@@ -107,117 +222,455 @@ bool SequenceReader::is_playing() const {
 }
 
 bool SequenceReader::is_completed() const {
-    std::lock_guard<std::mutex> guard{m_mutex};
-    return m_position.first >= m_limits.max.first;
+    return m_snapshot_completed;
 }
 
 timestamp_t SequenceReader::position() const {
-    std::lock_guard<std::mutex> guard{m_mutex};
-    return m_position.second;
+    return m_snapshot_position;
 }
 
 void SequenceReader::set_position(timestamp_t timestamp) {
-    jump_position(make_lower(m_sequence, timestamp));
+    m_snapshot_position = timestamp;
+    m_snapshot_completed = timestamp > m_snapshot_upper;
+    push({Command::Kind::seek, Silence::all, false, false, timestamp});
 }
 
 range_t<timestamp_t> SequenceReader::limits() const {
-    std::lock_guard<std::mutex> guard{m_mutex};
-    return {m_limits.min.second, m_limits.max.second};
+    return {m_snapshot_lower, m_snapshot_upper};
 }
 
 void SequenceReader::set_lower(timestamp_t timestamp) {
-    bool needs_jump = false; // if begin has been set after the current position
-    {
-    std::lock_guard<std::mutex> guard{m_mutex};
-    m_limits.min = make_lower(m_sequence, timestamp);
-    needs_jump = m_position.first < m_limits.min.first;
-    }
-    if (needs_jump)
-        jump_position(m_limits.min);
+    m_snapshot_lower = timestamp;
+    push({Command::Kind::lower, Silence::all, false, false, timestamp});
 }
 
 void SequenceReader::set_upper(timestamp_t timestamp) {
-    std::lock_guard<std::mutex> guard{m_mutex};
-    m_limits.max = make_upper(m_sequence, timestamp);
-    if (m_position.first > m_limits.max.first)
-        m_position = m_limits.max;
-}
-
-void SequenceReader::jump_position(position_type position) {
-    const bool playing = is_playing();
-    stop_playing(stop_notes, true, false);
-    m_position = std::move(position);
-    if (playing)
-        start_playing(false);
+    m_snapshot_upper = timestamp;
+    push({Command::Kind::upper, Silence::all, false, false, timestamp});
 }
 
 bool SequenceReader::start_playing(bool rewind) {
     /// @todo adopt a strategy to forward settings at 0, when no note is available
+    std::lock_guard<std::mutex> guard{m_playing_mutex};
     // handler must be stopped
     if (is_playing())
         return false;
-    // ensure previous run is terminated
-    stop_playing(stop_sounds, false, false);
     // can't start if unable to generate events
     if (state().none(State::forward()))
         return false;
-    // reset position
-    if (rewind || m_position.first < m_limits.min.first)
-        m_position = m_limits.min;
-    // check upper bound
-    if (is_completed())
+    // check upper bound, the worker will check it again once the position is known
+    if (!rewind && m_snapshot_completed)
         return false;
-    // @note it may be a good idea to clean current notes on: produce_message(stop_notes);
-    // starts worker thread
-    m_worker = std::thread{ [this] {
-        activate_state(playing_state);
-        duration_type base_time = m_sequence.clock().last_base_time(position()); // current base time for 1 deltatime
-        range_t<time_type> time_loop = {{}, clock_type::now()};
-        range_t<TimedEvents::const_iterator> it_loop;
-        while (is_playing()) {
-            // update time loop
-            time_loop.min = std::exchange(time_loop.max, clock_type::now());
-            { // lock position resources
-                std::lock_guard<std::mutex> guard{m_mutex};
-                m_position.second += m_distorsion * span(time_loop) / base_time; // add deltatime to the current position
-                it_loop.min = m_position.first; // memorize starting position
-                m_position.first = std::lower_bound(m_position.first, m_limits.max.first, m_position.second); // get next position
-                it_loop.max = m_position.first; // memorize next position
-                if (m_position.first == m_limits.max.first) // stop when last event is reached
-                    deactivate_state(playing_state);
+    // ensure previous run is terminated
+    if (m_active.exchange(true))
+        push({Command::Kind::stop, Silence::sounds, true, false, 0.});
+    activate_state(playing_state);
+    push({Command::Kind::start, Silence::all, false, rewind, static_cast<double>(++m_generation)});
+    return true;
+}
+
+bool SequenceReader::stop_playing(Silence silence, bool always_send, bool rewind) {
+    {
+        std::lock_guard<std::mutex> guard{m_playing_mutex};
+        deactivate_state(playing_state);
+        ++m_generation;
+    }
+    const bool started = m_active.exchange(false);
+    if (rewind) {
+        m_snapshot_position = m_snapshot_lower.load();
+        m_snapshot_completed = false;
+    }
+    push({Command::Kind::stop, silence, started || always_send, rewind, 0.});
+    return started;
+}
+
+void SequenceReader::push(const Command& command) {
+    m_commands.push(command);
+    // the lock ensures the worker is either waiting or about to check the queue
+    { std::lock_guard<std::mutex> guard{m_signal_mutex}; }
+    m_signal.notify_one();
+}
+
+void SequenceReader::assign(sequence_type sequence) {
+    if (!sequence)
+        sequence = std::make_shared<const Sequence>();
+    TRACE_DEBUG(name() << ": sequence of " << sequence->memory() << " bytes, " << sequence->copies() << " copies, " << sequence.use_count() << " owners");
+    std::atomic_store(&m_sequence, std::move(sequence));
+    m_chase_sequence = nullptr;
+}
+
+void SequenceReader::publish() {
+    m_snapshot_position = m_position.second;
+    m_snapshot_lower = m_limits.min.second;
+    m_snapshot_upper = m_limits.max.second;
+    m_snapshot_completed = m_position.first >= m_limits.max.first && !is_looping() && !(m_playing && m_next_sequence);
+    if (m_master_jitter.count != m_snapshot_master_jitter.count)
+        m_snapshot_master_jitter.store(m_master_jitter.get());
+    if (m_slave_jitter.count != m_snapshot_slave_jitter.count)
+        m_snapshot_slave_jitter.store(m_slave_jitter.get());
+}
+
+void SequenceReader::run() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (true) {
+        // apply pending commands, seeks are merged until another command needs the position
+        bool seeking = false;
+        timestamp_t seek_target {};
+        Command command;
+        while (m_commands.pop(command)) {
+            if (command.kind == Command::Kind::seek) {
+                seeking = true;
+                seek_target = command.value;
+                continue;
             }
-            // forward events in the current range
-            for (const auto& item : it_loop) {
-                if (item.event.is(family_t::tempo))
-                    base_time = m_sequence.clock().base_time(item.event);
-                produce_message(item.event);
+            if (std::exchange(seeking, false))
+                jump_position(make_lower(*m_sequence, seek_target));
+            execute(command);
+        }
+        if (seeking)
+            jump_position(make_lower(*m_sequence, seek_target));
+        if (!m_running)
+            break;
+        if (m_playing)
+            step();
+        const auto timeout = next_timeout();
+        // events are produced without the lock so that slow or reentrant listeners never hold the callers
+        m_outgoing.swap(m_delivering);
+        lock.unlock();
+        deliver_events();
+        {
+            std::unique_lock<std::mutex> signal{m_signal_mutex};
+            const auto predicate = [this] { return !m_commands.empty() || !m_running; };
+            if (m_playing)
+                m_signal.wait_for(signal, timeout, predicate);
+            else
+                m_signal.wait(signal, predicate);
+        }
+        lock.lock();
+    }
+    m_outgoing.swap(m_delivering);
+    lock.unlock();
+    deliver_events();
+}
+
+void SequenceReader::post_event(const Event& event) {
+    m_outgoing.push_back(event);
+}
+
+void SequenceReader::deliver_events() {
+    for (auto& event : m_delivering)
+        produce_message(std::move(event));
+    m_delivering.clear();
+}
+
+void SequenceReader::execute(const Command& command) {
+    switch (command.kind) {
+    case Command::Kind::start:
+        if (command.rewind || m_position.first < m_limits.min.first || (is_looping() && m_position.first >= m_limits.max.first))
+            m_position = m_limits.min;
+        m_run_generation = static_cast<uint32_t>(command.value);
+        if (m_position.first >= m_limits.max.first) {
+            finish_playing();
+        } else {
+            m_playing = true;
+            m_time = clock_type::now();
+            m_base_time = m_sequence->clock().last_base_time(m_position.second);
+            // play back the time needed by overlays before the position
+            const auto origin = m_position.second;
+            timestamp_t preroll = 0.;
+            for (const auto& overlay : m_overlays)
+                preroll = std::max(preroll, overlay->preroll(*m_sequence, origin));
+            m_position.second -= preroll;
+            reset_overlays(origin);
+            m_pulses = 0;
+            send_transport(command.rewind || origin <= m_limits.min.second);
+        }
+        break;
+    case Command::Kind::stop:
+        if (std::exchange(m_playing, false))
+            send_stop();
+        if (command.rewind)
+            m_position = m_limits.min;
+        if (command.notify)
+            post_event(silence_event(command.silence));
+        break;
+    case Command::Kind::lower:
+        m_limits.min = make_lower(*m_sequence, command.value);
+        if (m_position.first < m_limits.min.first) // if begin has been set after the current position
+            jump_position(m_limits.min);
+        break;
+    case Command::Kind::upper:
+        m_limits.max = make_upper(*m_sequence, command.value);
+        if (m_position.first > m_limits.max.first)
+            m_position = m_limits.max;
+        break;
+    case Command::Kind::distorsion:
+        m_distorsion = command.value;
+        break;
+    case Command::Kind::loop:
+        m_looping = command.value != 0.;
+        break;
+    case Command::Kind::chase:
+        m_chasing = command.value != 0.;
+        break;
+    case Command::Kind::sync:
+        set_sync_mode(static_cast<Sync>(static_cast<int>(command.value)));
+        break;
+    case Command::Kind::pulse:
+        lock_clock(time_type{std::chrono::duration_cast<clock_type::duration>(duration_type{command.value})});
+        break;
+    case Command::Kind::seek:
+        jump_position(make_lower(*m_sequence, command.value));
+        break;
+    }
+    // compute the state to chase before reaching the loop point
+    if (is_looping() && m_chasing)
+        update_chase();
+    publish();
+}
+
+void SequenceReader::step() {
+    // add deltatime to the current position
+    const auto now = clock_type::now();
+    m_position.second += m_distorsion * (now - std::exchange(m_time, now)) / m_base_time;
+    forward_events();
+    // continue from the lower limit or in the next sequence within the same step
+    for (size_t i=0 ; i < max_transitions && is_transitioning() ; ++i) {
+        transition();
+        forward_events();
+    }
+    // stop when last event is reached
+    if (m_position.first == m_limits.max.first && !is_looping() && !m_next_sequence) {
+        m_playing = false;
+        finish_playing();
+        send_stop();
+    }
+    publish();
+}
+
+void SequenceReader::finish_playing() {
+    // a start or stop requested meanwhile owns the state
+    std::lock_guard<std::mutex> guard{m_playing_mutex};
+    if (m_run_generation == m_generation)
+        deactivate_state(playing_state);
+}
+
+void SequenceReader::forward_events() {
+    range_t<TimedEvents::const_iterator> it_loop;
+    it_loop.min = m_position.first; // memorize starting position
+    m_position.first = std::lower_bound(m_position.first, m_limits.max.first, m_position.second); // get next position
+    it_loop.max = m_position.first; // memorize next position
+    // forward events in the current range merged with the overlays, sequence first on equal timestamps
+    const auto limit = std::min(m_position.second, m_limits.max.second);
+    auto it = it_loop.min;
+    while (true) {
+        SequenceOverlay* overlay = nullptr;
+        const TimedEvent* overlay_item = nullptr;
+        for (const auto& candidate : m_overlays) {
+            const auto* item = candidate->peek();
+            if (item && item->timestamp < limit && (!overlay_item || item->timestamp < overlay_item->timestamp)) {
+                overlay = candidate.get();
+                overlay_item = item;
             }
-            // asleep this thread for a minimal period
-            std::this_thread::sleep_for(std::chrono::milliseconds{2});
         }
-    }};
-    return true;
+        if (it != it_loop.max && (!overlay_item || !(overlay_item->timestamp < it->timestamp))) {
+            if (it->event.is(family_t::tempo))
+                m_base_time = m_sequence->clock().base_time(it->event);
+            post_event(it->event);
+            ++it;
+        } else if (overlay) {
+            // lateness of the pulse is the time elapsed since it was due
+            if (overlay == m_clock_overlay.get() && m_distorsion > 0.)
+                m_master_jitter.add(duration_type{(m_position.second - overlay_item->timestamp) * m_base_time / m_distorsion}.count());
+            post_event(overlay_item->event);
+            overlay->pop();
+        } else {
+            break;
+        }
+    }
 }
 
-bool SequenceReader::stop_playing(const Event& final_event, bool always_send, bool rewind) {
-    deactivate_state(playing_state); // notify the playing thread to stop
-    const bool started = m_worker.joinable();
-    if (started)
-        m_worker.join();
-    if (rewind)
+bool SequenceReader::is_looping() const {
+    return m_looping && m_limits.min.second < m_limits.max.second;
+}
+
+bool SequenceReader::is_transitioning() const {
+    if (m_position.first != m_limits.max.first || m_position.second < m_limits.max.second || m_distorsion <= 0.)
+        return false;
+    return is_looping() || m_next_sequence;
+}
+
+void SequenceReader::transition() {
+    // time elapsed since the boundary is carried over so that the timing is continuous
+    const auto excess = m_position.second - m_limits.max.second;
+    const auto base_time = m_base_time;
+    const bool looping = is_looping();
+    send_stop();
+    if (looping) {
+        post_event(stop_notes);
+        if (m_chasing) {
+            update_chase();
+            for (const auto& item : m_chase)
+                post_event(item.event);
+        }
         m_position = m_limits.min;
-    if (started || always_send)
-        produce_message(final_event);
-    return started;
+    } else {
+        post_event(stop_all);
+        assign(std::atomic_exchange(&m_next_sequence, sequence_type{}));
+        m_position = m_limits.min = make_lower(*m_sequence);
+        m_limits.max = make_upper(*m_sequence);
+    }
+    m_base_time = m_sequence->clock().last_base_time(m_position.second);
+    m_position.second += excess * (base_time / m_base_time);
+    reset_overlays(m_position.second);
+    m_pulses = 0;
+    send_transport(!looping);
+    // the gap is the delay between the boundary and its processing
+    const auto gap = excess * base_time / m_distorsion;
+    if (gap.count() > m_max_gap)
+        m_max_gap = gap.count();
+    if (gap > gap_tolerance)
+        TRACE_DEBUG(name() << ": transition delayed by " << gap.count() << " us");
+}
+
+void SequenceReader::update_chase() {
+    if (m_chase_sequence == m_sequence.get() && m_chase_position == m_limits.min.first)
+        return;
+    // keep the last event of each controller, program, pressure & pitch per channels
+    m_chase.clear();
+    std::unordered_map<uint32_t, size_t> indexes;
+    for (auto it = m_sequence->begin() ; it != m_limits.min.first ; ++it) {
+        const auto& event = it->event;
+        if (!event.is(chased_families))
+            continue;
+        const byte_t number = event.is(family_t::controller) ? extraction_ns::controller(event) : 0;
+        if (number >= controller_ns::all_sound_off_controller) // channel mode messages
+            continue;
+        const auto key = static_cast<uint32_t>(event.family()) << 24 | static_cast<uint32_t>(number) << 16 | event.channels().to_integral();
+        const auto inserted = indexes.emplace(key, m_chase.size());
+        if (inserted.second)
+            m_chase.push_back(*it);
+        else
+            m_chase[inserted.first->second] = *it;
+    }
+    m_chase_sequence = m_sequence.get();
+    m_chase_position = m_limits.min.first;
+}
+
+SequenceReader::duration_type SequenceReader::next_timeout() const {
+    duration_type timeout = period;
+    if (m_distorsion <= 0.)
+        return timeout;
+    // wake up right at the next deadline: next event, next overlay item or boundary to keep transitions tight
+    // deadlines already passed are left behind (e.g. overlay items beyond the limit), they must not make the worker spin
+    auto deadline = std::numeric_limits<timestamp_t>::infinity();
+    const auto consider = [&](timestamp_t timestamp) {
+        if (timestamp > m_position.second)
+            deadline = std::min(deadline, timestamp);
+    };
+    if (m_position.first != m_limits.max.first)
+        consider(m_position.first->timestamp);
+    else if (is_looping() || m_next_sequence)
+        consider(m_limits.max.second);
+    for (const auto& overlay : m_overlays)
+        if (const auto* item = overlay->peek())
+            consider(item->timestamp);
+    if (std::isfinite(deadline)) {
+        const auto remaining = (deadline - m_position.second) * m_base_time / m_distorsion;
+        timeout = std::max(duration_type::zero(), std::min(timeout, remaining));
+    }
+    return timeout;
+}
+
+void SequenceReader::jump_position(position_type position) {
+    m_position = std::move(position);
+    if (m_playing) {
+        // only notes are stopped, the rest of the state is kept while scrubbing
+        post_event(stop_notes);
+        m_base_time = m_sequence->clock().last_base_time(m_position.second);
+    }
+    reset_overlays(m_position.second);
+    m_pulses = 0;
+    if (m_playing) {
+        send_stop();
+        send_transport(false);
+    }
+    publish();
+}
+
+void SequenceReader::reset_overlays(timestamp_t origin) {
+    for (const auto& overlay : m_overlays)
+        overlay->reset(*m_sequence, origin, m_position.second);
+}
+
+void SequenceReader::set_sync_mode(Sync sync) {
+    if (sync == m_sync)
+        return;
+    if (m_playing)
+        send_stop();
+    m_sync = sync;
+    m_overlays.erase(std::remove(m_overlays.begin(), m_overlays.end(), m_clock_overlay), m_overlays.end());
+    if (m_sync == Sync::master) {
+        m_clock_overlay->reset(*m_sequence, m_position.second, m_position.second);
+        m_overlays.push_back(m_clock_overlay);
+        if (m_playing)
+            send_transport(false);
+    }
+    m_pulses = 0;
+    m_master_jitter = {};
+    m_slave_jitter = {};
+}
+
+void SequenceReader::send_transport(bool restart) {
+    if (m_sync != Sync::master)
+        return;
+    // song position is expressed in MIDI beats (16th notes)
+    const auto beat = std::floor(m_sequence->clock().timestamp2beat(std::max(0., m_position.second)));
+    post_event(Event::song_position(short_ns::cut(static_cast<uint16_t>(std::min(beat, static_cast<double>(max_song_position))))));
+    post_event(restart && beat == 0. ? Event::start() : Event::continue_());
+}
+
+void SequenceReader::send_stop() {
+    if (m_sync == Sync::master)
+        post_event(Event::stop());
+}
+
+void SequenceReader::lock_clock(time_type time) {
+    if (m_sync != Sync::slave || !m_playing)
+        return;
+    // catch up with the current time before measuring the phase
+    step();
+    if (!m_playing)
+        return;
+    const auto pulse_span = m_sequence->clock().clock2timestamp(1.);
+    const auto position = m_position.second + m_distorsion * (time - m_time) / m_base_time;
+    if (m_pulses++ == 0) {
+        m_pulse_origin = position;
+        m_pulse_time = time;
+        m_pll_frequency = m_distorsion;
+        return;
+    }
+    // frequency: distorsion for which a pulse lasts exactly the measured interval
+    const auto interval = std::chrono::duration_cast<duration_type>(time - std::exchange(m_pulse_time, time));
+    const auto nominal = pulse_span * m_base_time;
+    if (interval <= duration_type::zero())
+        return;
+    if (m_pll_frequency > 0.)
+        m_slave_jitter.add(std::abs(duration_type{interval - nominal / m_pll_frequency}.count()));
+    m_pll_frequency += pll_frequency_gain * (nominal / interval - m_pll_frequency);
+    // phase: pulses should fall on the grid started by the first one
+    const auto phase_error = (m_pulse_origin + (m_pulses - 1) * pulse_span - position) / pulse_span;
+    m_distorsion = std::max(0., m_pll_frequency * (1. + pll_phase_gain * phase_error));
+    m_snapshot_distorsion = m_distorsion;
 }
 
 families_t SequenceReader::handled_families() const {
-    return families_t::fuse(family_t::extended_system, family_t::song_position, family_t::song_select, family_t::start, family_t::continue_, family_t::stop);
+    return families_t::fuse(family_t::extended_system, family_t::song_position, family_t::song_select, family_t::start, family_t::continue_, family_t::stop, family_t::clock);
 }
 
 Handler::Result SequenceReader::handle_close(State state) {
     if (state & State::forward())
-        stop_playing(stop_all, false, false);
+        stop_playing(Silence::all, false, false);
     return Handler::handle_close(state);
 }
 
@@ -227,11 +680,12 @@ Handler::Result SequenceReader::handle_message(const Message& message) {
     case family_t::song_select: return handle_sequence(extraction_ns::song(message.event));
     case family_t::start: return handle_start(true);
     case family_t::continue_: return handle_start(false);
-    case family_t::stop: return handle_stop(stop_all);
+    case family_t::stop: return handle_stop(Silence::all);
+    case family_t::clock: return handle_clock(reception_time(message));
     case family_t::extended_system:
-        if (pause_ext.affects(message.event)) return handle_stop(stop_sounds);
+        if (pause_ext.affects(message.event)) return handle_stop(Silence::sounds);
         if (distorsion_ext.affects(message.event)) return set_distorsion(distorsion_ext.decode(message.event));
-        if (toggle_ext.affects(message.event)) return is_playing() ? handle_stop(stop_sounds) : handle_start(false);
+        if (toggle_ext.affects(message.event)) return is_playing() ? handle_stop(Silence::sounds) : handle_start(false);
         break;
     default:
         break;
@@ -240,7 +694,7 @@ Handler::Result SequenceReader::handle_message(const Message& message) {
 }
 
 Handler::Result SequenceReader::handle_beat(double beat) {
-    set_position(m_sequence.clock().beat2timestamp(beat));
+    set_position(sequence()->clock().beat2timestamp(beat));
     return Result::success;
 }
 
@@ -255,7 +709,14 @@ Handler::Result SequenceReader::handle_start(bool rewind) {
     return start_playing(rewind) ? Result::success : Result::fail;
 }
 
-Handler::Result SequenceReader::handle_stop(const Event& final_event) {
-    stop_playing(final_event, false, false);
+Handler::Result SequenceReader::handle_stop(Silence silence) {
+    stop_playing(silence, false, false);
+    return Result::success;
+}
+
+Handler::Result SequenceReader::handle_clock(time_type time) {
+    if (m_snapshot_sync != Sync::slave)
+        return Result::unhandled;
+    push({Command::Kind::pulse, Silence::all, false, false, duration_type{time.time_since_epoch()}.count()});
     return Result::success;
 }
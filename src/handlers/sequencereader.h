@@ -22,13 +22,38 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define HANDLERS_SEQUENCE_READER_H
 
 #include <future>     // std::future std::promise
+#include <boost/lockfree/queue.hpp>
 #include "core/handler.h"
 #include "core/sequence.h"
+#include "sequenceoverlay.h"
 
 //================
 // SequenceReader
 //================
 
+/**
+ * The reader plays its sequence on a worker thread living as long as the handler.
+ *
+ * Controls (start, stop, seek, limits & distorsion) are pushed to a lock-free queue
+ * and applied by the worker at its next period, consecutive seeks being merged.
+ * Position, limits and completion are published in atomic snapshots so that the interface may poll them without locking,
+ * the snapshot reflects the requested values until the worker catches up.
+ *
+ * Sequences are immutable and shared, changing the current sequence is a pointer swap.
+ * Overlays (metronome, count-in, ...) are merged with the sequence at each period rather than inserted in it.
+ *
+ * When looping or when a next sequence is set, the worker wakes up at the upper limit and continues
+ * from the lower limit (or the start of the next sequence) in the same step,
+ * the time elapsed past the limit is carried over so that there is no gap in the timing.
+ * The worker sleeps until the next deadline (event, overlay item or limit) rather than for a whole period.
+ *
+ * As a clock master, the reader sends clock pulses (24 per quarter note) with the sequence,
+ * along with song position & start/continue/stop when the transport changes.
+ * As a clock slave, received pulses feed a phase-locked loop driving the distorsion:
+ * the frequency follows the filtered period of the pulses and the phase error nudges it so that pulses stay on the grid.
+ *
+ */
+
 class SequenceReader : public Handler {
 
 public:
@@ -37,6 +62,32 @@ public:
     using time_type = Clock::time_type;
 
     using position_type = std::pair<TimedEvents::const_iterator, timestamp_t>;
+    using sequence_type = std::shared_ptr<const Sequence>; /*!< sequences are shared with the interface, never copied */
+    using overlay_type = std::shared_ptr<SequenceOverlay>;
+
+    enum class Silence : uint8_t {
+        notes, /*!< all notes off */
+        sounds, /*!< all sound off */
+        all /*!< reset */
+    };
+
+    enum class Sync : uint8_t {
+        internal, /*!< playback follows the tempo of the sequence */
+        master, /*!< like internal, clock & transport are sent */
+        slave /*!< playback follows the received clock */
+    };
+
+    struct Jitter {
+        size_t count; /*!< number of pulses measured */
+        double mean; /*!< in microseconds */
+        double deviation; /*!< standard deviation in microseconds */
+        double max; /*!< in microseconds */
+    };
+
+    static constexpr std::chrono::milliseconds period {2}; /*!< maximum time between two steps of the worker */
+    static constexpr std::chrono::milliseconds gap_tolerance {1}; /*!< transitions delayed further are traced */
+    static constexpr double pll_frequency_gain = 0.1; /*!< smoothing of the measured period */
+    static constexpr double pll_phase_gain = 0.05; /*!< relative correction per pulse of phase error */
 
     static const SystemExtension<void> toggle_ext; /*!< pause handler if playing else start */
     static const SystemExtension<void> pause_ext; /*!< like stop_event but don't generate a reset_event */
@@ -45,14 +96,28 @@ public:
     explicit SequenceReader();
     ~SequenceReader();
 
-    const Sequence& sequence() const; /*!< returns current sequence */
-    void set_sequence(Sequence sequence); /*!< set sequence to play */
-    void replace_sequence(Sequence sequence); /*!< replace sequence and continues playing it at the same position */
+    sequence_type sequence() const; /*!< returns current sequence (never null) */
+    void set_sequence(sequence_type sequence); /*!< set sequence to play */
+    void replace_sequence(sequence_type sequence); /*!< replace sequence and continues playing it at the same position */
 
-    const std::map<byte_t, Sequence>& sequences() const; /*!< all loaded sequences */
-    void load_sequence(byte_t id, Sequence sequence); /*!< set sequence available, for song_select events */
+    const std::map<byte_t, sequence_type>& sequences() const; /*!< all loaded sequences */
+    void load_sequence(byte_t id, sequence_type sequence); /*!< set sequence available, for song_select events */
     bool select_sequence(byte_t id); /*!< set the current sequence by its id, return false if the id is unknown */
 
+    void set_looping(bool looping); /*!< wrap from the upper limit to the lower one instead of completing */
+    void set_chasing(bool chasing); /*!< restore controllers, programs & pitches in effect at the lower limit when wrapping */
+    sequence_type next_sequence() const; /*!< sequence continuing the current one, null if none */
+    void set_next_sequence(sequence_type sequence); /*!< sequence continuing the current one once completed (nullptr for none) */
+    duration_type max_gap() const; /*!< maximum delay between a loop point or sequence end and its processing */
+
+    Sync sync() const;
+    void set_sync(Sync sync);
+    Jitter master_jitter() const; /*!< lateness of the pulses sent (lock-free) */
+    Jitter slave_jitter() const; /*!< deviation of the received pulses from the locked period (lock-free) */
+
+    void insert_overlay(overlay_type overlay); /*!< overlays must not be shared between readers */
+    void remove_overlay(const overlay_type& overlay);
+
     double distorsion() const;
     Result set_distorsion(double distorsion); /*!< returns fail for negative input */
 
@@ -67,7 +132,7 @@ public:
     void set_upper(timestamp_t timestamp);
 
     bool start_playing(bool rewind); /*!< return false if already started */
-    bool stop_playing(const Event& final_event, bool always_send, bool rewind); /*!< return false if already stopped */
+    bool stop_playing(Silence silence, bool always_send, bool rewind); /*!< return false if already stopped */
 
 protected:
     Result handle_close(State state) override;
@@ -79,19 +144,114 @@ private:
     Result handle_beat(double beat);
     Result handle_sequence(byte_t id);
     Result handle_start(bool rewind);
-    Result handle_stop(const Event& final_event);
+    Result handle_stop(Silence silence);
+    Result handle_clock(time_type time);
+
+    struct Command {
+        enum class Kind : uint8_t { start, stop, seek, lower, upper, distorsion, loop, chase, sync, pulse };
+        Kind kind;
+        Silence silence; /*!< stop: event sent if notify is set */
+        bool notify; /*!< stop: send the silence event even if the reader is not playing */
+        bool rewind; /*!< start & stop: move to the lower limit */
+        double value; /*!< start: generation, seek, lower & upper: timestamp, distorsion: factor, loop & chase: boolean, sync: mode, pulse: reception time (us) */
+    };
 
-    // unsafe helpers
+    struct JitterAccumulator {
+        void add(double value);
+        Jitter get() const;
+
+        size_t count {0};
+        double sum {0.};
+        double sum2 {0.};
+        double max {0.};
+    };
+
+    struct JitterSnapshot {
+        void store(const Jitter& jitter);
+        Jitter load() const; /*!< fields may come from consecutive updates */
+
+        std::atomic<size_t> count {0};
+        std::atomic<double> mean {0.};
+        std::atomic<double> deviation {0.};
+        std::atomic<double> max {0.};
+    };
+
+    void push(const Command& command); /*!< thread-safe */
+    void assign(sequence_type sequence); /*!< m_mutex must be locked */
+    void publish(); /*!< update the snapshot from the worker state */
+    void post_event(const Event& event); /*!< queue an event produced once m_mutex is released */
+    void deliver_events(); /*!< worker only, without m_mutex */
+    void finish_playing(); /*!< clear the playing state unless another request followed the current run */
+
+    // worker (m_mutex must be locked)
+    void run();
+    void execute(const Command& command);
+    void step();
+    void forward_events(); /*!< forward events up to the current timestamp */
+    bool is_looping() const; /*!< looping is enabled over a non-empty range */
+    bool is_transitioning() const; /*!< true if the boundary is reached and playback continues */
+    void transition(); /*!< loop or move to the next sequence */
+    void update_chase();
+    duration_type next_timeout() const;
     void jump_position(position_type position);
+    void reset_overlays(timestamp_t origin);
+    void set_sync_mode(Sync sync);
+    void send_transport(bool restart); /*!< song position followed by start or continue (master only) */
+    void send_stop(); /*!< master only */
+    void lock_clock(time_type time); /*!< feed the phase-locked loop (slave only) */
 
-    std::map<byte_t, Sequence> m_sequences; /*!< all loaded sequences */
-    Sequence m_sequence; /*!< current sequence */
+    std::map<byte_t, sequence_type> m_sequences; /*!< all loaded sequences */
+    std::vector<overlay_type> m_overlays; /*!< overlays merged while playing (m_mutex must be locked) */
+    sequence_type m_sequence; /*!< current sequence, stored atomically */
 
+    // worker state
     position_type m_position; /*!< current position */
     range_t<position_type> m_limits; /*!< range of reachable positions (max excluded) */
     double m_distorsion {1.}; /*!< distorsion factor: slower (<1) faster (>1) freezed (0) (default 1) */
-    std::thread m_worker; /*!< thread forwarding status when started */
-    mutable std::mutex m_mutex;  /*!< mutex protecting positions & distorsion */
+    duration_type m_base_time {}; /*!< current base time for 1 deltatime */
+    time_type m_time {}; /*!< time of the last step */
+    bool m_playing {false};
+    bool m_looping {false};
+    bool m_chasing {false};
+    sequence_type m_next_sequence; /*!< sequence following the current one, stored atomically */
+    TimedEvents m_chase; /*!< state events preceding the lower limit */
+    const Sequence* m_chase_sequence {nullptr}; /*!< sequence m_chase is computed for */
+    TimedEvents::const_iterator m_chase_position; /*!< lower limit m_chase is computed for */
+    Sync m_sync {Sync::internal};
+    std::shared_ptr<ClockOverlay> m_clock_overlay {std::make_shared<ClockOverlay>()}; /*!< overlay emitting the pulses as a master */
+    size_t m_pulses {0}; /*!< pulses received since the loop has been reset */
+    timestamp_t m_pulse_origin {0.}; /*!< position of the first pulse received */
+    time_type m_pulse_time {}; /*!< time of the last pulse received */
+    double m_pll_frequency {1.}; /*!< distorsion matching the period of the pulses */
+    JitterAccumulator m_master_jitter;
+    JitterAccumulator m_slave_jitter;
+    uint32_t m_run_generation {0}; /*!< generation of the start being played */
+    std::vector<Event> m_outgoing; /*!< events posted under m_mutex */
+    std::vector<Event> m_delivering; /*!< events being produced by the worker, capacity is kept between steps */
+    mutable std::mutex m_mutex; /*!< mutex protecting the sequence & the worker state */
+
+    // playing state, set by callers & cleared by the worker when the run completes
+    std::mutex m_playing_mutex;
+    uint32_t m_generation {0}; /*!< start & stop requests made so far */
+
+    // snapshot
+    std::atomic<timestamp_t> m_snapshot_position {0.};
+    std::atomic<timestamp_t> m_snapshot_lower {0.};
+    std::atomic<timestamp_t> m_snapshot_upper {0.};
+    std::atomic<double> m_snapshot_distorsion {1.};
+    std::atomic_bool m_snapshot_completed {true};
+    std::atomic_bool m_active {false}; /*!< a run started and no silence has been sent since */
+    std::atomic<double> m_max_gap {0.}; /*!< in microseconds */
+    std::atomic<Sync> m_snapshot_sync {Sync::internal};
+    JitterSnapshot m_snapshot_master_jitter;
+    JitterSnapshot m_snapshot_slave_jitter;
+
+    // controls
+    boost::lockfree::queue<Command> m_commands {64};
+    std::mutex m_signal_mutex;
+    std::condition_variable m_signal;
+    std::atomic_bool m_running {true};
+    std::thread m_worker; /*!< thread forwarding events */
 
 };
 
@@ -304,6 +304,19 @@ struct SystemHandlerFactory::Impl {
             insert_in(i);
     }
 
+    std::vector<identifier_type> scan() const {
+        Impl scanner;
+        scanner.update();
+        return std::move(scanner.identifiers);
+    }
+
+    void assign(std::vector<identifier_type> ids) {
+        identifiers = std::move(ids);
+    }
+
+    bool watchable() const { return false; }
+    bool watch(std::chrono::milliseconds /*timeout*/) { return false; }
+
     std::unique_ptr<Handler> instantiate(const std::string& name) {
         auto it = find(name);
         return it == identifiers.end() ? nullptr : it->instantiate();
@@ -321,27 +334,86 @@ struct SystemHandlerFactory::Impl {
 //#include <thread>
 #include "core/sequence.h"
 #include <sstream>
+#include <unordered_map>
+
+class LinuxSystemHandler;
+
+//====================
+// LinuxSystemRegistry
+//====================
+
+/**
+ * The registry tracks opened system handlers so that they follow their device:
+ * handlers are closed when their device disappears and reopened in their previous state when it comes back,
+ * possibly with another hardware name as card numbers are not stable.
+ *
+ * @note the mutex is recursive as a synchronizer may handle the reopening in the caller's context
+ *
+ */
+
+class LinuxSystemRegistry {
+
+public:
+    using devices_type = std::unordered_map<std::string, std::string>; /*!< device name => hardware name */
+
+    void insert(LinuxSystemHandler* handler);
+    void remove(LinuxSystemHandler* handler);
+    void refresh(const devices_type& devices);
+
+private:
+    struct entry_type {
+        LinuxSystemHandler* handler;
+        Handler::State state; /*!< state to restore once the device is back */
+        bool missing;
+    };
+
+    std::recursive_mutex m_mutex;
+    std::vector<entry_type> m_entries;
+
+};
+
+//====================
+// LinuxSystemHandler
+//====================
 
 class LinuxSystemHandler : public Handler {
 
     private:
 
-        const std::string m_hardware_name;
+        const std::string m_device_name;
+        std::string m_hardware_name;
+        mutable std::mutex m_hardware_mutex;
+        std::shared_ptr<LinuxSystemRegistry> m_registry;
         snd_rawmidi_t* m_i_handler;
         snd_rawmidi_t* m_o_handler;
         std::thread m_i_reader;
 
     public:
 
-        LinuxSystemHandler(Mode mode, std::string hardware_name) :
-            Handler{mode}, m_hardware_name{std::move(hardware_name)} {
+        LinuxSystemHandler(Mode mode, std::string device_name, std::string hardware_name, std::shared_ptr<LinuxSystemRegistry> registry) :
+            Handler{mode}, m_device_name{std::move(device_name)}, m_hardware_name{std::move(hardware_name)}, m_registry{std::move(registry)} {
 
         }
 
         ~LinuxSystemHandler() {
+            m_registry->remove(this);
             close_system(State::duplex());
         }
 
+        const std::string& device_name() const {
+            return m_device_name;
+        }
+
+        std::string hardware_name() const {
+            std::lock_guard<std::mutex> guard{m_hardware_mutex};
+            return m_hardware_name;
+        }
+
+        void set_hardware_name(std::string hardware_name) {
+            std::lock_guard<std::mutex> guard{m_hardware_mutex};
+            m_hardware_name = std::move(hardware_name);
+        }
+
     protected:
 
         Result handle_open(State state) override {
@@ -379,9 +451,11 @@ class LinuxSystemHandler : public Handler {
 
         size_t open_system(State s) {
             size_t errors = 0;
+            const auto hardware = hardware_name();
+            m_registry->insert(this);
             // open input handler
             if (mode().any(Mode::in()) && s.any(State::forward()) && state().none(State::forward())) {
-                const auto in_errors = check(snd_rawmidi_open(&m_i_handler, nullptr, m_hardware_name.c_str(), 0));
+                const auto in_errors = check(snd_rawmidi_open(&m_i_handler, nullptr, hardware.c_str(), 0));
                 if (!in_errors) {
                     activate_state(State::forward());
                     m_i_reader = std::thread{[this]{ i_callback(); }};
@@ -390,7 +464,7 @@ class LinuxSystemHandler : public Handler {
             }
             // open output handler
             if (mode().any(Mode::out()) && s.any(State::receive()) && state().none(State::receive())) {
-                const auto out_errors = check(snd_rawmidi_open(nullptr, &m_o_handler, m_hardware_name.c_str(), 0));
+                const auto out_errors = check(snd_rawmidi_open(nullptr, &m_o_handler, hardware.c_str(), 0));
                 if (!out_errors)
                     activate_state(State::receive());
                 errors += out_errors;
@@ -472,12 +546,114 @@ class LinuxSystemHandler : public Handler {
 
 };
 
+//====================
+// LinuxSystemRegistry
+//====================
+
+void LinuxSystemRegistry::insert(LinuxSystemHandler* handler) {
+    std::lock_guard<std::recursive_mutex> guard{m_mutex};
+    if (std::none_of(m_entries.begin(), m_entries.end(), [=](const auto& entry) { return entry.handler == handler; }))
+        m_entries.push_back({handler, {}, false});
+}
+
+void LinuxSystemRegistry::remove(LinuxSystemHandler* handler) {
+    std::lock_guard<std::recursive_mutex> guard{m_mutex};
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [=](const auto& entry) { return entry.handler == handler; }), m_entries.end());
+}
+
+void LinuxSystemRegistry::refresh(const devices_type& devices) {
+    std::lock_guard<std::recursive_mutex> guard{m_mutex};
+    for (auto& entry : m_entries) {
+        auto* handler = entry.handler;
+        const auto it = devices.find(handler->device_name());
+        if (it == devices.end()) {
+            if (!entry.missing) {
+                TRACE_WARNING(handler->name() << ": device disconnected");
+                entry.missing = true;
+                entry.state = handler->state();
+                handler->send_message(Handler::close_ext(Handler::State::duplex()));
+            }
+        } else if (entry.missing || it->second != handler->hardware_name()) {
+            TRACE_INFO(handler->name() << ": device reconnected as " << it->second);
+            const auto state = entry.missing ? entry.state : handler->state();
+            entry.missing = false;
+            handler->send_message(Handler::close_ext(Handler::State::duplex()));
+            handler->set_hardware_name(it->second);
+            handler->send_message(Handler::open_ext(state));
+        }
+    }
+}
+
+//==================
+// AnnounceMonitor
+//==================
+
+/**
+ * The monitor listens to the announcements of the ALSA sequencer,
+ * clients & ports are created or deleted when devices are plugged or unplugged.
+ *
+ */
+
+class AnnounceMonitor {
+
+public:
+    AnnounceMonitor() {
+        if (snd_seq_open(&m_seq, "default", SND_SEQ_OPEN_INPUT, SND_SEQ_NONBLOCK) < 0) {
+            TRACE_WARNING("Can't open the sequencer, hotplug is disabled");
+            m_seq = nullptr;
+            return;
+        }
+        snd_seq_set_client_name(m_seq, "MIDILab Monitor");
+        const int port = snd_seq_create_simple_port(m_seq, "Announce", SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_NO_EXPORT, SND_SEQ_PORT_TYPE_APPLICATION);
+        if (port < 0 || snd_seq_connect_from(m_seq, port, SND_SEQ_CLIENT_SYSTEM, SND_SEQ_PORT_SYSTEM_ANNOUNCE) < 0) {
+            TRACE_WARNING("Can't listen to sequencer announcements, hotplug is disabled");
+            snd_seq_close(m_seq);
+            m_seq = nullptr;
+        }
+    }
+
+    ~AnnounceMonitor() {
+        if (m_seq)
+            snd_seq_close(m_seq);
+    }
+
+    bool valid() const {
+        return m_seq != nullptr;
+    }
+
+    bool wait(std::chrono::milliseconds timeout) {
+        std::vector<pollfd> fds(static_cast<size_t>(snd_seq_poll_descriptors_count(m_seq, POLLIN)));
+        snd_seq_poll_descriptors(m_seq, fds.data(), static_cast<unsigned int>(fds.size()), POLLIN);
+        if (poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) <= 0)
+            return false;
+        bool changed = false;
+        snd_seq_event_t* event;
+        while (snd_seq_event_input(m_seq, &event) >= 0) {
+            switch (event->type) {
+            case SND_SEQ_EVENT_CLIENT_START:
+            case SND_SEQ_EVENT_CLIENT_EXIT:
+            case SND_SEQ_EVENT_PORT_START:
+            case SND_SEQ_EVENT_PORT_EXIT:
+                changed = true;
+                break;
+            default:
+                break;
+            }
+        }
+        return changed;
+    }
+
+private:
+    snd_seq_t* m_seq {nullptr};
+
+};
+
 struct SystemHandlerFactory::Impl {
 
     struct identifier_type {
 
-        auto instantiate() const {
-            auto handler = std::make_unique<LinuxSystemHandler>(mode, hardware_name);
+        auto instantiate(std::shared_ptr<LinuxSystemRegistry> registry) const {
+            auto handler = std::make_unique<LinuxSystemHandler>(mode, name, hardware_name, std::move(registry));
             handler->set_name(name);
             return handler;
         }
@@ -498,16 +674,16 @@ struct SystemHandlerFactory::Impl {
         return names;
     }
 
-    void insert(identifier_type id) {
-        auto it = find(id.name);
-        if (it != identifiers.end())
+    static void insert(std::vector<identifier_type>& ids, identifier_type id) {
+        auto it = std::find_if(ids.begin(), ids.end(), [&](const auto& other) { return other.name == id.name; });
+        if (it != ids.end())
             it->mode |= id.mode;
         else
-            identifiers.push_back(std::move(id));
+            ids.push_back(std::move(id));
     }
 
-    void update() {
-        identifiers.clear();
+    std::vector<identifier_type> scan() const {
+        std::vector<identifier_type> ids;
         // Start with first card
         int cardNum = -1;
         while (true) {
@@ -568,7 +744,7 @@ struct SystemHandlerFactory::Impl {
                             const char* name = snd_rawmidi_info_get_name(rawMidiInfo);
                             std::stringstream hw_stream;
                             hw_stream << "hw:" << cardNum << ',' << devNum << ',' << i;
-                            insert(identifier_type{name, hw_stream.str(), mode});
+                            insert(ids, identifier_type{name, hw_stream.str(), mode});
                         }
                         mode = (mode == Handler::Mode::out()) ? Handler::Mode::in() : Handler::Mode{};
                     }
@@ -581,14 +757,33 @@ struct SystemHandlerFactory::Impl {
         // above functions. Now that we're done getting the info, let's tell ALSA
         // to unload the info and free up that mem
         snd_config_update_free_global();
+        return ids;
+    }
+
+    void assign(std::vector<identifier_type> ids) {
+        identifiers = std::move(ids);
+        LinuxSystemRegistry::devices_type devices;
+        for (const auto& id : identifiers)
+            devices.emplace(id.name, id.hardware_name);
+        registry->refresh(devices);
+    }
+
+    bool watchable() const {
+        return monitor.valid();
+    }
+
+    bool watch(std::chrono::milliseconds timeout) {
+        return monitor.wait(timeout);
     }
 
     std::unique_ptr<Handler> instantiate(const std::string& name) {
         auto it = find(name);
-        return it == identifiers.end() ? nullptr : it->instantiate();
+        return it == identifiers.end() ? nullptr : it->instantiate(registry);
     }
 
     std::vector<identifier_type> identifiers;
+    std::shared_ptr<LinuxSystemRegistry> registry {std::make_shared<LinuxSystemRegistry>()};
+    AnnounceMonitor monitor;
 
 };
 
@@ -598,7 +793,10 @@ struct SystemHandlerFactory::Impl {
 
 struct SystemHandlerFactory::Impl {
     std::vector<std::string> available() const { return {}; }
-    void update() { }
+    int scan() const { return 0; }
+    void assign(int /*ids*/) { }
+    bool watchable() const { return false; }
+    bool watch(std::chrono::milliseconds /*timeout*/) { return false; }
     std::unique_ptr<Handler> instantiate(const std::string& /*name*/) { return nullptr; }
 };
 
@@ -608,22 +806,60 @@ struct SystemHandlerFactory::Impl {
 // SystemHandlerFactory
 //======================
 
+constexpr std::chrono::milliseconds SystemHandlerFactory::watch_period;
+
 SystemHandlerFactory::SystemHandlerFactory() : m_impl{std::make_unique<Impl>()} {
-    update();
+    m_thread = std::thread{[this] { run(); }};
 }
 
 SystemHandlerFactory::~SystemHandlerFactory() {
-
+    {
+        std::lock_guard<std::mutex> guard{m_mutex};
+        m_running = false;
+    }
+    m_condition_variable.notify_all();
+    m_thread.join();
 }
 
 std::vector<std::string> SystemHandlerFactory::available() const {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_condition_variable.wait(lock, [this] { return m_scanned; });
     return m_impl->available();
 }
 
 void SystemHandlerFactory::update() {
-    m_impl->update();
+    {
+        std::lock_guard<std::mutex> guard{m_mutex};
+        m_requested = true;
+    }
+    m_condition_variable.notify_all();
 }
 
 std::unique_ptr<Handler> SystemHandlerFactory::instantiate(const std::string& name) {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_condition_variable.wait(lock, [this] { return m_scanned; });
     return m_impl->instantiate(name);
 }
+
+void SystemHandlerFactory::run() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    while (m_running) {
+        if (m_requested) {
+            m_requested = false;
+            lock.unlock();
+            auto identifiers = m_impl->scan();
+            lock.lock();
+            m_impl->assign(std::move(identifiers));
+            m_scanned = true;
+            m_condition_variable.notify_all();
+        } else if (m_impl->watchable()) {
+            // update requests are delayed by the watch period at most
+            lock.unlock();
+            const auto changed = m_impl->watch(watch_period);
+            lock.lock();
+            m_requested = m_requested || changed;
+        } else {
+            m_condition_variable.wait(lock);
+        }
+    }
+}
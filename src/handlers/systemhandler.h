@@ -21,12 +21,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef HANDLERS_SYSTEM_HANDLER_H
 #define HANDLERS_SYSTEM_HANDLER_H
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include "core/handler.h"
 
 /**
   * create the list of all available handlers available on this platform
   * @note ownership is given to the caller
   * @todo order handlers to get the default one at first
+  *
+  * Devices are enumerated on a background thread that keeps a cached list,
+  * the first enumeration starts at construction and accessors wait for it to complete.
+  * Where hotplug notifications are available (ALSA sequencer announcements),
+  * the list is refreshed as devices come and go and instantiated handlers whose device reappears are reopened.
   */
 
 //======================
@@ -39,15 +47,25 @@ public:
     SystemHandlerFactory();
     ~SystemHandlerFactory();
 
+    static constexpr std::chrono::milliseconds watch_period {100};
+
     std::vector<std::string> available() const; /*!< list available system handlers */
 
-    void update(); /*!< update the list of available handlers */
+    void update(); /*!< request an asynchronous update of the list of available handlers */
 
     std::unique_ptr<Handler> instantiate(const std::string& name); /*!< get a new handler by its name */
 
 private:
+    void run();
+
     struct Impl;
     std::unique_ptr<Impl> m_impl;
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_condition_variable;
+    bool m_running {true};
+    bool m_requested {true}; /*!< an enumeration is pending */
+    bool m_scanned {false}; /*!< the first enumeration is complete */
+    std::thread m_thread;
 
 };
 
@@ -32,6 +32,10 @@ TrackFilter::TrackFilter() : Handler{Mode::thru()} {
 
 }
 
+bool TrackFilter::is_fusable() const {
+    return true;
+}
+
 Handler::Result TrackFilter::handle_message(const Message& message) {
     if (message.event.is(family_t::extended_system)) {
         if (disable_ext.affects(message.event)) {
@@ -48,6 +48,8 @@ public:
 
     explicit TrackFilter();
 
+    bool is_fusable() const override;
+
 protected:
     Result handle_message(const Message& message) override;
 
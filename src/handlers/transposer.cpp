@@ -37,6 +37,10 @@ Transposer::Transposer() : Handler{Mode::thru()} {
     activate_state(bypass_state);
 }
 
+bool Transposer::is_fusable() const {
+    return true;
+}
+
 Handler::Result Transposer::handle_message(const Message& message) {
     if (message.event.is(family_t::extended_voice)) {
         if (transpose_ext.affects(message.event)) {
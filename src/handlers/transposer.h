@@ -46,6 +46,8 @@ public:
 
     explicit Transposer();
 
+    bool is_fusable() const override;
+
 protected:
     Result handle_message(const Message& message) override;
 
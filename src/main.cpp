@@ -21,10 +21,14 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <QApplication>
 #include <QSplashScreen>
 #include <QCommandLineParser>
+#include "converter.h"
 #include "mainwindow.h"
 #include "qcore/core.h"
 
 int main(int argc, char *argv[]) {
+    // headless batch conversion, it must not instantiate any widget
+    if (argc > 1 && qstrcmp(argv[1], "convert") == 0)
+        return runConverter(argc, argv);
     // application
     QApplication app{argc, argv};
     QApplication::setOrganizationName("MIDILab");
@@ -43,6 +43,16 @@ void setSystemTrayIconPreferredVisibility(bool visibility) {
     settings.setValue("withTrayIcon", visibility);
 }
 
+auto getPreferredFusion() {
+    QSettings settings;
+    return settings.value("fusion", true).toBool();
+}
+
+void setPreferredFusion(bool fusion) {
+    QSettings settings;
+    settings.setValue("fusion", fusion);
+}
+
 auto getConfigs() {
     QSettings settings;
     return settings.value("config").toStringList();
@@ -120,6 +130,8 @@ AboutWindow::AboutWindow(QWidget* parent) :
 
 MainWindow::MainWindow(QWidget* parent) : QMainWindow{parent} {
 
+    TRACE_MEASURE("build main window");
+
     // configure manager
 
     mManager = new Manager{this};
@@ -200,6 +212,15 @@ MainWindow::MainWindow(QWidget* parent) : QMainWindow{parent} {
     systemTrayAction->setChecked(isSystemTrayVisible);
     connect(systemTrayAction, &QAction::toggled, this, &MainWindow::setSystemTrayVisible);
 
+    mManager->setFusion(getPreferredFusion());
+    auto* fusionAction = interfaceMenu->addAction("Fuse lightweight handlers");
+    fusionAction->setCheckable(true);
+    fusionAction->setChecked(mManager->fusion());
+    connect(fusionAction, &QAction::toggled, this, [this](bool fusion) {
+        mManager->setFusion(fusion);
+        setPreferredFusion(fusion);
+    });
+
     // configure help menu
 
     helpMenu->addAction(QIcon{":/data/question-mark.svg"}, "Help", this, SLOT(unimplemented()));
@@ -228,6 +249,16 @@ void MainWindow::saveConfig() {
 }
 
 void MainWindow::clearConfig() {
+    // Close existing displayers to make space for the next configuration
+    // It also deletes the empty ones
+    // The others will be deleted by the manager
+    for (auto* displayer : detachDisplayers())
+        displayer->close();
+    // Clears configurations asynchronously
+    mManager->clearConfiguration();
+}
+
+std::vector<MultiDisplayer*> MainWindow::detachDisplayers() {
     // If the main displayer contains views, we want it to be deleted by the manager.
     // We have to detach it from the mainwindow to enable this deletion.
     // We replace it by another main displayer.
@@ -238,13 +269,7 @@ void MainWindow::clearConfig() {
         previousDisplayer->setParent(nullptr);
         setCentralWidget(newDisplayer);
     }
-    // Close existing displayers to make space for the next configuration
-    // It also deletes the empty ones
-    // The others will be deleted by the manager
-    for (auto* displayer : MultiDisplayer::topLevelDisplayers())
-        displayer->close();
-    // Clears configurations asynchronously
-    mManager->clearConfiguration();
+    return MultiDisplayer::topLevelDisplayers();
 }
 
 void MainWindow::readLastConfig(bool clear) {
@@ -263,11 +288,17 @@ void MainWindow::readConfig(const QString& fileName, bool raise, bool select, bo
         QMessageBox::critical(this, {}, QString{"Failed reading configuration\n%1\n\n%2"}.arg(fileName, error));
         return;
     }
-    // clear previous configuration
-    if (clear)
-        clearConfig();
     // set the new configuration
-    mManager->setConfiguration(config);
+    if (clear) {
+        // handlers matching the new configuration are kept alive and their views are moved to the new frames,
+        // previous displayers are closed afterwards so that only the emptied ones are deleted
+        const auto displayers = detachDisplayers();
+        mManager->updateConfiguration(config);
+        for (auto* displayer : displayers)
+            displayer->close();
+    } else {
+        mManager->setConfiguration(config);
+    }
     // redo the layout
     mGraphEditor->graph()->doLayout();
     // update config order and retriever
@@ -115,6 +115,9 @@ private slots:
 protected:
     void closeEvent(QCloseEvent* event) override;
 
+private:
+    std::vector<MultiDisplayer*> detachDisplayers(); /*!< replaces the main displayer if not empty and returns top-level displayers */
+
 private:
     Manager* mManager;
     HandlerGraphEditor* mGraphEditor;
@@ -27,6 +27,19 @@ range_t<ChildItemIterator> makeChildRange(QTreeWidgetItem* root) {
     return {{root, 0}, {root, root->childCount()}};
 }
 
+//=================
+// Background Work
+//=================
+
+TaskPool& backgroundPool() {
+    struct PoolHolder : QObject {
+        using QObject::QObject;
+        TaskPool pool;
+    };
+    static auto* holder = new PoolHolder{qApp};
+    return holder->pool;
+}
+
 //=================
 // Name Conversion
 //=================
@@ -73,14 +86,49 @@ void GraphicalSynchronizer::timerEvent(QTimerEvent*) {
 // Observer
 //==========
 
+namespace {
+
+uint32_t hash_bytes(const byte_t* first, const byte_t* last) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for ( ; first != last ; ++first)
+        hash = (hash ^ *first) * 16777619u;
+    return hash;
+}
+
+uint32_t coalescing_key(const Event& event) {
+    switch (event.family()) {
+    case family_t::controller:
+    case family_t::aftertouch:
+        return event.static_data()[1];
+    case family_t::extended_voice:
+    case family_t::extended_system:
+    case family_t::extended_meta: {
+        // hash the extension key only so that successive values share the same slot
+        const auto* data = event.dynamic_data();
+        return hash_bytes(data, std::find(data, data + event.dynamic_size(), 0x00));
+    }
+    case family_t::sysex:
+        // distinct sysex have distinct effects, only identical ones are coalesced
+        return hash_bytes(event.dynamic_data(), event.dynamic_data() + event.dynamic_size());
+    default:
+        return 0;
+    }
+}
+
+}
+
+constexpr size_t Observer::capacity;
+
 Observer::Observer(QObject* parent) : QObject{parent}, Interceptor{} {
-    startTimer(50); // 20 Hz
+    mDirty.reserve(capacity);
+    startTimer(16); // ~60 Hz
 }
 
 Handler::Result Observer::seizeOne(Handler* target, const Message& message) {
     const auto result = target->receive_message(message);
     if (result == Handler::Result::success && message.event.is(~families_t::standard_note()))
-        mQueue.produce(Item{target, message});
+        store(target, message);
     return result;
 }
 
@@ -93,11 +141,54 @@ void Observer::seize_messages(Handler* target, const Messages& messages) {
     seizeAll(target, messages);
 }
 
+void Observer::store(Handler* target, const Message& message) {
+    const auto family = message.event.family();
+    const auto channels = message.event.channels();
+    const auto key = coalescing_key(message.event);
+    const auto hash = std::hash<Handler*>{}(target) ^ (static_cast<size_t>(family) << 24) ^ (static_cast<size_t>(channels.to_integral()) << 8) ^ key;
+    std::lock_guard<std::mutex> guard{mMutex};
+    const auto order = mOrder++;
+    // open addressing with linear probing, empty slots have no handler
+    for (size_t probe = 0 ; probe < capacity ; ++probe) {
+        const auto index = (hash + probe) % capacity;
+        auto& slot = mSlots[index];
+        if (!slot.handler) {
+            slot.handler = target;
+            slot.family = family;
+            slot.channels = channels;
+            slot.key = key;
+            mDirty.push_back(index);
+        } else if (slot.handler != target || slot.family != family || slot.channels != channels || slot.key != key) {
+            continue;
+        }
+        slot.order = order;
+        slot.message = message;
+        return;
+    }
+    mOverflow.emplace_back(order, Item{target, message});
+}
+
 void Observer::timerEvent(QTimerEvent*) {
-    mQueue.consume([this](const auto& items) {
-        for (const auto& item : items)
-            emit messageHandled(item.first, item.second);
-    });
+    std::vector<std::pair<size_t, Item>> orderedItems;
+    {
+        std::lock_guard<std::mutex> guard{mMutex};
+        if (mDirty.empty())
+            return;
+        orderedItems.reserve(mDirty.size() + mOverflow.size());
+        for (auto index : mDirty) {
+            auto& slot = mSlots[index];
+            orderedItems.emplace_back(slot.order, Item{std::exchange(slot.handler, nullptr), std::move(slot.message)});
+        }
+        std::move(mOverflow.begin(), mOverflow.end(), std::back_inserter(orderedItems));
+        mDirty.clear();
+        mOverflow.clear();
+    }
+    std::sort(orderedItems.begin(), orderedItems.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+    Items items;
+    items.reserve(orderedItems.size());
+    for (auto& orderedItem : orderedItems)
+        items.push_back(std::move(orderedItem.second));
+    emit messagesHandled(items);
 }
 
 //=======================
@@ -169,6 +260,39 @@ EditableHandler::EditableHandler(Mode mode) : HandlerView(), Handler(mode) {
 // HandlerProxy
 //==============
 
+namespace {
+
+const QStringList overloadNames {"block", "drop_oldest", "drop_non_notes", "coalesce"}; /*!< indexed by Handler::Overload */
+const QStringList executionNames {"auto", "queued", "inline"}; /*!< indexed by Handler::Execution */
+
+size_t setCommonParameter(Handler* handler, const HandlerProxy::Parameter& parameter) {
+    auto limit = handler->queue_limit();
+    if (parameter.name == "execution") {
+        const int index = executionNames.indexOf(parameter.value);
+        if (index == -1)
+            return 0;
+        handler->set_execution(static_cast<Handler::Execution>(index));
+        return 1;
+    } else if (parameter.name == "queue_capacity") {
+        bool ok;
+        const auto capacity = parameter.value.toUInt(&ok);
+        if (!ok)
+            return 0;
+        limit.capacity = capacity;
+    } else if (parameter.name == "queue_policy") {
+        const int index = overloadNames.indexOf(parameter.value);
+        if (index == -1)
+            return 0;
+        limit.policy = static_cast<Handler::Overload>(index);
+    } else {
+        return 0;
+    }
+    handler->set_queue_limit(limit);
+    return 1;
+}
+
+}
+
 Handler* HandlerProxy::handler() const {
     return mHandler;
 }
@@ -246,11 +370,20 @@ void HandlerProxy::sendCommand(Command command, State state) const {
 }
 
 HandlerProxy::Parameters HandlerProxy::getParameters() const {
-    return mView ? mView->getParameters() : Parameters{};
+    auto result = mView ? mView->getParameters() : Parameters{};
+    if (mHandler) {
+        result.push_back({"execution", executionNames.at(static_cast<int>(mHandler->execution()))});
+        const auto limit = mHandler->queue_limit();
+        result.push_back({"queue_capacity", QString::number(limit.capacity)});
+        result.push_back({"queue_policy", overloadNames.at(static_cast<int>(limit.policy))});
+    }
+    return result;
 }
 
 size_t HandlerProxy::setParameter(const Parameter& parameter, bool notify) const {
-    const size_t count = mView ? mView->setParameter(parameter) : 0;
+    size_t count = mHandler ? setCommonParameter(mHandler, parameter) : 0;
+    if (count == 0 && mView)
+        count = mView->setParameter(parameter);
     if (count == 0)
         TRACE_ERROR(name() << ": unable to set parameter " << parameter.name);
     else if (notify)
@@ -313,10 +446,24 @@ HandlerProxy takeProxy(HandlerProxies& proxies, const Handler* handler) {
     return takeProxyIf(proxies, [=](const auto& proxy) { return proxy.handler() == handler; });
 }
 
+//=====================
+// HandlerProxyFactory
+//=====================
+
+bool HandlerProxyFactory::isConcurrent() const {
+    return false;
+}
+
 //=============
 // MetaHandler
 //=============
 
+MetaHandler::MetaHandler(QObject* parent) : QObject{parent} {
+    addParameter({"execution", "how messages are handled: auto, queued (by worker threads) or inline (by the sender)", "auto", MetaParameter::Visibility::advanced});
+    addParameter({"queue_capacity", "maximum number of messages waiting to be handled, 0 means unbounded", "0", MetaParameter::Visibility::advanced});
+    addParameter({"queue_policy", "behavior of a full queue: block, drop_oldest, drop_non_notes or coalesce", "drop_oldest", MetaParameter::Visibility::advanced});
+}
+
 const QString& MetaHandler::identifier() const {
     return mIdentifier;
 }
@@ -432,6 +579,7 @@ PathRetrieverPool::PathRetrieverPool(QObject* parent) : QObject{parent} {
     initializePathRetriever(get("midi"), "MIDI Files", "*.mid *.midi *.kar");
     initializePathRetriever(get("soundfont"), "SoundFont Files", "*.sf2");
     initializePathRetriever(get("configuration"), "Configuration Files", "*.xml");
+    initializePathRetriever(get("log"), "Log Files", "*.txt *.log");
     load();
 }
 
@@ -38,6 +38,12 @@ using namespace qoperators;
 
 range_t<ChildItemIterator> makeChildRange(QTreeWidgetItem* root);
 
+//=================
+// Background Work
+//=================
+
+TaskPool& backgroundPool(); /*!< shared by all editors, owned by the application and joined when it is destroyed */
+
 //=================
 // Name Conversion
 //=================
@@ -79,11 +85,21 @@ private:
 // Observer
 //==========
 
+/// The observer coalesces handled messages so that the GUI only receives the latest state:
+/// messages are keyed by (handler, family, channels, controller or extension key),
+/// each key owns a slot in a fixed-size table keeping its last message only,
+/// and all dirty slots are emitted once per frame in a single batch.
+
 class Observer : public QObject, public Interceptor {
 
     Q_OBJECT
 
 public:
+    using Item = std::pair<Handler*, Message>;
+    using Items = std::vector<Item>;
+
+    static constexpr size_t capacity = 512; /*!< number of distinct slots per frame */
+
     explicit Observer(QObject* parent);
 
     Result seizeOne(Handler* target, const Message& message);
@@ -95,11 +111,25 @@ protected:
     void timerEvent(QTimerEvent* event) override;
 
 signals:
-    void messageHandled(Handler* handler, const Message& message);
+    void messagesHandled(const Observer::Items& items); /*!< items are sorted by the time of their last update */
 
 private:
-    using Item = std::pair<Handler*, Message>;
-    Queue<std::vector<Item>> mQueue;
+    struct Slot {
+        Handler* handler {nullptr};
+        family_t family {family_t::invalid};
+        channels_t channels {};
+        uint32_t key {0};
+        size_t order {0}; /*!< update counter used to restore the original order */
+        Message message;
+    };
+
+    void store(Handler* target, const Message& message);
+
+    std::array<Slot, capacity> mSlots;
+    std::vector<size_t> mDirty; /*!< indices of used slots */
+    std::vector<std::pair<size_t, Item>> mOverflow; /*!< messages that could not fit in the table */
+    size_t mOrder {0};
+    std::mutex mMutex;
 
 };
 
@@ -282,6 +312,8 @@ public:
 
     virtual HandlerProxy instantiate(const QString& name) = 0;
 
+    virtual bool isConcurrent() const; /*!< true if instantiate may run outside the GUI thread, default is false */
+
 };
 
 //==================
@@ -301,6 +333,10 @@ public:
         return proxy;
     }
 
+    bool isConcurrent() const override {
+        return !std::is_base_of<QObject, ContentT>::value;
+    }
+
 };
 
 //====================
@@ -340,7 +376,7 @@ public:
 
     using MetaParameters = std::vector<MetaParameter>;
 
-    using QObject::QObject;
+    explicit MetaHandler(QObject* parent); /*!< execution & queue parameters are common to all handlers */
 
     const QString& identifier() const;
     const QString& description() const;
@@ -18,6 +18,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include <future>
 #include <QApplication>
 #include <QMainWindow>
 #include "qcore/manager.h"
@@ -25,6 +26,47 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 namespace {
 
+//=========
+// Timings
+//=========
+
+/// Breakdown of the time spent loading a configuration, reported once loaded
+
+class Timings {
+
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration_type = std::chrono::duration<double, std::milli>;
+    using Durations = std::vector<std::pair<QString, duration_type>>;
+
+    void lap(const char* step) {
+        const auto now = clock_type::now();
+        mSteps.emplace_back(step, now - mLast);
+        mLast = now;
+    }
+
+    void report(Durations handlers) const {
+        static constexpr size_t slowest = 5;
+        QStringList steps;
+        for (const auto& step : mSteps)
+            steps.append(QString{"%1 %2 ms"}.arg(step.first).arg(step.second.count(), 0, 'f', 1));
+        TRACE_INFO("configuration loaded in " << duration_type{mLast - mStart}.count() << " ms: " << steps.join(", "));
+        std::sort(handlers.begin(), handlers.end(), [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+        handlers.resize(std::min(handlers.size(), slowest));
+        QStringList names;
+        for (const auto& handler : handlers)
+            names.append(QString{"%1 %2 ms"}.arg(handler.first).arg(handler.second.count(), 0, 'f', 1));
+        if (!names.empty())
+            TRACE_INFO("slowest handlers: " << names.join(", "));
+    }
+
+private:
+    const clock_type::time_point mStart {clock_type::now()};
+    clock_type::time_point mLast {mStart};
+    Durations mSteps;
+
+};
+
 //=====================
 // ConfigurationPuller
 //=====================
@@ -32,11 +74,17 @@ namespace {
 class ConfigurationPuller {
 
 public:
-    ConfigurationPuller(Manager* manager) : mManager{manager} {
+    ConfigurationPuller(Manager* manager, HandlerProxies reusableProxies = {}) :
+        mManager{manager}, mReusableProxies{std::move(reusableProxies)} {
+
+    }
 
+    const HandlerProxies& reusableProxies() const {
+        return mReusableProxies;
     }
 
     void addConfiguration(const Configuration& configuration) {
+        Timings timings;
         // set colors
         for (channel_t c=0 ; c < std::min(channels_t::capacity(), configuration.colors.size()) ; ++c)
             mManager->channelEditor()->setColor(c, configuration.colors.at(c));
@@ -46,15 +94,23 @@ public:
             setFrame(mainDisplayer, configuration.frames[0], true);
         for (size_t i=1 ; i < configuration.frames.size() ; i++)
             addFrame(mainDisplayer, configuration.frames[i], true);
-        // add handlers
+        timings.lap("frames");
+        // add handlers, the ones that do not need the GUI thread are built concurrently
+        matchHandlers(configuration.handlers);
+        prefetchHandlers(configuration.handlers);
         for (const auto& handler : configuration.handlers)
             addHandler(handler);
+        timings.lap("handlers");
         // add connections
         for (const auto& connection : configuration.connections)
             addConnection(connection);
+        publishListeners();
+        timings.lap("connections");
         // display visible frames created
         for (auto* displayer : mVisibleDisplayers)
             displayer->show();
+        timings.lap("display");
+        timings.report(mHandlerTimings);
     }
 
     void addConnection(const Configuration::Connection& connection) {
@@ -66,22 +122,63 @@ public:
             TRACE_WARNING("wrong connection handlers: " << handlerName(tail) << ' ' << handlerName(head) << ' ' << handlerName(source));
             return;
         }
-        mManager->insertConnection(tail, head, hasSource ? Filter::handler(source) : Filter{});
+        if (tail == head) {
+            TRACE_ERROR("wrong connection: the tail can't be the head");
+            return;
+        }
+        getListeners(tail).insert(head, hasSource ? Filter::handler(source) : Filter{});
+    }
+
+    void matchHandlers(const Configuration::Handlers& handlers) {
+        for (const auto& handler : handlers) {
+            auto proxy = takeProxyIf(mReusableProxies, [&](const auto& px) { return px.metaHandler()->identifier() == handler.type && px.name() == handler.name; });
+            if (proxy.handler())
+                mReusedProxies[handler.id] = proxy;
+        }
+    }
+
+    void prefetchHandlers(const Configuration::Handlers& handlers) {
+        for (const auto& handler : handlers) {
+            auto* meta = mManager->metaHandlerPool()->get(handler.type);
+            if (meta && meta->factory()->isConcurrent() && !mReusedProxies.contains(handler.id) && mPendingProxies.count(handler.id) == 0) {
+                mPendingProxies[handler.id] = std::async(std::launch::async, [meta, name=handler.name] {
+                    const auto t0 = Timings::clock_type::now();
+                    auto proxy = meta->instantiate(name);
+                    return std::make_pair(proxy, Timings::duration_type{Timings::clock_type::now() - t0});
+                });
+            }
+        }
     }
 
     void addHandler(const Configuration::Handler& handler) {
-        // create the handler
+        // reuse a living handler, take a prefetched one or create a new one
         auto* host = mViewReferences.value(handler.id, nullptr);
-        auto proxy = mManager->loadHandler(handler.type, handler.name, host);
+        auto proxy = mReusedProxies.take(handler.id);
         if (proxy.handler()) {
-            mHandlersReferences[handler.id] = proxy.handler();
-            for (const auto& prop : handler.properties)
-                proxy.setParameter({prop.key, prop.value}, false);
-            if (!handler.properties.empty())
-                proxy.notifyParameters();
+            reuseHandler(proxy, handler, host);
         } else {
-            TRACE_ERROR("unable to build handler " << handler.type << "(\"" << handler.name << "\")");
+            auto it = mPendingProxies.find(handler.id);
+            if (it != mPendingProxies.end()) {
+                const auto instance = it->second.get();
+                mPendingProxies.erase(it);
+                proxy = mManager->insertHandler(instance.first, host);
+                mHandlerTimings.emplace_back(handler.name, instance.second);
+            } else {
+                const auto t0 = Timings::clock_type::now();
+                proxy = mManager->loadHandler(handler.type, handler.name, host);
+                mHandlerTimings.emplace_back(handler.name, Timings::clock_type::now() - t0);
+            }
+            if (proxy.handler()) {
+                for (const auto& prop : handler.properties)
+                    proxy.setParameter({prop.key, prop.value}, false);
+                if (!handler.properties.empty())
+                    proxy.notifyParameters();
+            }
         }
+        if (proxy.handler())
+            mHandlersReferences[handler.id] = proxy.handler();
+        else
+            TRACE_ERROR("unable to build handler " << handler.type << "(\"" << handler.name << "\")");
         // if the view does not belong to a frame, make it visible
         if (!host && proxy.view())
             mVisibleDisplayers.push_back(proxy.view()->window());
@@ -91,6 +188,34 @@ public:
         }
     }
 
+    void reuseHandler(const HandlerProxy& proxy, const Configuration::Handler& handler, SingleDisplayer* host) {
+        // move the view to its new frame
+        if (auto* view = proxy.view()) {
+            if (auto* previousHost = dynamic_cast<SingleDisplayer*>(view->parentWidget()))
+                previousHost->takeWidget();
+            if (!host)
+                host = mManager->mainDisplayer()->insertDetached()->insertSingle();
+            host->setWidget(view);
+        }
+        // apply parameters that differ, missing ones are reset to their default value
+        size_t count = 0;
+        const auto parameters = proxy.getParameters();
+        for (const auto& parameter : parameters) {
+            auto it = std::find_if(handler.properties.begin(), handler.properties.end(), [&](const auto& prop) { return prop.key == parameter.name; });
+            if (it == handler.properties.end())
+                count += proxy.resetParameter(parameter.name, false);
+            else if (it->value != parameter.value)
+                count += proxy.setParameter({it->key, it->value}, false);
+        }
+        for (const auto& prop : handler.properties)
+            if (std::none_of(parameters.begin(), parameters.end(), [&](const auto& parameter) { return parameter.name == prop.key; }))
+                count += proxy.setParameter({prop.key, prop.value}, false);
+        if (count != 0)
+            proxy.notifyParameters();
+        // connections of reused handlers are rebuilt from the configuration
+        mListeners[proxy.handler()] = Listeners{};
+    }
+
     void addWidget(MultiDisplayer* parent, const Configuration::Widget& widget) {
         if (widget.isFrame)
             addFrame(parent, widget.frame, false);
@@ -124,7 +249,33 @@ public:
     }
 
 private:
+    Listeners& getListeners(Handler* tail) {
+        auto it = mListeners.find(tail);
+        if (it == mListeners.end())
+            it = mListeners.emplace(tail, tail->listeners()).first;
+        return it->second;
+    }
+
+    void publishListeners() {
+        // tables are all computed before being published, unchanged ones are kept with their traffic counters
+        for (auto& entry : mListeners)
+            if (!equivalent(entry.first->listeners(), entry.second))
+                mManager->setListeners(entry.first, std::move(entry.second));
+    }
+
+    static bool equivalent(const Listeners& lhs, const Listeners& rhs) {
+        return lhs.size() == rhs.size() && std::all_of(lhs.begin(), lhs.end(), [&](const auto& listener) {
+            auto it = rhs.find(listener.handler);
+            return it != rhs.end() && it->filter == listener.filter;
+        });
+    }
+
     Manager* mManager;
+    HandlerProxies mReusableProxies;
+    QMap<QString, HandlerProxy> mReusedProxies;
+    std::map<QString, std::future<std::pair<HandlerProxy, Timings::duration_type>>> mPendingProxies;
+    Timings::Durations mHandlerTimings;
+    std::map<Handler*, Listeners> mListeners;
     QMap<QString, Handler*> mHandlersReferences;
     QMap<QString, SingleDisplayer*> mViewReferences;
     std::vector<QWidget*> mVisibleDisplayers;
@@ -341,6 +492,14 @@ void Manager::setSystemTrayIcon(QSystemTrayIcon* tray) {
     mSystemTrayIcon = tray;
 }
 
+bool Manager::fusion() const {
+    return mInlineSynchronizer.fusion();
+}
+
+void Manager::setFusion(bool fusion) {
+    mInlineSynchronizer.set_fusion(fusion);
+}
+
 Configuration Manager::getConfiguration() {
     TRACE_MEASURE("get configuration");
     ConfigurationPusher pusher{this};
@@ -353,14 +512,31 @@ void Manager::setConfiguration(const Configuration& configuration) {
     puller.addConfiguration(configuration);
 }
 
+void Manager::updateConfiguration(const Configuration& configuration) {
+    TRACE_MEASURE("update configuration");
+    ConfigurationPuller puller{this, mHandlerProxies};
+    puller.addConfiguration(configuration);
+    // remove handlers that were not reused
+    HandlerProxies proxies = puller.reusableProxies();
+    for (const auto& proxy : proxies)
+        takeProxy(mHandlerProxies, proxy.handler());
+    removeProxies(proxies);
+}
+
 void Manager::clearConfiguration() {
     TRACE_MEASURE("clear configuration");
     HandlerProxies proxies;
     // clear proxies
     mHandlerProxies.swap(proxies);
+    removeProxies(proxies);
+}
+
+void Manager::removeProxies(const HandlerProxies& proxies) {
     // clear listeners
-    for (const auto& proxy : proxies)
+    for (const auto& proxy : proxies) {
         setListeners(proxy.handler(), {});
+        mScheduler.cancel(proxy.handler());
+    }
     // notify listening slots
     for (const auto& proxy : proxies)
         emit handlerRemoved(proxy.handler());
@@ -369,7 +545,14 @@ void Manager::clearConfiguration() {
 }
 
 HandlerProxy Manager::loadHandler(MetaHandler* meta, const QString& name, SingleDisplayer* host) {
-    auto proxy = meta ? meta->instantiate(name) : HandlerProxy{};
+    return insertHandler(meta ? meta->instantiate(name) : HandlerProxy{}, host);
+}
+
+HandlerProxy Manager::loadHandler(const QString& type, const QString& name, SingleDisplayer* host) {
+    return loadHandler(mMetaHandlerPool->get(type), name, host);
+}
+
+HandlerProxy Manager::insertHandler(HandlerProxy proxy, SingleDisplayer* host) {
     // set view's parent
     if (auto* view = proxy.view()) {
         if (!host)
@@ -382,7 +565,8 @@ HandlerProxy Manager::loadHandler(MetaHandler* meta, const QString& name, Single
         if (proxy.editable())
             proxy.handler()->set_synchronizer(mGUISynchronizer);
         else
-            proxy.handler()->set_synchronizer(&mDefaultSynchronizer);
+            proxy.handler()->set_synchronizer(&mInlineSynchronizer);
+        proxy.handler()->set_scheduler(&mScheduler);
         proxy.setObserver(mObserver);
         proxy.setContext(this);
         proxy.sendCommand(HandlerProxy::Command::Open);
@@ -392,10 +576,6 @@ HandlerProxy Manager::loadHandler(MetaHandler* meta, const QString& name, Single
     return proxy;
 }
 
-HandlerProxy Manager::loadHandler(const QString& type, const QString& name, SingleDisplayer* host) {
-    return loadHandler(mMetaHandlerPool->get(type), name, host);
-}
-
 void Manager::removeHandler(Handler* handler) {
     Q_ASSERT(handler);
     // take proxy
@@ -410,7 +590,8 @@ void Manager::removeHandler(Handler* handler) {
     if (px.handler()) {
         // notify listening slots
         emit handlerRemoved(handler);
-        // schedule deletion
+        // drop delayed messages and schedule deletion
+        mScheduler.cancel(handler);
         mDeleter->addProxy(px);
     }
 }
@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef QCORE_MANAGER_H
 #define QCORE_MANAGER_H
 
+#include "core/scheduler.h"
 #include "qcore/core.h"
 #include "qcore/editors.h"
 #include "qcore/configuration.h"
@@ -89,16 +90,23 @@ public:
     void setQuickToolBar(QToolBar* toolbar);
     void setSystemTrayIcon(QSystemTrayIcon* tray);
 
+    // engine
+
+    bool fusion() const;
+    void setFusion(bool fusion); /*!< fuses fusable handlers with automatic execution, @see InlineSynchronizer */
+
     // configuration
 
     Configuration getConfiguration();
-    void setConfiguration(const Configuration& configuration);
+    void setConfiguration(const Configuration& configuration); /*!< adds the configuration to the current one */
+    void updateConfiguration(const Configuration& configuration); /*!< replaces the current configuration, keeping matching handlers alive */
     void clearConfiguration();
 
     // proxies
 
     HandlerProxy loadHandler(MetaHandler* meta, const QString& name, SingleDisplayer* host);
     HandlerProxy loadHandler(const QString& type, const QString& name, SingleDisplayer* host);
+    HandlerProxy insertHandler(HandlerProxy proxy, SingleDisplayer* host); /*!< registers an instantiated proxy */
     void removeHandler(Handler* handler);
 
     // signaling commands
@@ -112,6 +120,7 @@ public:
     void removeConnection(Handler* tail, Handler* head, Handler* source);
 
 private:
+    void removeProxies(const HandlerProxies& proxies); /*!< proxies must have been taken from mHandlerProxies */
     void onDeletion();
 
     HandlerProxies mHandlerProxies;
@@ -119,6 +128,8 @@ private:
     MetaHandlerPool* mMetaHandlerPool;
     GraphicalSynchronizer* mGUISynchronizer;
     StandardSynchronizer<2> mDefaultSynchronizer; /*!< 2 threads are enough */
+    InlineSynchronizer mInlineSynchronizer {&mDefaultSynchronizer}; /*!< used by non graphical handlers, queues in mDefaultSynchronizer */
+    Scheduler mScheduler; /*!< declared after synchronizers so that it stops first */
     Deleter* mDeleter;
     Observer* mObserver;
     SignalNotifier* mSignalNotifier;
@@ -18,6 +18,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include <cmath>
 #include <QGraphicsSceneContextMenuEvent>
 #include <QHeaderView>
 #include <QInputDialog>
@@ -72,20 +73,30 @@ void EdgeWrapper::setFilter(Filter filter) {
     mFilter = std::move(filter);
 }
 
+void EdgeWrapper::setTraffic(std::shared_ptr<ListenerTraffic> traffic) {
+    if (traffic == mTraffic)
+        return;
+    mTraffic = std::move(traffic);
+    mMessages = mTraffic->messages.load(std::memory_order_relaxed);
+    mBytes = mTraffic->bytes.load(std::memory_order_relaxed);
+    mFiltered = mTraffic->filtered.load(std::memory_order_relaxed);
+}
+
 void EdgeWrapper::setVisibility(Filter::match_type match) {
     switch (match.value) {
         case Filter::match_type::true_value:
             setVisible(true);
-            setArrowColor(Qt::black);
+            mColor = Qt::black;
         break;
         case Filter::match_type::false_value:
             setVisible(false);
         break;
         case Filter::match_type::indeterminate_value:
             setVisible(true);
-            setArrowColor(Qt::darkGray);
+            mColor = Qt::darkGray;
         break;
     }
+    updateHeat();
 }
 
 void EdgeWrapper::updateVisibility(Handler* source) {
@@ -96,6 +107,34 @@ void EdgeWrapper::updateVisibility() {
     setVisibility(mFilter.match_nothing());
 }
 
+void EdgeWrapper::updateTraffic(qreal seconds) {
+    if (!mTraffic || seconds <= 0.)
+        return;
+    const auto messages = mTraffic->messages.load(std::memory_order_relaxed);
+    const auto bytes = mTraffic->bytes.load(std::memory_order_relaxed);
+    const auto filtered = mTraffic->filtered.load(std::memory_order_relaxed);
+    const auto messagesRate = (messages - mMessages) / seconds;
+    const auto bytesRate = (bytes - mBytes) / seconds;
+    const auto filteredRate = (filtered - mFiltered) / seconds;
+    mMessages = messages;
+    mBytes = bytes;
+    mFiltered = filtered;
+    // logarithmic scale saturating at 1000 messages per second
+    mHeat = qMin(1., std::log10(1. + messagesRate) / 3.);
+    updateHeat();
+    setToolTip(QString{"%1 msgs/s, %2 bytes/s, %3 filtered/s\ntotal: %4 msgs, %5 bytes, %6 filtered"}
+        .arg(messagesRate, 0, 'f', 1).arg(bytesRate, 0, 'f', 1).arg(filteredRate, 0, 'f', 1)
+        .arg(messages).arg(bytes).arg(filtered));
+}
+
+void EdgeWrapper::updateHeat() {
+    const QColor hot{Qt::red};
+    setArrowColor(QColor::fromRgbF(mColor.redF() + mHeat * (hot.redF() - mColor.redF()),
+                                   mColor.greenF() + mHeat * (hot.greenF() - mColor.greenF()),
+                                   mColor.blueF() + mHeat * (hot.blueF() - mColor.blueF())));
+    setWidth(1. + 3. * mHeat);
+}
+
 void EdgeWrapper::contextMenuEvent(QGraphicsSceneContextMenuEvent* event) {
     QMenu menu;
     auto* straightenAction = menu.addAction("Straighten");
@@ -145,6 +184,9 @@ HandlerGraphEditor::HandlerGraphEditor(Manager* manager, QWidget* parent) : QWid
     connect(centerButton, &QPushButton::clicked, mGraph, &Graph::centerOnScene);
     // layout
     setLayout(make_vbox(margin_tag{0}, mGraph, make_hbox(stretch_tag{}, centerButton, mFilter, mSelector)));
+
+    mTrafficTimer.start();
+    startTimer(500); // 2 Hz
 }
 
 Graph* HandlerGraphEditor::graph() {
@@ -249,6 +291,7 @@ void HandlerGraphEditor::updateListeners(Handler* handler) {
             mGraph->insertEdge(edge);
         }
         edge->setFilter(std::move(listener.filter));
+        edge->setTraffic(listener.traffic);
         updateEdgeVisibility(edge);
     }
     // delete old edges that no longer exist
@@ -258,6 +301,19 @@ void HandlerGraphEditor::updateListeners(Handler* handler) {
             mGraph->deleteEdge(edge);
 }
 
+void HandlerGraphEditor::timerEvent(QTimerEvent*) {
+    if (!isVisible())
+        return;
+    const auto seconds = mTrafficTimer.restart() / 1000.;
+    for (auto* node : mNodes) {
+        const auto queueSize = node->handler()->queue_size();
+        node->setBadge(queueSize == 0 ? QString{} : QString::number(queueSize));
+        for (auto* edge : node->edges())
+            if (edge->tail() == node)
+                static_cast<EdgeWrapper*>(edge)->updateTraffic(seconds);
+    }
+}
+
 void HandlerGraphEditor::forwardEdgeCreation(Node* tail, Node* head) {
     auto* sender = static_cast<HandlerNode*>(tail)->handler();
     auto* receiver = static_cast<HandlerNode*>(head)->handler();
@@ -425,7 +481,7 @@ HandlerListEditor::HandlerListEditor(Manager* manager, QWidget* parent) : QWidge
     connect(manager, &Context::handlerRemoved, this, &HandlerListEditor::removeHandler);
     connect(manager, &Context::handlerRenamed, this, &HandlerListEditor::renameHandler);
     connect(manager, &Context::handlerParametersChanged, this, &HandlerListEditor::refreshHandler);
-    connect(manager->observer(), &Observer::messageHandled, this, &HandlerListEditor::onMessageHandled);
+    connect(manager->observer(), &Observer::messagesHandled, this, &HandlerListEditor::onMessagesHandled);
 
     connect(this, &HandlerListEditor::customContextMenuRequested, this, &HandlerListEditor::showMenu);
     connect(mTree, &QTreeWidget::itemChanged, this, &HandlerListEditor::onItemChange);
@@ -440,12 +496,34 @@ HandlerListEditor::HandlerListEditor(Manager* manager, QWidget* parent) : QWidge
     auto* collapseButton = new CollapseButton{mTree};
 
     setLayout(make_vbox(margin_tag{0}, mTree, make_hbox(stretch_tag{}, mVisibilityBox, expandButton, collapseButton)));
+
+    startTimer(1000); // 1 Hz
 }
 
 QSize HandlerListEditor::sizeHint() const {
     return {250, 400};
 }
 
+void HandlerListEditor::timerEvent(QTimerEvent*) {
+    if (!isVisible())
+        return;
+    for (auto* item : makeChildRange(mTree->invisibleRootItem())) {
+        auto* handler = handlerForItem(item);
+        const auto statistics = handler->queue_statistics();
+        const auto losses = static_cast<qulonglong>(statistics.blocked + statistics.dropped + statistics.coalesced);
+        // highlight handlers whose queue overflowed since the last refresh
+        const auto previousLosses = item->data(keyColumn, Qt::UserRole).toULongLong();
+        item->setData(keyColumn, Qt::UserRole, losses);
+        item->setForeground(nameColumn, losses != previousLosses ? QBrush{Qt::red} : QBrush{});
+        const auto proxy = getProxy(mManager->handlerProxies(), handler);
+        QString toolTip = metaDescription(proxy.metaHandler());
+        if (statistics.peak != 0)
+            toolTip += QString{"\nqueue: peak %1, blocked %2, dropped %3, coalesced %4"}
+                .arg(statistics.peak).arg(statistics.blocked).arg(statistics.dropped).arg(statistics.coalesced);
+        item->setToolTip(nameColumn, toolTip);
+    }
+}
+
 void HandlerListEditor::insertHandler(Handler* handler) {
     QSignalBlocker sb{mTree};
     auto proxy = getProxy(mManager->handlerProxies(), handler);
@@ -478,10 +556,13 @@ void HandlerListEditor::refreshHandler(Handler* handler) {
     }
 }
 
-void HandlerListEditor::onMessageHandled(Handler* handler, const Message& message) {
-    if (message.event.is(family_t::extended_system) && (Handler::open_ext.affects(message.event) || Handler::close_ext.affects(message.event)))
-        if (auto* item = itemForHandler(mTree->invisibleRootItem(), handler))
-            item->setIcon(nameColumn, modeIcon(handler));
+void HandlerListEditor::onMessagesHandled(const Observer::Items& items) {
+    for (const auto& item : items) {
+        const auto& event = item.second.event;
+        if (event.is(family_t::extended_system) && (Handler::open_ext.affects(event) || Handler::close_ext.affects(event)))
+            if (auto* treeItem = itemForHandler(mTree->invisibleRootItem(), item.first))
+                treeItem->setIcon(nameColumn, modeIcon(item.first));
+    }
 }
 
 void HandlerListEditor::showMenu(const QPoint& point) {
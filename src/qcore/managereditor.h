@@ -21,6 +21,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef QCORE_MANAGER_EDITOR_H
 #define QCORE_MANAGER_EDITOR_H
 
+#include <QElapsedTimer>
 #include "qcore/manager.h"
 #include "qtools/graph.h"
 
@@ -60,16 +61,26 @@ public:
     HandlerGraphEditor* parent() const;
 
     void setFilter(Filter filter);
+    void setTraffic(std::shared_ptr<ListenerTraffic> traffic);
     void setVisibility(Filter::match_type match);
 
     void updateVisibility(Handler* source);
     void updateVisibility();
+    void updateTraffic(qreal seconds); /*!< samples counters, seconds elapsed since the last sample */
 
 protected:
     void contextMenuEvent(QGraphicsSceneContextMenuEvent* event) override;
 
 private:
+    void updateHeat();
+
     Filter mFilter;
+    std::shared_ptr<ListenerTraffic> mTraffic;
+    size_t mMessages {0};
+    size_t mBytes {0};
+    size_t mFiltered {0};
+    qreal mHeat {0.}; /*!< 0 when idle, 1 when saturated */
+    QColor mColor {Qt::black}; /*!< color without heat */
 
 };
 
@@ -118,7 +129,11 @@ protected slots:
     void updateEdgeVisibility(EdgeWrapper* edge);
     void updateEdgesVisibility();
 
+protected:
+    void timerEvent(QTimerEvent* event) override; /*!< refreshes traffic overlay */
+
 private:
+    QElapsedTimer mTrafficTimer;
     Graph* mGraph;
     QCheckBox* mFilter;
     HandlerSelector* mSelector;
@@ -143,12 +158,15 @@ public:
 
     QSize sizeHint() const override;
 
+protected:
+    void timerEvent(QTimerEvent* event) override; /*!< refreshes queue statistics */
+
 private slots:
     void insertHandler(Handler* handler);
     void renameHandler(Handler* handler);
     void removeHandler(Handler* handler);
     void refreshHandler(Handler* handler);
-    void onMessageHandled(Handler* handler, const Message& message);
+    void onMessagesHandled(const Observer::Items& items);
 
     void showMenu(const QPoint& point);
     void onItemChange(QTreeWidgetItem* item, int column);
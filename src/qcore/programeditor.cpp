@@ -20,6 +20,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #include <QMessageBox>
 #include <QHeaderView>
+#include <QCryptographicHash>
+#include <QSettings>
 #include <QtXml>
 #include <QXmlSchema>
 #include <QXmlSchemaValidator>
@@ -47,6 +49,45 @@ Patch parsePatch(const QDomNode& node) {
     return patch;
 }
 
+Patch readPatches() {
+    TRACE_MEASURE("read programs");
+
+    /// Read patches from file
+    QByteArray programsData;
+    QFile programsFile{":/data/programs.xml"};
+    if (programsFile.open(QIODevice::ReadOnly)) {
+        programsData = programsFile.readAll();
+        programsFile.close();
+    } else {
+        TRACE_ERROR("Can't read file programs.xml");
+    }
+
+    /// Construct XSD Validator and check, unless the same content has already been validated
+    const auto checksum = QCryptographicHash::hash(programsData, QCryptographicHash::Md5).toHex();
+    QSettings settings;
+    bool validated = settings.value("programs_checksum").toByteArray() == checksum;
+    if (!validated) {
+        QXmlSchema xsd;
+        validated = true;
+        if (xsd.load(QUrl::fromLocalFile(":/data/programs.xsd"))) {
+            validated = QXmlSchemaValidator{xsd}.validate(programsData);
+            if (validated)
+                settings.setValue("programs_checksum", checksum);
+        }
+    }
+
+    /// construct DOM
+    Patch rootPatch;
+    QDomDocument dom{"DOM Document"};
+    if (validated && dom.setContent(programsData)) {
+        rootPatch = parsePatch(dom.documentElement());
+    } else {
+        rootPatch.addPatch(Patch{"No Patch"});  // required because of at()
+        TRACE_ERROR("programs.xml is illformed");
+    }
+    return rootPatch;
+}
+
 }
 
 //=======
@@ -209,7 +250,7 @@ void ProgramModel::setProgram(channels_t channels, byte_t program) {
     QString tooltip;
     QVariant data;
     if (program != default_program) {
-        text = mPatch->getProgram(program, "????");
+        text = mPatch ? mPatch->getProgram(program, "????") : QString{"????"};
         tooltip = QString::number(program);
         data = static_cast<int>(program);
     }
@@ -235,35 +276,12 @@ ProgramEditor::ProgramEditor(Manager* manager, QWidget* parent) : QWidget{parent
     setWindowIcon(QIcon{":/data/trumpet.svg"});
     setWindowFlags(Qt::Dialog);
 
-    /// Read patches from file
-    QByteArray programsData;
-    QFile programsFile{":/data/programs.xml"};
-    if (programsFile.open(QIODevice::ReadOnly)) {
-        programsData = programsFile.readAll();
-        programsFile.close();
-    } else {
-        TRACE_ERROR("Can't read file programs.xml");
-    }
-
-    /// Construct XSD Validator and check
-    QXmlSchema xsd;
-    bool validated = true;
-    if (xsd.load(QUrl::fromLocalFile(":/data/programs.xsd")))
-        validated = QXmlSchemaValidator{xsd}.validate(programsData);
-
-    /// construct DOM
-    QDomDocument dom{"DOM Document"};
-    if (validated && dom.setContent(programsData)) {
-        mRootPatch = parsePatch(dom.documentElement());
-    } else {
-        mRootPatch.addPatch(Patch{"No Patch"});  // required because of at()
-        TRACE_ERROR("programs.xml is illformed");
-    }
+    /// Read patches in the background, they are only required once shown
+    mPatchesReader = std::async(std::launch::async, readPatches);
+    mRootPatch.addPatch(Patch{"No Patch"});  // required because of at()
 
     // patches combo
     mPatchesCombo = new QComboBox{this};
-    for (const auto& patch : mRootPatch.children())
-        mPatchesCombo->addItem(patch.name());
     connect(mPatchesCombo, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &ProgramEditor::updatePatch);
 
     // handlers combo
@@ -299,7 +317,7 @@ ProgramEditor::ProgramEditor(Manager* manager, QWidget* parent) : QWidget{parent
     // manager signals
     connect(manager, &Context::handlerInserted, this, &ProgramEditor::insertHandler);
     connect(manager, &Context::handlerRemoved, this, &ProgramEditor::removeHandler);
-    connect(manager->observer(), &Observer::messageHandled, this, &ProgramEditor::updateSuccess);
+    connect(manager->observer(), &Observer::messagesHandled, this, &ProgramEditor::updateSuccess);
 
 }
 
@@ -307,6 +325,26 @@ Handler* ProgramEditor::currentHandler() {
     return mHandlerSelector->currentHandler();
 }
 
+void ProgramEditor::showEvent(QShowEvent* event) {
+    updatePatches();
+    QWidget::showEvent(event);
+}
+
+void ProgramEditor::updatePatches() {
+    if (!mPatchesReader.valid())
+        return;
+    // the model may point to a child of the patches being replaced
+    mProgramModel->setPatch(nullptr);
+    mRootPatch = mPatchesReader.get();
+    {
+        QSignalBlocker sb{mPatchesCombo};
+        mPatchesCombo->clear();
+        for (const auto& patch : mRootPatch.children())
+            mPatchesCombo->addItem(patch.name());
+    }
+    showHandler(currentHandler());
+}
+
 void ProgramEditor::insertHandler(Handler* handler) {
     if (handler->mode().any(Handler::Mode::out()) && handler->received_families().test(family_t::program_change)) {
         auto& handlerData = mRecords[handler];
@@ -367,18 +405,21 @@ void ProgramEditor::editProgram(channels_t channels, byte_t program) {
     }
 }
 
-void ProgramEditor::updateSuccess(Handler* handler, const Message& message) {
+void ProgramEditor::updateSuccess(const Observer::Items& items) {
     /// @todo treat bank messages
-    switch (message.event.family()) {
-    case family_t::program_change:
-        receiveProgram(handler, message.event.channels(), extraction_ns::program(message.event));
-        break;
-    case family_t::extended_system:
-        if (Handler::close_ext.affects(message.event) && Handler::close_ext.decode(message.event).any(Handler::State::receive()))
-            receiveProgram(handler, channels_t::full(), default_program);
-        break;
-    default:
-        break;
+    for (const auto& item : items) {
+        const auto& event = item.second.event;
+        switch (event.family()) {
+        case family_t::program_change:
+            receiveProgram(item.first, event.channels(), extraction_ns::program(event));
+            break;
+        case family_t::extended_system:
+            if (Handler::close_ext.affects(event) && Handler::close_ext.decode(event).any(Handler::State::receive()))
+                receiveProgram(item.first, channels_t::full(), default_program);
+            break;
+        default:
+            break;
+        }
     }
 }
 
@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define QCORE_PROGRAM_EDITOR_H
 
 #include <map>
+#include <future>
 #include <QStandardItemModel>
 #include <QItemDelegate>
 #include "qcore/editors.h"
@@ -138,6 +139,9 @@ public:
 
     Handler* currentHandler();
 
+protected:
+    void showEvent(QShowEvent* event) override;
+
 protected slots:
     void insertHandler(Handler* handler);
     void removeHandler(Handler* handler);
@@ -149,17 +153,19 @@ protected slots:
     void sendProgram(Handler* handler, channels_t channels, byte_t program);
 
     void editProgram(channels_t channels, byte_t program); // 'send' slot
-    void updateSuccess(Handler* handler, const Message& message); // 'receive' slot
+    void updateSuccess(const Observer::Items& items); // 'receive' slot
 
     void onClick(const QModelIndex& index);
     void onDoubleClick(const QModelIndex& index);
 
 protected:
+    void updatePatches(); /*!< waits for patches being read (once) */
     void selectHandler(const HandlerData& handlerData);
     bool matchSelection(channels_t channels) const;
     channels_t extend(channels_t channels) const;
 
 private:
+    std::future<Patch> mPatchesReader;
     Patch mRootPatch;
     std::unordered_map<Handler*, HandlerData> mRecords;
     HandlerSelector* mHandlerSelector;
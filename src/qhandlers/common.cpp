@@ -230,6 +230,7 @@ Handler::Result Instrument::handle_close(State state) {
 }
 
 Handler::Result Instrument::handle_message(const Message& message) {
+    mCurrentMessage = &message;
     switch (message.event.family()) {
     case family_t::note_on:
         if (const auto channels = message.event.channels() & mReceivedChannels)
@@ -311,3 +312,7 @@ channels_t Instrument::channelsFromButtons(Qt::MouseButtons buttons) {
     auto* editor = channelEditor();
     return editor ? editor->channelsFromButtons(buttons) : channels_t::wrap(0);
 }
+
+const Message& Instrument::currentMessage() const {
+    return *mCurrentMessage;
+}
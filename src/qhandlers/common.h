@@ -164,7 +164,10 @@ protected:
 
     channels_t channelsFromButtons(Qt::MouseButtons buttons);
 
+    const Message& currentMessage() const; /*!< message being handled, only valid within receive callbacks */
+
 private:
+    const Message* mCurrentMessage {nullptr};
     byte_t mVelocity {0x7f};
     channels_t mReceivedChannels {channels_t::melodic()};
 
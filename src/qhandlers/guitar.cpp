@@ -18,6 +18,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include <functional>
 #include <QPainter>
 #include <QToolTip>
 #include <QHelpEvent>
@@ -65,6 +66,231 @@ const Guitar::Tuning defaultTuning = {note_ns::E(2), note_ns::A(2), note_ns::D(3
 
 }
 
+//=================
+// GuitarFingering
+//=================
+
+namespace {
+
+using Location = GuitarFingering::Location;
+
+constexpr size_t maxEnumerations = 1024; /*!< assignments explored per chord */
+constexpr size_t maxCandidates = 32; /*!< assignments kept per chord */
+constexpr double droppedCost = 100.; /*!< cost of a note that can't be placed */
+constexpr double shiftCost = 1.; /*!< cost of moving the hand by one fret */
+
+struct ChordNote {
+    Note note;
+    channels_t channels;
+};
+
+struct Chord {
+    timestamp_t timestamp;
+    std::vector<ChordNote> notes;
+};
+
+struct Candidate {
+    std::vector<Location> locations; /*!< one per chord note, string is -1 if dropped */
+    int position; /*!< lowest fretted fret, -1 if only open strings are used */
+    double cost;
+};
+
+Candidate evaluate(const std::vector<Location>& locations, size_t dropped, int capo) {
+    int lowest = -1;
+    int highest = -1;
+    double heights = 0.;
+    for (const auto& location : locations) {
+        // frets at the capo position are played open
+        if (location.first != -1 && location.second > capo) {
+            lowest = lowest == -1 ? location.second : std::min(lowest, location.second);
+            highest = std::max(highest, location.second);
+            heights += location.second - capo;
+        }
+    }
+    const int span = lowest == -1 ? 0 : highest - lowest;
+    const double spanCost = span <= 3 ? .5 * span : 1.5 + 4. * (span - 3) * (span - 3);
+    return {locations, lowest, dropped * droppedCost + spanCost + .05 * heights};
+}
+
+std::vector<Candidate> makeCandidates(const Chord& chord, const GuitarFingering::Tuning& tuning, int capo, int fretCount) {
+    std::vector<Candidate> candidates;
+    std::vector<Location> current(chord.notes.size(), Location{-1, 0});
+    std::vector<bool> used(tuning.size(), false);
+    // depth-first enumeration of string assignments
+    std::function<void(size_t, size_t)> explore = [&](size_t i, size_t dropped) {
+        if (candidates.size() >= maxEnumerations)
+            return;
+        if (i == chord.notes.size()) {
+            candidates.push_back(evaluate(current, dropped, capo));
+            return;
+        }
+        bool placed = false;
+        for (size_t string = 0 ; string < tuning.size() ; ++string) {
+            const int fret = chord.notes[i].note.code() - tuning[string].code();
+            if (!used[string] && capo <= fret && fret < fretCount) {
+                used[string] = true;
+                current[i] = {static_cast<int>(string), fret};
+                explore(i + 1, dropped);
+                used[string] = false;
+                placed = true;
+            }
+        }
+        if (!placed) {
+            current[i] = {-1, 0};
+            explore(i + 1, dropped + 1);
+        }
+    };
+    explore(0, 0);
+    std::sort(candidates.begin(), candidates.end(), [](const auto& lhs, const auto& rhs) { return lhs.cost < rhs.cost; });
+    if (candidates.size() > maxCandidates)
+        candidates.resize(maxCandidates);
+    return candidates;
+}
+
+double transitionCost(const Candidate& from, const Candidate& to) {
+    if (from.position == -1 || to.position == -1)
+        return 0.;
+    return shiftCost * std::abs(from.position - to.position);
+}
+
+std::vector<Chord> makeChords(const TimedEvents& events) {
+    std::vector<Chord> chords;
+    for (const auto& item : events) {
+        if (chords.empty() || chords.back().timestamp != item.timestamp)
+            chords.push_back(Chord{item.timestamp, {}});
+        auto& notes = chords.back().notes;
+        const auto note = extraction_ns::get_note(item.event);
+        auto it = std::find_if(notes.begin(), notes.end(), [&](const auto& chordNote) { return chordNote.note.code() == note.code(); });
+        if (it == notes.end())
+            notes.push_back(ChordNote{note, item.event.channels()});
+        else
+            it->channels |= item.event.channels();
+    }
+    return chords;
+}
+
+}
+
+constexpr size_t GuitarFingering::maxSequences;
+
+GuitarFingering::Plan GuitarFingering::compute(const TimedEvents& events, const Tuning& tuning, size_t capo, size_t fretCount) {
+    TRACE_MEASURE("GuitarFingering::compute");
+    const auto chords = makeChords(events);
+    // viterbi over the candidates of each chord
+    std::vector<std::vector<Candidate>> layers;
+    std::vector<std::vector<double>> costs;
+    std::vector<std::vector<size_t>> parents;
+    layers.reserve(chords.size());
+    costs.reserve(chords.size());
+    parents.reserve(chords.size());
+    for (const auto& chord : chords) {
+        layers.push_back(makeCandidates(chord, tuning, static_cast<int>(capo), static_cast<int>(fretCount)));
+        const auto& layer = layers.back();
+        std::vector<double> layerCosts(layer.size());
+        std::vector<size_t> layerParents(layer.size(), 0);
+        for (size_t j = 0 ; j < layer.size() ; ++j) {
+            double best = 0.;
+            if (layers.size() > 1) {
+                const auto& previous = layers[layers.size() - 2];
+                const auto& previousCosts = costs.back();
+                best = std::numeric_limits<double>::max();
+                for (size_t i = 0 ; i < previous.size() ; ++i) {
+                    const auto cost = previousCosts[i] + transitionCost(previous[i], layer[j]);
+                    if (cost < best) {
+                        best = cost;
+                        layerParents[j] = i;
+                    }
+                }
+            }
+            layerCosts[j] = best + layer[j].cost;
+        }
+        costs.push_back(std::move(layerCosts));
+        parents.push_back(std::move(layerParents));
+    }
+    // backtrack the best path
+    Plan plan;
+    if (chords.empty())
+        return plan;
+    std::vector<size_t> path(chords.size());
+    path.back() = static_cast<size_t>(std::distance(costs.back().begin(), std::min_element(costs.back().begin(), costs.back().end())));
+    for (size_t k = chords.size() - 1 ; k > 0 ; --k)
+        path[k-1] = parents[k][path[k]];
+    for (size_t k = 0 ; k < chords.size() ; ++k) {
+        const auto& candidate = layers[k][path[k]];
+        for (size_t n = 0 ; n < chords[k].notes.size() ; ++n)
+            if (candidate.locations[n].first != -1)
+                plan.push_back(Entry{chords[k].timestamp, chords[k].notes[n].note, chords[k].notes[n].channels, candidate.locations[n]});
+    }
+    return plan;
+}
+
+GuitarFingering::Plans GuitarFingering::computeTracks(const Sequence& sequence, const Tuning& tuning, size_t capo, size_t fretCount) {
+    std::map<track_t, TimedEvents> tracks;
+    for (const auto& item : sequence)
+        if (item.event.is(family_t::note_on) && extraction_ns::velocity(item.event) != 0)
+            tracks[item.event.track()].push_back(item);
+    Plans plans;
+    for (const auto& track : tracks)
+        plans.emplace(track.first, compute(track.second, tuning, capo, fretCount));
+    return plans;
+}
+
+void GuitarFingering::setInstrument(const Tuning& tuning, size_t capo, size_t fretCount) {
+    mTuning = tuning;
+    mCapo = capo;
+    mFretCount = fretCount;
+    mPlans.clear();
+}
+
+GuitarFingering::Slot& GuitarFingering::slot(const std::shared_ptr<const Sequence>& sequence) {
+    auto it = mPlans.find(sequence);
+    if (it != mPlans.end())
+        return it->second;
+    // forget sequences released by their readers first, futures of a pool never block
+    if (mPlans.size() >= maxSequences) {
+        for (auto jt = mPlans.begin() ; jt != mPlans.end() ; )
+            jt = jt->first.expired() ? mPlans.erase(jt) : std::next(jt);
+        if (mPlans.size() >= maxSequences)
+            mPlans.clear();
+    }
+    // the task filters the events itself, the sequence is immutable and kept alive by the task
+    auto task = std::make_shared<std::packaged_task<Plans()>>([sequence, tuning = mTuning, capo = mCapo, fretCount = mFretCount] {
+        return computeTracks(*sequence, tuning, capo, fretCount);
+    });
+    auto& cached = mPlans[sequence];
+    cached.pending = task->get_future();
+    backgroundPool().submit([task] { (*task)(); });
+    return cached;
+}
+
+bool GuitarFingering::lookup(const SequenceReader& reader, track_t track, const Note& note, channels_t channels, Location& location) {
+    if (auto next = reader.next_sequence())
+        slot(next);
+    auto& cached = slot(reader.sequence());
+    if (cached.pending.valid()) {
+        if (cached.pending.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+            return false;
+        cached.plans = cached.pending.get();
+    }
+    auto it = cached.plans.find(track);
+    if (it == cached.plans.end())
+        return false;
+    const auto& plan = it->second;
+    // the note has just been emitted, look for the latest matching entry not after the current position
+    const auto position = reader.position() + 1.;
+    auto entry = std::upper_bound(plan.cbegin(), plan.cend(), position, [](timestamp_t timestamp, const Entry& e) {
+        return timestamp < e.timestamp;
+    });
+    for (size_t n = 0 ; entry != plan.cbegin() && n < 64 ; ++n) {
+        --entry;
+        if (entry->note.code() == note.code() && entry->channels.any(channels)) {
+            location = entry->location;
+            return true;
+        }
+    }
+    return false;
+}
+
 //========
 // Guitar
 //========
@@ -80,6 +306,7 @@ MetaHandler* makeMetaGuitar(QObject* parent) {
 }
 
 Guitar::Guitar() : Instrument{Mode::io()}, mTuning{defaultTuning}, mState{defaultTuning.size()}, mActiveLocation{defaultLocation} {
+    mFingering.setInstrument(mTuning, mCapo, fretCount);
     clearNotes();
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Minimum);
 }
@@ -106,6 +333,7 @@ void Guitar::setTuning(const Tuning& tuning) {
         mTuning = tuning;
         mState.resize(mTuning.size());
         mActiveLocation = defaultLocation;
+        mFingering.setInstrument(mTuning, mCapo, fretCount);
         clearNotes();
         update();
     }
@@ -119,6 +347,7 @@ void Guitar::setCapo(size_t capo) {
     if (capo < fretCount) {
         mCapo = capo;
         mActiveLocation = defaultLocation;
+        mFingering.setInstrument(mTuning, mCapo, fretCount);
         clearNotes();
         update();
     }
@@ -136,6 +365,17 @@ void Guitar::receiveNotesOff(channels_t channels) {
 
 void Guitar::receiveNoteOn(channels_t channels, const Note& note) {
 
+    // notes played by a reader use the fingering planned for the whole track
+    const auto& message = currentMessage();
+    if (auto* reader = dynamic_cast<const SequenceReader*>(message.source)) {
+        Location loc;
+        if (mFingering.lookup(*reader, message.event.track(), note, channels, loc) && isValid(loc) && !channel_ns::contains(mState[loc.first], channels)) {
+            activate(loc, channels);
+            return;
+        }
+    }
+
+    // greedy fallback for live input
     struct Candidate { int occupied; Location loc; };
 
     std::vector<Candidate> candidates;
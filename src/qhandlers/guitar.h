@@ -21,8 +21,68 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef QHANDLERS_GUITAR_H
 #define QHANDLERS_GUITAR_H
 
+#include <future>
+#include "handlers/sequencereader.h"
 #include "qhandlers/common.h"
 
+//=================
+// GuitarFingering
+//=================
+
+/**
+ * Fingering planned over a whole track of a sequence.
+ * Simultaneous notes are grouped in chords, each chord gets a set of candidate
+ * string assignments weighted by their hand span, and a Viterbi pass picks the
+ * sequence of candidates minimizing span and hand position shifts.
+ * Plans of all tracks are computed at once in the background pool and cached per sequence.
+ */
+
+class GuitarFingering {
+
+public:
+    using Tuning = std::vector<Note>;
+    using Location = std::pair<int, int>; /*!< string & fret */
+
+    struct Entry {
+        timestamp_t timestamp;
+        Note note;
+        channels_t channels;
+        Location location;
+    };
+
+    using Plan = std::vector<Entry>; /*!< sorted by timestamp */
+    using Plans = std::map<track_t, Plan>;
+
+    static constexpr size_t maxSequences = 8;
+
+    static Plan compute(const TimedEvents& events, const Tuning& tuning, size_t capo, size_t fretCount); /*!< events are the note-ons of a single track */
+    static Plans computeTracks(const Sequence& sequence, const Tuning& tuning, size_t capo, size_t fretCount);
+
+    void setInstrument(const Tuning& tuning, size_t capo, size_t fretCount); /*!< invalidates the cache */
+
+    /// looks up the location planned for a note emitted by the reader
+    /// returns false if the plan is not available yet, it will be computed asynchronously
+    /// the next sequence of the reader is planned as well so that it is ready once played
+    bool lookup(const SequenceReader& reader, track_t track, const Note& note, channels_t channels, Location& location);
+
+private:
+    struct Slot {
+        std::future<Plans> pending;
+        Plans plans;
+    };
+
+    /// sequences are compared by ownership, a weak reference keeps the identity from being reused
+    using Cache = std::map<std::weak_ptr<const Sequence>, Slot, std::owner_less<std::weak_ptr<const Sequence>>>;
+
+    Slot& slot(const std::shared_ptr<const Sequence>& sequence); /*!< starts planning the sequence if it is not cached */
+
+    Tuning mTuning;
+    size_t mCapo {0};
+    size_t mFretCount {0};
+    Cache mPlans;
+
+};
+
 //========
 // Guitar
 //========
@@ -90,6 +150,7 @@ private:
     size_t mCapo {0};
     State mState;
     Location mActiveLocation;
+    GuitarFingering mFingering;
 
 };
 
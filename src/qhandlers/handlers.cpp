@@ -33,6 +33,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "qhandlers/guitar.h"
 #include "qhandlers/system.h"
 #include "qhandlers/tickhandler.h"
+#include "qhandlers/loadgenerator.h"
 
 //=================
 // StandardFactory
@@ -63,7 +64,10 @@ StandardFactory::StandardFactory(QObject* parent) : QObject{parent}, MetaHandler
         makeMetaForwarder(this),
         makeMetaTickHandler(this),
         makeMetaChannelMapper(this),
-        makeMetaTrackFilter(this)
+        makeMetaTrackFilter(this),
+        // stress testing
+        makeMetaLoadGenerator(this),
+        makeMetaLoadProbe(this)
     };
 }
 
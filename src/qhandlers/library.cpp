@@ -0,0 +1,422 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <array>
+#include <atomic>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <QApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include "qhandlers/library.h"
+#include "qcore/core.h"
+#include "tools/trace.h"
+
+namespace {
+
+constexpr quint32 indexMagic = 0x4d4c4958; // "MLIX"
+constexpr quint32 indexVersion = 1;
+
+/// General MIDI instrument families, each of them covering 8 programs
+const std::array<const char*, 16> programFamilies = {
+    "piano", "chromatic percussion", "organ", "guitar", "bass", "strings", "ensemble", "brass",
+    "reed", "pipe", "synth lead", "synth pad", "synth effects", "ethnic", "percussive", "sound effects"
+};
+
+qint64 modifiedTime(const QFileInfo& fileInfo) {
+    return fileInfo.lastModified().toMSecsSinceEpoch();
+}
+
+bool parseDuration(const QString& text, double& seconds) {
+    bool ok = false;
+    const auto parts = text.split(':');
+    if (parts.size() == 1) {
+        seconds = parts[0].toDouble(&ok);
+    } else if (parts.size() == 2) {
+        bool minutesOk = false;
+        seconds = 60. * parts[0].toInt(&minutesOk) + parts[1].toDouble(&ok);
+        ok &= minutesOk;
+    }
+    return ok;
+}
+
+}
+
+//==============
+// LibraryEntry
+//==============
+
+LibraryEntry LibraryEntry::fromSummary(qint64 size, qint64 modified, const MidiFileSummary& summary) {
+    LibraryEntry entry;
+    entry.size = size;
+    entry.modified = modified;
+    entry.duration = summary.duration;
+    entry.tempo = summary.tempo;
+    entry.notes = static_cast<quint32>(summary.notes);
+    entry.tracks = static_cast<quint16>(summary.tracks);
+    entry.drums = summary.drums;
+    entry.programs = summary.programs;
+    for (const auto& name : summary.track_names)
+        entry.trackNames.append(QString::fromLocal8Bit(name.data(), static_cast<int>(name.size())));
+    return entry;
+}
+
+bool LibraryEntry::isValid() const {
+    return tracks != 0;
+}
+
+bool LibraryEntry::matches(const QFileInfo& fileInfo) const {
+    return size == fileInfo.size() && modified == modifiedTime(fileInfo);
+}
+
+QDataStream& operator<<(QDataStream& stream, const LibraryEntry& entry) {
+    const auto programs = entry.programs.to_string();
+    return stream << entry.size << entry.modified << entry.duration << entry.tempo << entry.notes << entry.tracks
+                  << entry.drums << QByteArray::fromStdString(programs) << entry.trackNames;
+}
+
+QDataStream& operator>>(QDataStream& stream, LibraryEntry& entry) {
+    QByteArray programs;
+    stream >> entry.size >> entry.modified >> entry.duration >> entry.tempo >> entry.notes >> entry.tracks
+           >> entry.drums >> programs >> entry.trackNames;
+    if (programs.size() == static_cast<int>(entry.programs.size()))
+        entry.programs = decltype(entry.programs){programs.toStdString()};
+    return stream;
+}
+
+//===============
+// LibraryFilter
+//===============
+
+bool LibraryFilter::Range::contains(double value) const {
+    return min <= value && value <= max;
+}
+
+LibraryFilter::LibraryFilter(const QString& query) {
+    static const QRegExp comparison{"(tempo|bpm|length)([<>=])(.+)"};
+    static const QRegExp program{"program:(\\d+)"};
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    for (const auto& term : query.toLower().split(' ', QString::SkipEmptyParts)) {
+        if (comparison.exactMatch(term)) {
+            const auto key = comparison.cap(1);
+            const auto op = comparison.cap(2);
+            double value = 0.;
+            bool ok = false;
+            if (key == "length")
+                ok = parseDuration(comparison.cap(3), value);
+            else
+                value = comparison.cap(3).toDouble(&ok);
+            if (!ok) {
+                mTexts.push_back(term);
+                continue;
+            }
+            const Range range = op == "<" ? Range{-inf, value} : op == ">" ? Range{value, inf} : Range{value - .5, value + .5};
+            (key == "length" ? mLengths : mTempos).push_back(range);
+            mNeedsEntry = true;
+        } else if (program.exactMatch(term) && program.cap(1).toInt() < 0x80) {
+            mPrograms.push_back(static_cast<byte_t>(program.cap(1).toInt()));
+            mNeedsEntry = true;
+        } else if (term == "drums") {
+            mDrums = true;
+            mNeedsEntry = true;
+        } else {
+            mTexts.push_back(term);
+        }
+    }
+}
+
+bool LibraryFilter::isEmpty() const {
+    return mTexts.empty() && !mNeedsEntry;
+}
+
+bool LibraryFilter::accepts(const QString& name, const LibraryEntry* entry) const {
+    if (mNeedsEntry && (!entry || !entry->isValid()))
+        return false;
+    for (const auto& range : mTempos)
+        if (!range.contains(entry->tempo))
+            return false;
+    for (const auto& range : mLengths)
+        if (!range.contains(entry->duration))
+            return false;
+    for (auto program : mPrograms)
+        if (!entry->programs.test(program))
+            return false;
+    if (mDrums && !entry->drums)
+        return false;
+    for (const auto& text : mTexts) {
+        bool found = name.contains(text, Qt::CaseInsensitive);
+        if (!found && entry) {
+            for (const auto& trackName : entry->trackNames)
+                if ((found = trackName.contains(text, Qt::CaseInsensitive)))
+                    break;
+            for (size_t family=0 ; !found && family < programFamilies.size() ; ++family)
+                for (size_t program=8*family ; !found && program < 8*family+8 ; ++program)
+                    found = entry->programs.test(program) && QString{programFamilies[family]}.contains(text);
+        }
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
+//==============
+// LibraryIndex
+//==============
+
+/// State shared with the background tasks, it outlives the index if some tasks are still running
+struct LibraryIndex::Crawler {
+
+    struct Job {
+        QString path;
+        qint64 size;
+        qint64 modified;
+    };
+
+    struct Listing {
+        quint64 token;
+        QString path;
+        bool recursive;
+    };
+
+    void push(Job job) {
+        std::lock_guard<std::mutex> guard{mutex};
+        jobs.push_back(std::move(job));
+        if (workers < maxWorkers && workers < jobs.size()) {
+            ++workers;
+            backgroundPool().submit([keepAlive=self.lock()] { keepAlive->run(); });
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock{mutex};
+        while (!jobs.empty() && !stopped) {
+            auto job = std::move(jobs.front());
+            jobs.pop_front();
+            lock.unlock();
+            auto entry = LibraryEntry::fromSummary(job.size, job.modified, dumping::scan_file(job.path.toLocal8Bit().constData()));
+            lock.lock();
+            results.emplace_back(std::move(job.path), std::move(entry));
+        }
+        --workers;
+    }
+
+    void push(Listing job) {
+        std::lock_guard<std::mutex> guard{mutex};
+        listings.push_back(std::move(job));
+        // a single task lists directories so that files are reported in order
+        if (!listing) {
+            listing = true;
+            backgroundPool().submit([keepAlive=self.lock()] { keepAlive->runListings(); });
+        }
+    }
+
+    void runListings() {
+        std::unique_lock<std::mutex> lock{mutex};
+        while (!listings.empty() && !stopped) {
+            auto job = std::move(listings.front());
+            listings.pop_front();
+            lock.unlock();
+            list(job.token, QDir{job.path}, job.recursive);
+            lock.lock();
+            found.emplace_back(job.token, QList<QFileInfo>{}); // an empty batch closes the listing
+        }
+        listing = false;
+    }
+
+    void list(quint64 token, const QDir& dir, bool recursive) {
+        static const auto nameFilters = QStringList{} << "*.mid" << "*.midi" << "*.kar";
+        auto files = dir.entryInfoList(nameFilters, QDir::Files);
+        // fill the status cache here rather than on the GUI thread
+        for (const auto& info : files) {
+            info.size();
+            info.lastModified();
+        }
+        if (!files.empty()) {
+            std::lock_guard<std::mutex> guard{mutex};
+            found.emplace_back(token, std::move(files));
+        }
+        if (recursive)
+            for (const auto& info : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot))
+                if (!stopped)
+                    list(token, QDir{info.filePath()}, true);
+    }
+
+    bool isIdle() {
+        std::lock_guard<std::mutex> guard{mutex};
+        return workers == 0 && results.empty() && !listing && found.empty();
+    }
+
+    std::vector<std::pair<quint64, QList<QFileInfo>>> takeFound() {
+        decltype(found) taken;
+        std::lock_guard<std::mutex> guard{mutex};
+        taken.swap(found);
+        return taken;
+    }
+
+    std::vector<std::pair<QString, LibraryEntry>> takeResults() {
+        decltype(results) taken;
+        std::lock_guard<std::mutex> guard{mutex};
+        taken.swap(results);
+        return taken;
+    }
+
+    std::weak_ptr<Crawler> self;
+    std::mutex mutex;
+    std::deque<Job> jobs;
+    std::vector<std::pair<QString, LibraryEntry>> results;
+    std::deque<Listing> listings;
+    std::vector<std::pair<quint64, QList<QFileInfo>>> found; /*!< files listed per directory */
+    bool listing {false};
+    size_t workers {0};
+    size_t maxWorkers {std::max<size_t>(1, backgroundPool().size() / 2)}; /*!< leave room for the other editors */
+    std::atomic_bool stopped {false};
+
+};
+
+LibraryIndex* LibraryIndex::instance() {
+    static auto* index = new LibraryIndex{QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/library.idx", qApp};
+    return index;
+}
+
+LibraryIndex::LibraryIndex(QString filename, QObject* parent) : QObject{parent}, mFilename{std::move(filename)} {
+    mCrawler = std::make_shared<Crawler>();
+    mCrawler->self = mCrawler;
+    mCollectTimer = new QTimer{this};
+    mCollectTimer->setInterval(100);
+    connect(mCollectTimer, &QTimer::timeout, this, &LibraryIndex::collect);
+    connect(qApp, &QApplication::aboutToQuit, this, &LibraryIndex::save);
+    // the background pool is joined with the application, remaining jobs are abandoned
+    connect(qApp, &QApplication::aboutToQuit, this, [this] { mCrawler->stopped = true; });
+    load();
+}
+
+LibraryIndex::~LibraryIndex() {
+    mCrawler->stopped = true;
+}
+
+const LibraryEntry* LibraryIndex::find(const QFileInfo& fileInfo) const {
+    auto it = mEntries.constFind(fileInfo.absoluteFilePath());
+    if (it != mEntries.constEnd() && it->matches(fileInfo))
+        return &*it;
+    return nullptr;
+}
+
+const LibraryEntry* LibraryIndex::request(const QFileInfo& fileInfo) {
+    if (auto* entry = find(fileInfo))
+        return entry;
+    // the placeholder prevents scanning the same file twice
+    const auto path = fileInfo.absoluteFilePath();
+    auto& placeholder = mEntries[path];
+    if (placeholder.size != -2) {
+        placeholder = LibraryEntry{};
+        placeholder.size = -2;
+        mCrawler->push({path, fileInfo.size(), modifiedTime(fileInfo)});
+        mCollectTimer->start();
+    }
+    return nullptr;
+}
+
+quint64 LibraryIndex::list(const QString& path, bool recursive) {
+    const auto token = ++mLastToken;
+    mCrawler->push(Crawler::Listing{token, path, recursive});
+    mCollectTimer->start();
+    return token;
+}
+
+void LibraryIndex::load() {
+    QFile file{mFilename};
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    QDataStream stream{&file};
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != indexMagic || version != indexVersion) {
+        TRACE_WARNING("ignoring library index " << mFilename << ": unknown format");
+        return;
+    }
+    stream >> mEntries;
+    if (stream.status() != QDataStream::Ok) {
+        TRACE_WARNING("ignoring library index " << mFilename << ": corrupted data");
+        mEntries.clear();
+    }
+    TRACE_DEBUG("library index loaded: " << mEntries.size() << " entries");
+}
+
+void LibraryIndex::save() {
+    if (!mDirty)
+        return;
+    QDir{}.mkpath(QFileInfo{mFilename}.absolutePath());
+    QSaveFile file{mFilename};
+    if (!file.open(QIODevice::WriteOnly)) {
+        TRACE_WARNING("can't save library index " << mFilename);
+        return;
+    }
+    // pending placeholders are not worth saving
+    QHash<QString, LibraryEntry> entries;
+    entries.reserve(mEntries.size());
+    for (auto it = mEntries.constBegin() ; it != mEntries.constEnd() ; ++it)
+        if (it->size >= 0)
+            entries.insert(it.key(), it.value());
+    QDataStream stream{&file};
+    stream << indexMagic << indexVersion << entries;
+    if (file.commit())
+        mDirty = false;
+}
+
+void LibraryIndex::collect() {
+    // files found first, requesting them may schedule scans
+    auto found = mCrawler->takeFound();
+    for (auto it = found.begin() ; it != found.end() ; ) {
+        // merge consecutive directories of the same listing
+        const auto token = it->first;
+        QList<QFileInfo> files;
+        bool listed = false;
+        for ( ; it != found.end() && it->first == token ; ++it) {
+            if (it->second.empty())
+                listed = true;
+            else
+                files.append(it->second);
+        }
+        if (!files.empty())
+            emit filesFound(token, files);
+        if (listed)
+            emit filesListed(token);
+    }
+    auto results = mCrawler->takeResults();
+    if (!results.empty()) {
+        QStringList paths;
+        paths.reserve(static_cast<int>(results.size()));
+        for (auto& result : results) {
+            paths.append(result.first);
+            mEntries[result.first] = std::move(result.second);
+        }
+        mDirty = true;
+        emit entriesUpdated(paths);
+    }
+    if (mCrawler->isIdle()) {
+        mCollectTimer->stop();
+        save();
+    }
+}
@@ -0,0 +1,149 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef QHANDLERS_LIBRARY_H
+#define QHANDLERS_LIBRARY_H
+
+#include <memory>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QHash>
+#include <QStringList>
+#include <QTimer>
+#include "core/sequence.h"
+
+//==============
+// LibraryEntry
+//==============
+
+/// Metadata of a midi file as stored in the index
+/// The entry is only relevant while the file keeps the same size and modification time
+
+struct LibraryEntry {
+
+    static LibraryEntry fromSummary(qint64 size, qint64 modified, const MidiFileSummary& summary);
+
+    bool isValid() const; /*!< false if the file could not be parsed */
+    bool matches(const QFileInfo& fileInfo) const;
+
+    qint64 size {-1};
+    qint64 modified {0}; /*!< msecs since epoch */
+    double duration {0.}; /*!< in seconds */
+    double tempo {0.}; /*!< initial tempo in bpm */
+    quint32 notes {0};
+    quint16 tracks {0};
+    bool drums {false};
+    std::bitset<0x80> programs;
+    QStringList trackNames;
+
+};
+
+QDataStream& operator<<(QDataStream& stream, const LibraryEntry& entry);
+QDataStream& operator>>(QDataStream& stream, LibraryEntry& entry);
+
+//===============
+// LibraryFilter
+//===============
+
+/**
+ * Filter parsed from a query of whitespace-separated terms, all of them must match:
+ * @li tempo<N, tempo>N, tempo=N compare the initial tempo in bpm
+ * @li length<T, length>T compare the duration given in seconds or as m:ss
+ * @li program:N checks if the program is used, drums checks the percussion channel
+ * @li any other term is searched in the filename, the track names and the instrument families
+ *
+ * Metadata terms reject files that are not indexed yet
+ */
+
+class LibraryFilter {
+
+public:
+    explicit LibraryFilter(const QString& query = {});
+
+    bool isEmpty() const;
+    bool accepts(const QString& name, const LibraryEntry* entry) const;
+
+private:
+    struct Range {
+        double min;
+        double max;
+        bool contains(double value) const;
+    };
+
+    std::vector<QString> mTexts;
+    std::vector<Range> mTempos;
+    std::vector<Range> mLengths;
+    std::vector<byte_t> mPrograms;
+    bool mDrums {false};
+    bool mNeedsEntry {false};
+
+};
+
+//==============
+// LibraryIndex
+//==============
+
+/**
+ * Persistent index of midi files metadata keyed by absolute path.
+ * Unknown or outdated files are scanned by tasks of the background pool,
+ * results are merged on the GUI thread and the index is saved once the crawl is over.
+ *
+ * Directories are listed by a background task as well, files found are reported
+ * in batches to the requester, their QFileInfo already holding the file status.
+ */
+
+class LibraryIndex : public QObject {
+
+    Q_OBJECT
+
+public:
+    static LibraryIndex* instance(); /*!< shared by all players, lives as long as the application */
+
+    explicit LibraryIndex(QString filename, QObject* parent);
+    ~LibraryIndex();
+
+    const LibraryEntry* find(const QFileInfo& fileInfo) const; /*!< nullptr if the file is unknown or has changed */
+    const LibraryEntry* request(const QFileInfo& fileInfo); /*!< same as find but schedules a scan on failure */
+    quint64 list(const QString& path, bool recursive); /*!< schedules the listing of midi files in path, returns the token given to filesFound */
+
+    void load();
+    void save();
+
+signals:
+    void entriesUpdated(const QStringList& paths);
+    void filesFound(quint64 token, const QList<QFileInfo>& files);
+    void filesListed(quint64 token); /*!< the listing is over, emitted after its last filesFound */
+
+private slots:
+    void collect();
+
+private:
+    struct Crawler;
+
+    QString mFilename;
+    QHash<QString, LibraryEntry> mEntries;
+    std::shared_ptr<Crawler> mCrawler;
+    QTimer* mCollectTimer;
+    bool mDirty {false};
+    quint64 mLastToken {0};
+
+};
+
+#endif // QHANDLERS_LIBRARY_H
@@ -0,0 +1,188 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <QFormLayout>
+#include <QPushButton>
+#include "qhandlers/loadgenerator.h"
+#include "qtools/misc.h"
+
+namespace {
+
+constexpr auto defaultFamilies = families_t::fuse(family_t::note_on, family_t::controller);
+
+}
+
+//=====================
+// LoadGeneratorEditor
+//=====================
+
+MetaHandler* makeMetaLoadGenerator(QObject* parent) {
+    auto* meta = new MetaHandler{parent};
+    meta->setIdentifier("LoadGenerator");
+    meta->setDescription("Produces a configurable stream of events for stress testing, to be paired with a LoadProbe");
+    meta->addParameter({"rate", "average number of events per second", "1000", MetaHandler::MetaParameter::Visibility::basic});
+    meta->addParameter({"burst", "number of events emitted together", "1", MetaHandler::MetaParameter::Visibility::basic});
+    meta->addParameter({"poisson", "use random intervals between bursts", "false", MetaHandler::MetaParameter::Visibility::basic});
+    meta->addParameter({"seed", "seed of the random intervals", "0", MetaHandler::MetaParameter::Visibility::advanced});
+    meta->addParameter({"sysex_size", "size of generated sysex events", "16", MetaHandler::MetaParameter::Visibility::advanced});
+    meta->addParameter({"families", "bitmask of generated families", serial::serializeFamilies(defaultFamilies), MetaHandler::MetaParameter::Visibility::advanced});
+    meta->addParameter({"channels", "bitmask of channels used in turn", serial::serializeChannels(channels_t::melodic()), MetaHandler::MetaParameter::Visibility::advanced});
+    meta->setFactory(new OpenProxyFactory<LoadGeneratorEditor>);
+    return meta;
+}
+
+LoadGeneratorEditor::LoadGeneratorEditor() : HandlerEditor{} {
+
+    mRateBox = new QDoubleSpinBox{this};
+    mRateBox->setRange(.1, 1e6);
+    mRateBox->setDecimals(1);
+    mRateBox->setSuffix(" /s");
+    mRateBox->setValue(1000.);
+    connect(mRateBox, static_cast<void (QDoubleSpinBox::*)(double)>(&QDoubleSpinBox::valueChanged), this, [this](double value) { mHandler.send_message(LoadGenerator::rate_ext(value)); });
+
+    mBurstBox = new QSpinBox{this};
+    mBurstBox->setRange(1, 10000);
+    connect(mBurstBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, [this](int value) { mHandler.send_message(LoadGenerator::burst_ext(static_cast<size_t>(value))); });
+
+    mSysexSizeBox = new QSpinBox{this};
+    mSysexSizeBox->setRange(3, 0x10000);
+    mSysexSizeBox->setValue(16);
+    connect(mSysexSizeBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, [this](int value) { mHandler.send_message(LoadGenerator::sysex_size_ext(static_cast<size_t>(value))); });
+
+    mPoissonBox = new QCheckBox{"Poisson", this};
+    connect(mPoissonBox, &QCheckBox::toggled, this, [this](bool value) { mHandler.send_message(LoadGenerator::poisson_ext(value)); });
+
+    mSeedBox = new QSpinBox{this};
+    mSeedBox->setRange(0, std::numeric_limits<int>::max());
+    connect(mSeedBox, static_cast<void (QSpinBox::*)(int)>(&QSpinBox::valueChanged), this, [this](int value) { mHandler.send_message(LoadGenerator::seed_ext(static_cast<unsigned int>(value))); });
+
+    mChannelsSelector = new ChannelsSelector{this};
+    mChannelsSelector->setChannels(channels_t::melodic());
+    connect(mChannelsSelector, &ChannelsSelector::channelsChanged, this, [this](channels_t channels) { mHandler.send_message(LoadGenerator::channels_ext(channels)); });
+
+    mFamilySelector = new FamilySelector{this};
+    mFamilySelector->setWindowFlags(Qt::Dialog);
+    mFamilySelector->setVisible(false);
+    mFamilySelector->setFamilies(defaultFamilies);
+    connect(mFamilySelector, &FamilySelector::familiesChanged, this, [this](families_t families) { mHandler.send_message(LoadGenerator::families_ext(families)); });
+
+    auto* selectFamilyButton = new QPushButton{tr("Filter"), this};
+    connect(selectFamilyButton, &QPushButton::clicked, this, &LoadGeneratorEditor::onFilterClick);
+
+    mEmittedLabel = new QLabel{this};
+
+    auto* form = new QFormLayout;
+    form->setMargin(0);
+    form->addRow("Rate", make_hbox(margin_tag{0}, mRateBox, mPoissonBox));
+    form->addRow("Burst", mBurstBox);
+    form->addRow("Seed", mSeedBox);
+    form->addRow("Sysex Size", mSysexSizeBox);
+    form->addRow("Families", selectFamilyButton);
+    form->addRow("Channels", mChannelsSelector);
+    form->addRow("Emitted", mEmittedLabel);
+    setLayout(form);
+
+    startTimer(500); // 2 Hz
+}
+
+HandlerView::Parameters LoadGeneratorEditor::getParameters() const {
+    auto result = HandlerEditor::getParameters();
+    SERIALIZE("rate", serial::serializeNumber, mRateBox->value(), result);
+    SERIALIZE("burst", serial::serializeNumber, mBurstBox->value(), result);
+    SERIALIZE("poisson", serial::serializeBool, mPoissonBox->isChecked(), result);
+    SERIALIZE("seed", serial::serializeNumber, mSeedBox->value(), result);
+    SERIALIZE("sysex_size", serial::serializeNumber, mSysexSizeBox->value(), result);
+    SERIALIZE("families", serial::serializeFamilies, mFamilySelector->families(), result);
+    SERIALIZE("channels", serial::serializeChannels, mChannelsSelector->channels(), result);
+    return result;
+}
+
+size_t LoadGeneratorEditor::setParameter(const Parameter& parameter) {
+    UNSERIALIZE("rate", serial::parseDouble, mRateBox->setValue, parameter);
+    UNSERIALIZE("burst", serial::parseInt, mBurstBox->setValue, parameter);
+    UNSERIALIZE("poisson", serial::parseBool, mPoissonBox->setChecked, parameter);
+    UNSERIALIZE("seed", serial::parseInt, mSeedBox->setValue, parameter);
+    UNSERIALIZE("sysex_size", serial::parseInt, mSysexSizeBox->setValue, parameter);
+    UNSERIALIZE("families", serial::parseFamilies, mFamilySelector->setFamilies, parameter);
+    UNSERIALIZE("channels", serial::parseChannels, mChannelsSelector->setChannels, parameter);
+    return HandlerEditor::setParameter(parameter);
+}
+
+Handler* LoadGeneratorEditor::getHandler() {
+    return &mHandler;
+}
+
+void LoadGeneratorEditor::updateContext(Context* context) {
+    mChannelsSelector->setChannelEditor(context->channelEditor());
+}
+
+void LoadGeneratorEditor::timerEvent(QTimerEvent*) {
+    mEmittedLabel->setText(QString::number(mHandler.emitted()));
+}
+
+void LoadGeneratorEditor::onFilterClick() {
+    mFamilySelector->setVisible(!mFamilySelector->isVisible());
+}
+
+//=================
+// LoadProbeEditor
+//=================
+
+MetaHandler* makeMetaLoadProbe(QObject* parent) {
+    auto* meta = new MetaHandler{parent};
+    meta->setIdentifier("LoadProbe");
+    meta->setDescription("Measures latency and losses of events produced by a LoadGenerator");
+    meta->setFactory(new OpenProxyFactory<LoadProbeEditor>);
+    return meta;
+}
+
+LoadProbeEditor::LoadProbeEditor() : HandlerEditor{} {
+
+    mLabel = new QLabel{this};
+    mLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+    auto* resetButton = new QPushButton{tr("Reset"), this};
+    connect(resetButton, &QPushButton::clicked, this, [this] { mHandler.send_message(LoadProbe::reset_ext()); });
+
+    setLayout(make_vbox(margin_tag{0}, mLabel, make_hbox(stretch_tag{}, resetButton)));
+
+    startTimer(500); // 2 Hz
+}
+
+Handler* LoadProbeEditor::getHandler() {
+    return &mHandler;
+}
+
+void LoadProbeEditor::timerEvent(QTimerEvent*) {
+    const auto statistics = mHandler.statistics();
+    const bool measured = statistics.measured != 0;
+    mLabel->setText(QString{
+        "received: %1 (%2 /s)\n"
+        "lost: %3, unordered: %4\n"
+        "latency (us): min %5, avg %6, max %7\n"
+        "hops: %8"
+    }
+        .arg(statistics.received).arg(statistics.rate(), 0, 'f', 1)
+        .arg(statistics.lost).arg(statistics.unordered)
+        .arg(measured ? statistics.min_latency.count() : 0., 0, 'f', 1)
+        .arg(statistics.latency.average().count(), 0, 'f', 1)
+        .arg(statistics.max_latency.count(), 0, 'f', 1)
+        .arg(statistics.hops.average(), 0, 'f', 2));
+}
@@ -0,0 +1,91 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef QHANDLERS_LOAD_GENERATOR_H
+#define QHANDLERS_LOAD_GENERATOR_H
+
+#include <QSpinBox>
+#include <QDoubleSpinBox>
+#include "handlers/loadgenerator.h"
+#include "qhandlers/common.h"
+
+//=====================
+// LoadGeneratorEditor
+//=====================
+
+MetaHandler* makeMetaLoadGenerator(QObject* parent);
+
+class LoadGeneratorEditor : public HandlerEditor {
+
+    Q_OBJECT
+
+public:
+    explicit LoadGeneratorEditor();
+
+    Parameters getParameters() const override;
+    size_t setParameter(const Parameter& parameter) override;
+
+    Handler* getHandler() override;
+
+protected:
+    void updateContext(Context* context) override;
+    void timerEvent(QTimerEvent* event) override;
+
+private slots:
+    void onFilterClick();
+
+private:
+    LoadGenerator mHandler;
+    QDoubleSpinBox* mRateBox;
+    QSpinBox* mBurstBox;
+    QSpinBox* mSysexSizeBox;
+    QCheckBox* mPoissonBox;
+    QSpinBox* mSeedBox;
+    ChannelsSelector* mChannelsSelector;
+    FamilySelector* mFamilySelector;
+    QLabel* mEmittedLabel;
+
+};
+
+//=================
+// LoadProbeEditor
+//=================
+
+MetaHandler* makeMetaLoadProbe(QObject* parent);
+
+class LoadProbeEditor : public HandlerEditor {
+
+    Q_OBJECT
+
+public:
+    explicit LoadProbeEditor();
+
+    Handler* getHandler() override;
+
+protected:
+    void timerEvent(QTimerEvent* event) override;
+
+private:
+    LoadProbe mHandler;
+    QLabel* mLabel;
+
+};
+
+#endif // QHANDLERS_LOAD_GENERATOR_H
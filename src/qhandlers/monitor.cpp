@@ -19,6 +19,11 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include <QPushButton>
+#include <QHeaderView>
+#include <QScrollBar>
+#include <QMessageBox>
+#include <QTextStream>
+#include <QFile>
 #include "qhandlers/monitor.h"
 #include "qtools/misc.h"
 
@@ -28,14 +33,155 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 namespace {
 
-auto specialText(const QString& text) {
-    return QString{"<span style=\"background-color : black;color : white\">%1</span>"}.arg(text);
+auto escapedText(QString text) {
+    /// @todo replace all other non printable characters by a hex code (use a dedicated algorithm)
+    text.replace("\n", "\\n");
+    text.replace("\r", "\\r");
+    text.replace("\t", "\\t");
+    return text;
 }
 
+enum Column {
+    timeColumn,
+    eventColumn,
+    channelsColumn,
+    descriptionColumn,
+    columnCount
+};
+
 constexpr auto defaultFamilies = families_t::standard() & ~families_t::wrap(family_t::active_sense);
 
 }
 
+//==============
+// MonitorModel
+//==============
+
+constexpr int MonitorModel::defaultCapacity;
+
+MonitorModel::MonitorModel(QObject* parent) : QAbstractTableModel{parent} {
+    mRows.reserve(mCapacity);
+}
+
+int MonitorModel::capacity() const {
+    return static_cast<int>(mCapacity);
+}
+
+void MonitorModel::setCapacity(int capacity) {
+    beginResetModel();
+    mCapacity = static_cast<size_t>(std::max(capacity, 1));
+    mRows.clear();
+    mRows.shrink_to_fit();
+    mRows.reserve(mCapacity);
+    mStaging.clear();
+    mFirst = 0;
+    mCount = 0;
+    endResetModel();
+}
+
+const MonitorModel::Row& MonitorModel::row(int index) const {
+    return mRows[(mFirst + static_cast<size_t>(index)) % mRows.size()];
+}
+
+void MonitorModel::append(Event event, qint64 time) {
+    // staged rows are bounded by the capacity, a burst larger than that is committed early
+    if (mStaging.size() == mCapacity)
+        commit();
+    mStaging.push_back(Row{std::move(event), time});
+}
+
+void MonitorModel::commit() {
+    if (mStaging.empty())
+        return;
+    const auto staged = static_cast<int>(mStaging.size());
+    const auto capacity = static_cast<int>(mCapacity);
+    const auto overflow = std::max(0, mCount + staged - capacity);
+    if (overflow >= mCount && mCount != 0) {
+        // every visible row is replaced
+        beginResetModel();
+        for (auto& row : mStaging) {
+            if (mRows.size() < mCapacity) {
+                mRows.push_back(std::move(row));
+            } else {
+                mRows[mFirst] = std::move(row);
+                mFirst = (mFirst + 1) % mCapacity;
+            }
+        }
+        mCount = static_cast<int>(mRows.size());
+        mStaging.clear();
+        endResetModel();
+        return;
+    }
+    if (overflow != 0) {
+        beginRemoveRows({}, 0, overflow - 1);
+        mCount -= overflow;
+        endRemoveRows();
+    }
+    beginInsertRows({}, mCount, mCount + staged - 1);
+    for (auto& row : mStaging) {
+        if (mRows.size() < mCapacity) {
+            mRows.push_back(std::move(row));
+        } else {
+            mRows[mFirst] = std::move(row);
+            mFirst = (mFirst + 1) % mCapacity;
+        }
+    }
+    mCount += staged;
+    mStaging.clear();
+    endInsertRows();
+}
+
+void MonitorModel::clear() {
+    beginResetModel();
+    mRows.clear();
+    mStaging.clear();
+    mFirst = 0;
+    mCount = 0;
+    endResetModel();
+}
+
+QString MonitorModel::formatRow(const Row& row, const QString& separator) {
+    QStringList fields;
+    fields << QString::number(row.time);
+    fields << eventName(row.event);
+    fields << QString::fromStdString(channel_ns::channels_string(row.event.channels()));
+    fields << escapedText(QString::fromStdString(row.event.description()));
+    return fields.join(separator);
+}
+
+int MonitorModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : mCount;
+}
+
+int MonitorModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : Column::columnCount;
+}
+
+QVariant MonitorModel::data(const QModelIndex& index, int role) const {
+    if (role != Qt::DisplayRole || !index.isValid())
+        return {};
+    const auto& item = row(index.row());
+    switch (index.column()) {
+    case timeColumn: return QString::number(item.time);
+    case eventColumn: return eventName(item.event);
+    case channelsColumn: return item.event.channels() ? QString::fromStdString(channel_ns::channels_string(item.event.channels())) : QString{};
+    case descriptionColumn: return escapedText(QString::fromStdString(item.event.description()));
+    }
+    return {};
+}
+
+QVariant MonitorModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal)
+        return {};
+    switch (section) {
+    case timeColumn: return tr("Time (ms)");
+    case eventColumn: return tr("Event");
+    case channelsColumn: return tr("Channels");
+    case descriptionColumn: return tr("Description");
+    }
+    return {};
+}
+
 //=========
 // Monitor
 //=========
@@ -45,6 +191,8 @@ MetaHandler* makeMetaMonitor(QObject* parent) {
     meta->setIdentifier("Monitor");
     meta->setDescription("Basic handler displaying all incoming events");
     meta->addParameter({"families", "bitmask of selected families", serial::serializeFamilies(defaultFamilies), MetaHandler::MetaParameter::Visibility::advanced});
+    meta->addParameter({"capacity", "maximum number of events displayed", serial::serializeNumber(MonitorModel::defaultCapacity), MetaHandler::MetaParameter::Visibility::advanced});
+    meta->addParameter({"paused", "stop recording incoming events", serial::serializeBool(false), MetaHandler::MetaParameter::Visibility::basic});
     meta->setFactory(new OpenProxyFactory<Monitor>);
     return meta;
 }
@@ -56,17 +204,33 @@ Monitor::Monitor() : EditableHandler{Mode::out()} {
     mFamilySelector->setWindowFlags(Qt::Dialog);
     mFamilySelector->setVisible(false);
 
-    mEditor = new QTextEdit{this};
-    mEditor->setReadOnly(true);
-    mEditor->setAcceptRichText(true);
+    mModel = new MonitorModel{this};
+
+    mView = new QTableView{this};
+    mView->setModel(mModel);
+    mView->setSelectionMode(QAbstractItemView::ContiguousSelection);
+    mView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    mView->setWordWrap(false);
+    mView->verticalHeader()->setVisible(false);
+    mView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed); // uniform rows, no per-row measurement
+    mView->horizontalHeader()->setSectionResizeMode(QHeaderView::Interactive);
+    mView->horizontalHeader()->setStretchLastSection(true);
+
+    mPauseBox = new QCheckBox{tr("Pause"), this};
 
     auto* clearButton = new QPushButton(tr("Clear"), this);
-    connect(clearButton, &QPushButton::clicked, mEditor, &QTextEdit::clear);
+    connect(clearButton, &QPushButton::clicked, this, &Monitor::onClearClick);
+
+    auto* exportButton = new QPushButton(tr("Export"), this);
+    connect(exportButton, &QPushButton::clicked, this, &Monitor::onExportClick);
 
     auto* selectFamilyButton = new QPushButton(tr("Filter"), this);
     connect(selectFamilyButton, &QPushButton::clicked, this, &Monitor::onFilterClick);
 
-    setLayout(make_vbox(margin_tag{0}, mEditor, make_hbox(stretch_tag{}, clearButton, selectFamilyButton)));
+    setLayout(make_vbox(margin_tag{0}, mView, make_hbox(mPauseBox, stretch_tag{}, clearButton, exportButton, selectFamilyButton)));
+
+    mElapsed.start();
+    startTimer(100); // 10 Hz
 
 }
 
@@ -77,39 +241,54 @@ void Monitor::setFamilies(families_t families) {
 HandlerView::Parameters Monitor::getParameters() const {
     auto result = EditableHandler::getParameters();
     SERIALIZE("families", serial::serializeFamilies, mFamilySelector->families(), result);
+    SERIALIZE("capacity", serial::serializeNumber, mModel->capacity(), result);
+    SERIALIZE("paused", serial::serializeBool, mPauseBox->isChecked(), result);
     return result;
 }
 
 size_t Monitor::setParameter(const Parameter& parameter) {
     UNSERIALIZE("families", serial::parseFamilies, mFamilySelector->setFamilies, parameter);
+    UNSERIALIZE("capacity", serial::parseInt, mModel->setCapacity, parameter);
+    UNSERIALIZE("paused", serial::parseBool, mPauseBox->setChecked, parameter);
     return EditableHandler::setParameter(parameter);
 }
 
 Handler::Result Monitor::handle_message(const Message& message) {
-
     if (!message.event.is(mFamilySelector->families()))
         return Result::unhandled;
-
-    auto name = eventName(message.event);
-    name += " ";
-
-    if (auto channels = message.event.channels())
-        name += QString{"[%1] "}.arg(QString::fromStdString(channel_ns::channels_string(channels)));
-    name = name.leftJustified(20, '.');
-    name += "&nbsp;";
-    name = QString{"<span style=\"font-weight:bold;\">%1</span>"}.arg(name);
-
-    auto description = QString::fromStdString(message.event.description());
-    /// @todo replace all other non printable characters by a hex code (use a dedicated algorithm)
-    description.replace("\n", specialText("\\n"));
-    description.replace("\r", specialText("\\r"));
-    description.replace("\t", specialText("\\t"));
-
-    mEditor->append(name + description);
-
+    if (mPauseBox->isChecked())
+        return Result::unhandled;
+    mModel->append(message.event, mElapsed.elapsed());
     return Result::success;
 }
 
+void Monitor::timerEvent(QTimerEvent*) {
+    auto* scrollBar = mView->verticalScrollBar();
+    const bool following = scrollBar->value() == scrollBar->maximum();
+    mModel->commit();
+    if (following)
+        mView->scrollToBottom();
+}
+
 void Monitor::onFilterClick() {
     mFamilySelector->setVisible(!mFamilySelector->isVisible());
 }
+
+void Monitor::onClearClick() {
+    mModel->clear();
+}
+
+void Monitor::onExportClick() {
+    mModel->commit();
+    const auto fileName = context()->pathRetrieverPool()->get("log")->getWriteFile(this);
+    if (fileName.isNull())
+        return;
+    QFile file{fileName};
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QMessageBox::critical(this, {}, tr("Unable to write file %1").arg(fileName));
+        return;
+    }
+    QTextStream stream{&file};
+    for (int i = 0 ; i < mModel->rowCount() ; ++i)
+        stream << MonitorModel::formatRow(mModel->row(i), "\t") << '\n';
+}
@@ -21,9 +21,57 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef QHANDLERS_MONITOR_H
 #define QHANDLERS_MONITOR_H
 
-#include <QTextEdit>
+#include <QAbstractTableModel>
+#include <QElapsedTimer>
+#include <QTableView>
+#include <QCheckBox>
 #include "qhandlers/common.h"
 
+//==============
+// MonitorModel
+//==============
+
+/// Fixed-capacity ring of raw events, rows are only formatted when the view asks for them
+/// Incoming events are staged and committed to the model at a bounded rate
+
+class MonitorModel : public QAbstractTableModel {
+
+    Q_OBJECT
+
+public:
+    static constexpr int defaultCapacity = 10000;
+
+    struct Row {
+        Event event;
+        qint64 time; /*!< reception time in ms */
+    };
+
+    explicit MonitorModel(QObject* parent);
+
+    int capacity() const;
+    void setCapacity(int capacity); /*!< clears the model */
+
+    const Row& row(int index) const; /*!< index 0 is the oldest event */
+    void append(Event event, qint64 time);
+    void commit(); /*!< notifies views of staged rows */
+    void clear();
+
+    static QString formatRow(const Row& row, const QString& separator);
+
+    int rowCount(const QModelIndex& parent = {}) const override;
+    int columnCount(const QModelIndex& parent = {}) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+    std::vector<Row> mRows; /*!< ring buffer */
+    size_t mCapacity {defaultCapacity};
+    size_t mFirst {0}; /*!< index of the oldest row */
+    int mCount {0}; /*!< number of rows known by views */
+    std::vector<Row> mStaging; /*!< rows received since last commit */
+
+};
+
 //=========
 // Monitor
 //=========
@@ -44,13 +92,19 @@ public:
 
 protected:
     Result handle_message(const Message& message) override;
+    void timerEvent(QTimerEvent* event) override;
 
 protected slots:
     void onFilterClick();
+    void onClearClick();
+    void onExportClick();
 
 private:
-    QTextEdit* mEditor;
+    MonitorModel* mModel;
+    QTableView* mView;
+    QCheckBox* mPauseBox;
     FamilySelector* mFamilySelector;
+    QElapsedTimer mElapsed;
 
 };
 
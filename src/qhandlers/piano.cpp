@@ -18,60 +18,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include <QGuiApplication>
 #include <QHelpEvent>
+#include <QScreen>
 #include <QToolTip>
 #include "qhandlers/piano.h"
 
-//==========
-// PianoKey
-//==========
-
-PianoKey::PianoKey(const Note& note, Piano* parent) : QWidget{parent}, mNote{note}, mParent{parent} {
-    setToolTip(QString::fromStdString(note.string()));
-}
-
-void PianoKey::setChannels(channels_t channels) {
-    if (mChannels != channels) {
-        mChannels = channels;
-        update();
-    }
-}
-
-void PianoKey::activate(channels_t channels) {
-    setChannels(mChannels | channels);
-}
-
-void PianoKey::deactivate(channels_t channels) {
-    setChannels(mChannels & ~channels);
-}
-
-const Note& PianoKey::note() const {
-    return mNote;
-}
-
-bool PianoKey::isBlack() const {
-    return mNote.is_black();
-}
-
-void PianoKey::paintEvent(QPaintEvent*) {
-    static const QColor borderColor{"#444"};
-    QPainter painter{this};
-    painter.setPen(borderColor);
-    painter.setRenderHint(QPainter::Antialiasing);
-    // coloration
-    auto* editor = mParent->channelEditor();
-    if (mChannels && editor)
-        painter.setBrush(editor->brush(mChannels));
-    else
-        painter.setBrush(QBrush{isBlack() ? Qt::black : Qt::white});
-    // border radius
-    painter.drawRoundedRect(rect(), 50, 5, Qt::RelativeSize);
-}
-
-//=============
-// PianoLayout
-//=============
-
 namespace {
 
 constexpr double whiteRatio = 7.; /*!< ratio of the height of a white key by its width */
@@ -82,103 +34,12 @@ constexpr int whiteHeightForWidth(double width) {
     return decay_value<int>(whiteRatio * width);
 }
 
+int frameInterval() {
+    const auto* screen = QGuiApplication::primaryScreen();
+    const auto refreshRate = screen ? screen->refreshRate() : 60.;
+    return decay_value<int>(1000. / (refreshRate > 0. ? refreshRate : 60.));
 }
 
-PianoLayout::~PianoLayout() {
-    while (auto* item = takeAt(0))
-        delete item;
-}
-
-void PianoLayout::addKey(PianoKey* key) {
-    mLastBlack = key->isBlack();
-    if (mLastBlack) {
-        key->raise();
-        mBlack.push_back({new QWidgetItem{key}, mWhite.size()});
-        if (mWhite.empty())
-            mFirstBlack = true;
-    } else {
-        key->lower();
-        mWhite.push_back(new QWidgetItem{key});
-    }
-}
-
-void PianoLayout::addItem(QLayoutItem*) {
-    TRACE_ERROR("Can't add item for this layout");
-}
-
-Qt::Orientations PianoLayout::expandingDirections() const {
-    return Qt::Horizontal;
-}
-
-QLayoutItem* PianoLayout::itemAt(int index) const {
-    if (index >= 0) {
-        if (index < mWhite.size())
-            return mWhite.at(index);
-        if (index < mWhite.size() + mBlack.size())
-            return mBlack.at(index - mWhite.size()).first;
-    }
-    return nullptr;
-}
-
-QLayoutItem* PianoLayout::takeAt(int index) {
-    if (index >= 0) {
-        if (index < mWhite.size())
-            return mWhite.takeAt(index);
-        if (index < mWhite.size() + mBlack.size())
-            return mBlack.takeAt(index-mWhite.size()).first;
-    }
-    return nullptr;
-}
-
-int PianoLayout::count() const {
-    return mWhite.size() + mBlack.size();
-}
-
-void PianoLayout::setGeometry(const QRect& rect) {
-    QLayout::setGeometry(rect);
-
-    double blackBounds = 0.;
-    if (mFirstBlack)
-        blackBounds += .5;
-    if (mLastBlack)
-        blackBounds += .5;
-
-    const double count = mWhite.size() + blackBounds;
-    if (count <= 0.5)
-        return;
-
-    // compute size
-    const int whiteWidth = (int)(rect.width() / count);
-    const int whiteHeight = qMin(rect.height(), whiteHeightForWidth(whiteWidth));
-    const int blackWidth = decay_value<int>(blackWidthRatio * whiteWidth);
-    const int blackHeight = decay_value<int>(blackHeightRatio * whiteHeight);
-    // compute offset
-    const double totalWidth = mWhite.size() * whiteWidth + blackBounds;
-    const auto whiteOffset = rect.topLeft() + QPoint{(rect.width() - (int)totalWidth)/2, (rect.height() - whiteHeight)/2};
-    // update white keys position
-    QRect whiteRect{whiteOffset, QSize{whiteWidth, whiteHeight}};
-    for (auto* item : mWhite) {
-        item->setGeometry(whiteRect);
-        whiteRect.moveLeft(whiteRect.left() + whiteWidth);
-    }
-    // update black keys position
-    QRect blackRect{whiteOffset, QSize{blackWidth, blackHeight}};
-    for (const auto& pair : mBlack) {
-        blackRect.moveLeft(whiteOffset.x() + whiteWidth * pair.second - blackWidth / 2);
-        pair.first->setGeometry(blackRect);
-    }
-}
-
-bool PianoLayout::hasHeightForWidth() const {
-    return true;
-}
-
-int PianoLayout::heightForWidth(int width) const {
-    return mWhite.empty() ? 0 : whiteHeightForWidth((double)width / mWhite.size());
-}
-
-QSize PianoLayout::sizeHint() const {
-    return {600, whiteHeightForWidth(600. / 52)};
 }
 
 //=======
@@ -195,8 +56,14 @@ MetaHandler* makeMetaPiano(QObject* parent) {
 }
 
 Piano::Piano() : Instrument{Mode::io()} {
-    mKeys.fill(nullptr);
-    buildKeys();
+    mChannels.fill({});
+    mFrameTimer = new QTimer{this};
+    mFrameTimer->setSingleShot(true);
+    mFrameTimer->setInterval(frameInterval());
+    connect(mFrameTimer, &QTimer::timeout, this, &Piano::renderKeys);
+    QSizePolicy policy{QSizePolicy::Expanding, QSizePolicy::Preferred};
+    policy.setHeightForWidth(true);
+    setSizePolicy(policy);
 }
 
 HandlerView::Parameters Piano::getParameters() const {
@@ -217,52 +84,54 @@ const range_t<Note>& Piano::range() const {
 void Piano::setRange(const range_t<Note>& range) {
     if (range != mRange && 0 <= range.min.code() && range.max.code() < 0x80) {
         mRange = range;
-        clearKeys();
-        buildKeys();
+        mChannels.fill({});
+        mActiveKey = -1;
+        buildGeometry();
+        updateGeometry();
     }
 }
 
-void Piano::clearKeys() {
-    for (auto* key : mKeys)
-        if (key)
-            key->deleteLater();
-    mKeys.fill(nullptr);
-    mActiveKey = nullptr;
-    delete layout();
+bool Piano::hasHeightForWidth() const {
+    return true;
 }
 
-void Piano::buildKeys() {
-    auto* pianoLayout = new PianoLayout{nullptr};
-    pianoLayout->setMargin(0);
-    for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code) {
-        auto* key = new PianoKey{Note::from_code(code), this};
-        mKeys[code] = key;
-        pianoLayout->addKey(key);
-    }
-    setLayout(pianoLayout);
+int Piano::heightForWidth(int width) const {
+    int whiteCount = 0;
+    for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code)
+        if (!Note::from_code(code).is_black())
+            ++whiteCount;
+    return whiteCount == 0 ? 0 : whiteHeightForWidth(static_cast<double>(width) / whiteCount);
+}
+
+QSize Piano::sizeHint() const {
+    return {600, whiteHeightForWidth(600. / 52)};
+}
+
+void Piano::updateContext(Context* context) {
+    if (auto* editor = context->channelEditor())
+        connect(editor, &ChannelEditor::colorChanged, this, &Piano::invalidateKeys);
+    invalidateKeys();
 }
 
 void Piano::receiveNotesOff(channels_t channels) {
-    for (auto* key : mKeys)
-        if (key)
-            key->deactivate(channels);
+    for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code)
+        deactivate(code, channels);
 }
 
 void Piano::receiveNoteOn(channels_t channels, const Note& note) {
-    if (auto* key = mKeys[note.code()])
-        key->activate(channels);
+    activate(note.code(), channels);
 }
 
 void Piano::receiveNoteOff(channels_t channels, const Note& note) {
-    if (auto* key = mKeys[note.code()])
-        key->deactivate(channels);
+    deactivate(note.code(), channels);
 }
 
 bool Piano::event(QEvent* event) {
     if (event->type() == QEvent::ToolTip) {
         auto* helpEvent = static_cast<QHelpEvent*>(event);
-        if (auto* key = qobject_cast<PianoKey*>(childAt(helpEvent->pos()))) {
-            QToolTip::showText(helpEvent->globalPos(), key->toolTip());
+        const auto code = keyAt(helpEvent->pos());
+        if (code != -1) {
+            QToolTip::showText(helpEvent->globalPos(), QString::fromStdString(Note::from_code(code).string()), this, mRects[code]);
         } else {
             QToolTip::hideText();
             event->ignore();
@@ -287,42 +156,206 @@ void Piano::mouseDoubleClickEvent(QMouseEvent* event) {
 
 void Piano::mousePressEvent(QMouseEvent* event) {
     if (canGenerate()) {
-        auto* key = qobject_cast<PianoKey*>(childAt(event->pos()));
-        generateKeyOn(key, event->button());
-        mActiveKey = key;
+        const auto code = keyAt(event->pos());
+        generateKeyOn(code, event->button());
+        mActiveKey = code;
     }
 }
 
 void Piano::mouseReleaseEvent(QMouseEvent* event) {
     if (canGenerate())
-        generateKeyOff(qobject_cast<PianoKey*>(childAt(event->pos())), event->button());
+        generateKeyOff(keyAt(event->pos()), event->button());
 }
 
 void Piano::mouseMoveEvent(QMouseEvent* event) {
     if (canGenerate()) {
-        auto* key = qobject_cast<PianoKey*>(childAt(event->pos()));
-        if (mActiveKey != key) {
+        const auto code = keyAt(event->pos());
+        if (mActiveKey != code) {
             generateKeyOff(mActiveKey, event->buttons());
-            generateKeyOn(key, event->buttons());
-            mActiveKey = key;
+            generateKeyOn(code, event->buttons());
+            mActiveKey = code;
         }
     }
 }
 
-void Piano::generateKeyOn(PianoKey* key, Qt::MouseButtons buttons) {
-    if (key) {
+void Piano::paintEvent(QPaintEvent*) {
+    // painter is already clipped to the updated region
+    QPainter painter{this};
+    painter.drawPixmap(0, 0, mSurface);
+}
+
+void Piano::resizeEvent(QResizeEvent*) {
+    buildGeometry();
+}
+
+void Piano::setKeyChannels(int code, channels_t channels) {
+    if (isValid(code) && mChannels[code] != channels) {
+        mChannels[code] = channels;
+        mDirty.set(code);
+        if (!mFrameTimer->isActive())
+            mFrameTimer->start();
+    }
+}
+
+void Piano::activate(int code, channels_t channels) {
+    if (isValid(code))
+        setKeyChannels(code, mChannels[code] | channels);
+}
+
+void Piano::deactivate(int code, channels_t channels) {
+    if (isValid(code))
+        setKeyChannels(code, mChannels[code] & ~channels);
+}
+
+void Piano::buildGeometry() {
+    // white keys are laid out side by side, black keys are centered on the boundary with the previous white key
+    std::vector<int> whites;
+    std::vector<std::pair<int, int>> blacks;
+    for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code) {
+        if (Note::from_code(code).is_black())
+            blacks.emplace_back(code, static_cast<int>(whites.size()));
+        else
+            whites.push_back(code);
+    }
+    mRects.fill(QRect{});
+
+    double blackBounds = 0.;
+    if (mRange.min.is_black())
+        blackBounds += .5;
+    if (mRange.max.is_black())
+        blackBounds += .5;
+
+    const auto r = rect();
+    const double count = whites.size() + blackBounds;
+    if (count > 0.5) {
+        // compute size
+        const int whiteWidth = static_cast<int>(r.width() / count);
+        const int whiteHeight = qMin(r.height(), whiteHeightForWidth(whiteWidth));
+        const int blackWidth = decay_value<int>(blackWidthRatio * whiteWidth);
+        const int blackHeight = decay_value<int>(blackHeightRatio * whiteHeight);
+        // compute offset
+        const double totalWidth = whites.size() * whiteWidth + blackBounds;
+        const auto whiteOffset = r.topLeft() + QPoint{(r.width() - static_cast<int>(totalWidth))/2, (r.height() - whiteHeight)/2};
+        // update white keys position
+        QRect whiteRect{whiteOffset, QSize{whiteWidth, whiteHeight}};
+        for (auto code : whites) {
+            mRects[code] = whiteRect;
+            whiteRect.moveLeft(whiteRect.left() + whiteWidth);
+        }
+        // update black keys position
+        QRect blackRect{whiteOffset, QSize{blackWidth, blackHeight}};
+        for (const auto& pair : blacks) {
+            blackRect.moveLeft(whiteOffset.x() + whiteWidth * pair.second - blackWidth / 2);
+            mRects[pair.first] = blackRect;
+        }
+    }
+
+    const auto ratio = devicePixelRatioF();
+    mSurface = QPixmap{r.size() * ratio};
+    mSurface.setDevicePixelRatio(ratio);
+    mSurface.fill(Qt::transparent);
+    invalidateKeys();
+    mFrameTimer->stop();
+    renderKeys();
+}
+
+void Piano::invalidateKeys() {
+    mAtlas.clear();
+    for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code)
+        mDirty.set(code);
+    if (!mFrameTimer->isActive())
+        mFrameTimer->start();
+}
+
+void Piano::renderKeys() {
+    if (mDirty.none() || mSurface.isNull())
+        return;
+#ifdef MIDILAB_ENABLE_TIMING
+    const auto t0 = measure_t::clock_type::now();
+#endif
+    // dirty area covers the dirty keys, neighbors overlapping it are redrawn as well
+    QRegion dirtyRegion;
+    for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code)
+        if (mDirty.test(code))
+            dirtyRegion += mRects[code];
+    QPainter painter{&mSurface};
+    painter.setClipRegion(dirtyRegion);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(dirtyRegion.boundingRect(), Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    for (bool black : {false, true})
+        for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code)
+            if (Note::from_code(code).is_black() == black && dirtyRegion.intersects(mRects[code]))
+                painter.drawPixmap(mRects[code].topLeft(), keyPixmap(code));
+    painter.end();
+#ifdef MIDILAB_ENABLE_TIMING
+    mStatistics.frames++;
+    mStatistics.keys += mDirty.count();
+    mStatistics.duration += std::chrono::duration_cast<measure_t::duration_type>(measure_t::clock_type::now() - t0);
+    if (measure_t::clock_type::now() - mStatistics.t0 > std::chrono::seconds{5}) {
+        TRACE_DEBUG("Piano: " << mStatistics.frames << " frames, " << mStatistics.keys << " keys rendered in " << mStatistics.duration.count() << " ms");
+        mStatistics = {};
+    }
+#endif
+    mDirty.reset();
+    update(dirtyRegion);
+}
+
+const QPixmap& Piano::keyPixmap(int code) {
+    static const QColor borderColor{"#444"};
+    const bool black = Note::from_code(code).is_black();
+    const auto channels = mChannels[code];
+    const auto key = static_cast<quint32>(channels.to_integral()) << 1 | (black ? 1 : 0);
+    auto it = mAtlas.find(key);
+    if (it == mAtlas.end()) {
+        const auto ratio = devicePixelRatioF();
+        const QRect keyRect{QPoint{0, 0}, mRects[code].size()};
+        QPixmap pixmap{keyRect.size() * ratio};
+        pixmap.setDevicePixelRatio(ratio);
+        pixmap.fill(Qt::transparent);
+        QPainter painter{&pixmap};
+        painter.setPen(borderColor);
+        painter.setRenderHint(QPainter::Antialiasing);
+        // coloration
+        auto* editor = channelEditor();
+        if (channels && editor)
+            painter.setBrush(editor->brush(channels));
+        else
+            painter.setBrush(QBrush{black ? Qt::black : Qt::white});
+        // border radius
+        painter.drawRoundedRect(keyRect, 50, 5, Qt::RelativeSize);
+        it = mAtlas.insert(key, pixmap);
+    }
+    return *it;
+}
+
+bool Piano::isValid(int code) const {
+    return mRange.min.code() <= code && code <= mRange.max.code();
+}
+
+int Piano::keyAt(const QPoint& point) const {
+    // black keys are above white keys
+    for (bool black : {true, false})
+        for (int code = mRange.min.code() ; code <= mRange.max.code() ; ++code)
+            if (Note::from_code(code).is_black() == black && mRects[code].contains(point))
+                return code;
+    return -1;
+}
+
+void Piano::generateKeyOn(int code, Qt::MouseButtons buttons) {
+    if (isValid(code)) {
         if (const auto channels = channelsFromButtons(buttons)) {
-            generateNoteOn(channels, key->note());
-            key->activate(channels);
+            generateNoteOn(channels, Note::from_code(code));
+            activate(code, channels);
         }
     }
 }
 
-void Piano::generateKeyOff(PianoKey* key, Qt::MouseButtons buttons) {
-    if (key) {
+void Piano::generateKeyOff(int code, Qt::MouseButtons buttons) {
+    if (isValid(code)) {
         if (const auto channels = channelsFromButtons(buttons)) {
-            generateNoteOff(channels, key->note());
-            key->deactivate(channels);
+            generateNoteOff(channels, Note::from_code(code));
+            deactivate(code, channels);
         }
     }
 }
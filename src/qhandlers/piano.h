@@ -21,76 +21,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef QHANDLERS_PIANO_H
 #define QHANDLERS_PIANO_H
 
+#include <bitset>
+#include <QTimer>
 #include "qhandlers/common.h"
 
-//==========
-// PianoKey
-//==========
-
-/**
- * @todo let the ratio be configurable in the piano
- */
-
-class Piano;
-
-class PianoKey : public QWidget {
-
-    Q_OBJECT
-
-public:
-    explicit PianoKey(const Note& note, Piano* parent);
-
-    void setChannels(channels_t channels);
-    void activate(channels_t channels);
-    void deactivate(channels_t channels);
-
-    const Note& note() const;
-    bool isBlack() const;
-
-    void paintEvent(QPaintEvent* event) override;
-
-private:
-    const Note mNote;
-    channels_t mChannels; /*!< channels currently active */
-    Piano* mParent; /*!< keeps a reference to the parent piano to get channel editor */
-
-};
-
-//=============
-// PianoLayout
-//=============
-
-class PianoLayout : public QLayout {
-
-    Q_OBJECT
-
-    using BlackItem = std::pair<QLayoutItem*, unsigned>;
-
-public:
-    using QLayout::QLayout;
-    ~PianoLayout();
-
-    void addKey(PianoKey* key);
-
-    void addItem(QLayoutItem* item) override;
-    Qt::Orientations expandingDirections() const override;
-    QLayoutItem* itemAt(int index) const override;
-    QLayoutItem* takeAt(int index) override;
-    int count() const override;
-    void setGeometry(const QRect& rect) override;
-
-    bool hasHeightForWidth() const override;
-    int heightForWidth(int width) const override;
-    QSize sizeHint() const override;
-
-private:
-    QList<BlackItem> mBlack;
-    QList<QLayoutItem*> mWhite;
-    bool mFirstBlack {false};
-    bool mLastBlack {false};
-
-};
-
 //=======
 // Piano
 //=======
@@ -98,6 +32,11 @@ private:
 MetaHandler* makeMetaPiano(QObject* parent);
 
 /**
+ * The keyboard is a single surface: keys are blitted from an atlas of pre-rendered pixmaps
+ * indexed by shape and channels, note events only mark keys as dirty and dirty keys are
+ * rendered at most once per display frame.
+ *
+ * @todo let the ratio be configurable in the piano
  * @todo features enchancement : freeze, snapshot, step by step, filtering, pulse ...
  */
 
@@ -114,7 +53,13 @@ public:
     const range_t<Note>& range() const;
     void setRange(const range_t<Note>& range);
 
+    bool hasHeightForWidth() const override;
+    int heightForWidth(int width) const override;
+    QSize sizeHint() const override;
+
 protected:
+    void updateContext(Context* context) override;
+
     void receiveNotesOff(channels_t channels) final;
     void receiveNoteOn(channels_t channels, const Note& note) final;
     void receiveNoteOff(channels_t channels, const Note& note) final;
@@ -126,16 +71,41 @@ protected:
     void mousePressEvent(QMouseEvent* event) override;
     void mouseReleaseEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
 
 private:
-    void clearKeys();
-    void buildKeys();
-    void generateKeyOn(PianoKey* key, Qt::MouseButtons buttons);
-    void generateKeyOff(PianoKey* key, Qt::MouseButtons buttons);
+    void setKeyChannels(int code, channels_t channels);
+    void activate(int code, channels_t channels);
+    void deactivate(int code, channels_t channels);
+
+    void buildGeometry(); /*!< computes key rectangles and resets the surface */
+    void invalidateKeys(); /*!< drops the atlas and marks all keys as dirty */
+    void renderKeys(); /*!< draws dirty keys on the surface */
+    const QPixmap& keyPixmap(int code);
+    bool isValid(int code) const;
+    int keyAt(const QPoint& point) const; /*!< returns -1 if no key is found */
 
-    PianoKey* mActiveKey {nullptr};
+    void generateKeyOn(int code, Qt::MouseButtons buttons);
+    void generateKeyOff(int code, Qt::MouseButtons buttons);
+
+private:
+    int mActiveKey {-1};
     range_t<Note> mRange {note_ns::A(0), note_ns::C(8)};
-    std::array<PianoKey*, 0x80> mKeys;
+    std::array<channels_t, 0x80> mChannels; /*!< channels currently active for each key */
+    std::array<QRect, 0x80> mRects; /*!< geometry of each key */
+    std::bitset<0x80> mDirty;
+    QHash<quint32, QPixmap> mAtlas; /*!< key pixmaps indexed by shape and channels */
+    QPixmap mSurface;
+    QTimer* mFrameTimer;
+#ifdef MIDILAB_ENABLE_TIMING
+    struct {
+        size_t frames {0};
+        size_t keys {0};
+        measure_t::duration_type duration {0};
+        measure_t::clock_type::time_point t0 {measure_t::clock_type::now()};
+    } mStatistics;
+#endif
 
 };
 
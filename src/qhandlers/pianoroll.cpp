@@ -0,0 +1,321 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#include <cmath>
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include "qhandlers/pianoroll.h"
+
+//================
+// PianoRollIndex
+//================
+
+constexpr size_t PianoRollIndex::pitchCount;
+
+std::shared_ptr<const PianoRollIndex> PianoRollIndex::build(std::shared_ptr<const Sequence> sequence, const std::atomic_bool& cancelled) {
+    TRACE_MEASURE("PianoRollIndex::build");
+    auto index = std::make_shared<PianoRollIndex>();
+    index->bucketSpan = sequence->clock().ppqn();
+    index->lastTimestamp = sequence->last_timestamp();
+    // pair note on & note off, a negative start means the note is not pressed
+    channel_map_t<std::array<timestamp_t, pitchCount>> starts;
+    for (auto& channelStarts : starts)
+        channelStarts.fill(-1.);
+    auto close = [&](channel_t channel, byte_t note, timestamp_t end) {
+        auto& start = starts[channel][note];
+        if (start >= 0.) {
+            index->notes.push_back(Interval{start, end, note, channel});
+            start = -1.;
+        }
+    };
+    for (const auto& item : *sequence) {
+        if (cancelled.load(std::memory_order_relaxed))
+            return nullptr;
+        if (item.event.is(family_t::note_on) || item.event.is(family_t::note_off)) {
+            const auto note = extraction_ns::note(item.event);
+            const bool pressed = item.event.is(family_t::note_on) && extraction_ns::velocity(item.event) != 0;
+            for (channel_t channel : item.event.channels()) {
+                close(channel, note, item.timestamp);
+                if (pressed)
+                    starts[channel][note] = item.timestamp;
+            }
+        }
+    }
+    for (channel_t channel = 0 ; channel < channels_t::capacity() ; ++channel)
+        for (size_t note = 0 ; note < pitchCount ; ++note)
+            close(channel, static_cast<byte_t>(note), index->lastTimestamp);
+    std::sort(index->notes.begin(), index->notes.end(), [](const auto& lhs, const auto& rhs) { return lhs.start < rhs.start; });
+    // fill buckets & density
+    const auto bucketCount = index->bucketAt(index->lastTimestamp) + 1;
+    index->buckets.resize(bucketCount);
+    index->density.resize(bucketCount * pitchCount);
+    for (size_t i = 0 ; i < index->notes.size() ; ++i) {
+        if (cancelled.load(std::memory_order_relaxed))
+            return nullptr;
+        const auto& interval = index->notes[i];
+        const auto duration = interval.end - interval.start;
+        for (auto bucket = index->bucketAt(interval.start) ; bucket <= index->bucketAt(interval.end) ; ++bucket) {
+            index->buckets[bucket].push_back(static_cast<uint32_t>(i));
+            const auto bucketStart = bucket * index->bucketSpan;
+            const auto overlap = std::min(interval.end, bucketStart + index->bucketSpan) - std::max(interval.start, bucketStart);
+            auto& cell = index->density[bucket * pitchCount + interval.note];
+            cell.occupancy += static_cast<float>(overlap / index->bucketSpan);
+            if (duration >= cell.longest) {
+                cell.longest = duration;
+                cell.channel = interval.channel;
+            }
+        }
+    }
+    return index;
+}
+
+size_t PianoRollIndex::bucketAt(timestamp_t timestamp) const {
+    return static_cast<size_t>(std::max(0., timestamp) / bucketSpan);
+}
+
+const PianoRollIndex::Cell& PianoRollIndex::cell(size_t bucket, byte_t note) const {
+    return density[bucket * pitchCount + note];
+}
+
+//===========
+// PianoRoll
+//===========
+
+namespace {
+
+constexpr int densityThreshold = 4; /*!< under this number of pixels per quarter note, notes are aggregated */
+
+}
+
+constexpr int PianoRoll::tileWidth;
+constexpr int PianoRoll::minZoom;
+constexpr int PianoRoll::maxZoom;
+
+PianoRoll::PianoRoll(QWidget* parent) : QWidget{parent} {
+    setMinimumHeight(128);
+    mFrameTimer = new QTimer{this};
+    mFrameTimer->setInterval(16); // ~60 Hz
+    connect(mFrameTimer, &QTimer::timeout, this, &PianoRoll::onFrame);
+}
+
+PianoRoll::~PianoRoll() {
+    cancelIndex();
+}
+
+void PianoRoll::setChannelEditor(ChannelEditor* channelEditor) {
+    mChannelEditor = channelEditor;
+    if (mChannelEditor)
+        connect(mChannelEditor, &ChannelEditor::colorChanged, this, &PianoRoll::clearTiles);
+    clearTiles();
+}
+
+void PianoRoll::setReader(const SequenceReader* reader) {
+    mReader = reader;
+    updateFrameTimer();
+}
+
+void PianoRoll::setSequence(std::shared_ptr<const Sequence> sequence) {
+    cancelIndex();
+    mIndex.reset();
+    mPosition = 0.;
+    clearTiles();
+    if (sequence) {
+        // the task gives up as soon as the sequence changes, the previous result is never awaited
+        auto cancelled = std::make_shared<std::atomic_bool>(false);
+        auto task = std::make_shared<std::packaged_task<std::shared_ptr<const PianoRollIndex>()>>([sequence, cancelled] {
+            return PianoRollIndex::build(sequence, *cancelled);
+        });
+        mPendingIndex = task->get_future();
+        mCancelIndex = std::move(cancelled);
+        backgroundPool().submit([task] { (*task)(); });
+    }
+    updateFrameTimer();
+}
+
+int PianoRoll::zoom() const {
+    return mZoom;
+}
+
+void PianoRoll::setZoom(int zoom) {
+    zoom = qBound(minZoom, zoom, maxZoom);
+    if (zoom != mZoom) {
+        mZoom = zoom;
+        update(); // tiles are cached per zoom level
+    }
+}
+
+void PianoRoll::paintEvent(QPaintEvent*) {
+    QPainter painter{this};
+    const auto origin = static_cast<int>(std::floor(originPixel()));
+    const auto first = static_cast<int>(std::floor(static_cast<double>(origin) / tileWidth));
+    const auto last = static_cast<int>(std::floor(static_cast<double>(origin + width()) / tileWidth));
+    for (int index = first ; index <= last ; ++index)
+        painter.drawPixmap(index * tileWidth - origin, 0, tile(index));
+    // playhead
+    const auto x = static_cast<int>(std::floor(mPosition * pixelsPerQuarter() / (mIndex ? mIndex->bucketSpan : default_ppqn))) - origin;
+    painter.setPen(QPen{palette().highlight(), 2.});
+    painter.drawLine(x, 0, x, height());
+}
+
+void PianoRoll::resizeEvent(QResizeEvent*) {
+    clearTiles(); // tiles span the whole height
+}
+
+void PianoRoll::mousePressEvent(QMouseEvent* event) {
+    const auto ticksPerPixel = (mIndex ? mIndex->bucketSpan : default_ppqn) / pixelsPerQuarter();
+    emit positionSelected(std::max(0., (originPixel() + event->x()) * ticksPerPixel), event->button());
+}
+
+void PianoRoll::wheelEvent(QWheelEvent* event) {
+    setZoom(mZoom + (event->angleDelta().y() > 0 ? 1 : -1));
+}
+
+void PianoRoll::showEvent(QShowEvent*) {
+    updateFrameTimer();
+}
+
+void PianoRoll::hideEvent(QHideEvent*) {
+    mFrameTimer->stop();
+}
+
+void PianoRoll::onFrame() {
+    if (mPendingIndex.valid() && mPendingIndex.wait_for(std::chrono::seconds{0}) == std::future_status::ready) {
+        mIndex = mPendingIndex.get();
+        mCancelIndex.reset();
+        clearTiles();
+        updateFrameTimer();
+    }
+    if (mReader) {
+        const auto position = mReader->position();
+        if (position != mPosition) {
+            mPosition = position;
+            update();
+        }
+    }
+}
+
+void PianoRoll::updateFrameTimer() {
+    // the pending index is collected once the widget is shown again
+    if (isVisible() && (mReader || mPendingIndex.valid()))
+        mFrameTimer->start();
+    else
+        mFrameTimer->stop();
+}
+
+void PianoRoll::cancelIndex() {
+    if (mCancelIndex)
+        *mCancelIndex = true;
+    mCancelIndex.reset();
+    mPendingIndex = {};
+}
+
+void PianoRoll::clearTiles() {
+    mTiles.clear();
+    update();
+}
+
+double PianoRoll::pixelsPerQuarter() const {
+    return static_cast<double>(1 << mZoom);
+}
+
+double PianoRoll::originPixel() const {
+    // the playhead stays at the first quarter of the widget
+    return mPosition * pixelsPerQuarter() / (mIndex ? mIndex->bucketSpan : default_ppqn) - width() / 4;
+}
+
+const QPixmap& PianoRoll::tile(int index) {
+    const auto key = static_cast<quint64>(mZoom) << 32 | static_cast<quint32>(index);
+    if (auto* pixmap = mTiles.object(key))
+        return *pixmap;
+    auto* pixmap = new QPixmap{tileWidth, std::max(height(), 1)};
+    renderTile(*pixmap, index);
+    mTiles.insert(key, pixmap);
+    return *pixmap;
+}
+
+void PianoRoll::renderTile(QPixmap& pixmap, int index) const {
+    const auto rowHeight = static_cast<double>(pixmap.height()) / PianoRollIndex::pitchCount;
+    QPainter painter{&pixmap};
+    // background with black keys rows
+    painter.fillRect(pixmap.rect(), palette().base());
+    for (int note = 0 ; note < static_cast<int>(PianoRollIndex::pitchCount) ; ++note)
+        if (Note::from_code(note).is_black())
+            painter.fillRect(QRectF{0., (PianoRollIndex::pitchCount - 1 - note) * rowHeight, static_cast<double>(tileWidth), rowHeight}, palette().alternateBase());
+    if (!mIndex || index < 0)
+        return;
+    const auto ticksPerPixel = mIndex->bucketSpan / pixelsPerQuarter();
+    const auto first = index * tileWidth * ticksPerPixel;
+    const auto last = (index + 1) * tileWidth * ticksPerPixel;
+    if (first > mIndex->lastTimestamp)
+        return;
+    painter.translate(-index * tileWidth, 0);
+    if (pixelsPerQuarter() < densityThreshold) {
+        renderDensity(painter, first, last, ticksPerPixel, rowHeight);
+    } else {
+        // quarter notes grid
+        painter.setPen(palette().mid().color());
+        for (auto bucket = mIndex->bucketAt(first) ; bucket <= mIndex->bucketAt(last) ; ++bucket) {
+            const auto x = bucket * mIndex->bucketSpan / ticksPerPixel;
+            painter.drawLine(QPointF{x, 0.}, QPointF{x, static_cast<double>(pixmap.height())});
+        }
+        renderNotes(painter, first, last, ticksPerPixel, rowHeight);
+    }
+}
+
+void PianoRoll::renderNotes(QPainter& painter, timestamp_t first, timestamp_t last, double ticksPerPixel, double rowHeight) const {
+    const auto firstBucket = mIndex->bucketAt(first);
+    const auto lastBucket = std::min(mIndex->bucketAt(last), mIndex->buckets.size() - 1);
+    painter.setPen(rowHeight >= 4. ? QPen{palette().dark().color()} : QPen{Qt::NoPen});
+    for (auto bucket = firstBucket ; bucket <= lastBucket ; ++bucket) {
+        for (auto i : mIndex->buckets[bucket]) {
+            const auto& interval = mIndex->notes[i];
+            // notes spanning several buckets are drawn once
+            if (std::max(mIndex->bucketAt(interval.start), firstBucket) != bucket)
+                continue;
+            const auto x = interval.start / ticksPerPixel;
+            const auto w = std::max(1., (interval.end - interval.start) / ticksPerPixel);
+            const auto y = (PianoRollIndex::pitchCount - 1 - interval.note) * rowHeight;
+            painter.setBrush(channelColor(interval.channel));
+            painter.drawRect(QRectF{x, y, w, rowHeight});
+        }
+    }
+}
+
+void PianoRoll::renderDensity(QPainter& painter, timestamp_t first, timestamp_t last, double ticksPerPixel, double rowHeight) const {
+    const auto firstBucket = mIndex->bucketAt(first);
+    const auto lastBucket = std::min(mIndex->bucketAt(last), mIndex->buckets.size() - 1);
+    const auto w = mIndex->bucketSpan / ticksPerPixel;
+    for (auto bucket = firstBucket ; bucket <= lastBucket ; ++bucket) {
+        const auto x = bucket * mIndex->bucketSpan / ticksPerPixel;
+        for (size_t note = 0 ; note < PianoRollIndex::pitchCount ; ++note) {
+            const auto& cell = mIndex->cell(bucket, static_cast<byte_t>(note));
+            if (cell.occupancy > 0.f) {
+                auto color = channelColor(cell.channel);
+                color.setAlphaF(.25 + .75 * std::min(1.f, cell.occupancy));
+                painter.fillRect(QRectF{x, (PianoRollIndex::pitchCount - 1 - note) * rowHeight, w, rowHeight}, color);
+            }
+        }
+    }
+}
+
+QColor PianoRoll::channelColor(channel_t channel) const {
+    return mChannelEditor ? mChannelEditor->color(channel) : palette().highlight().color();
+}
@@ -0,0 +1,137 @@
+/*
+
+MIDILab | A Versatile MIDI Controller
+Copyright (C) 2017-2019 Julien Berthault
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef QHANDLERS_PIANOROLL_H
+#define QHANDLERS_PIANOROLL_H
+
+#include <atomic>
+#include <future>
+#include <QCache>
+#include <QTimer>
+#include "handlers/sequencereader.h"
+#include "qcore/editors.h"
+
+//================
+// PianoRollIndex
+//================
+
+/// Note intervals extracted once from a sequence
+/// Buckets reference the notes overlapping a fixed span of timestamps (a quarter note),
+/// the density grid aggregates the occupancy of each pitch in each bucket for zoomed-out rendering
+
+struct PianoRollIndex {
+
+    static constexpr size_t pitchCount = 0x80;
+
+    struct Interval {
+        timestamp_t start;
+        timestamp_t end;
+        byte_t note;
+        channel_t channel;
+    };
+
+    struct Cell {
+        float occupancy {0.f}; /*!< ratio of the bucket span covered by notes */
+        channel_t channel {0}; /*!< channel of the longest note in the cell */
+        timestamp_t longest {0.};
+    };
+
+    static std::shared_ptr<const PianoRollIndex> build(std::shared_ptr<const Sequence> sequence, const std::atomic_bool& cancelled); /*!< nullptr if cancelled */
+
+    size_t bucketAt(timestamp_t timestamp) const;
+    const Cell& cell(size_t bucket, byte_t note) const;
+
+    timestamp_t bucketSpan {default_ppqn};
+    timestamp_t lastTimestamp {0.};
+    std::vector<Interval> notes; /*!< sorted by start */
+    std::vector<std::vector<uint32_t>> buckets; /*!< indices of notes overlapping each bucket */
+    std::vector<Cell> density; /*!< bucket-major grid of pitchCount cells per bucket */
+
+};
+
+//===========
+// PianoRoll
+//===========
+
+/**
+ * The roll is split in tiles of fixed width rendered once per zoom level and cached,
+ * following the reader position only moves the tiles and the playhead.
+ * When a quarter note spans less than a few pixels, notes are replaced by density bars.
+ */
+
+class PianoRoll : public QWidget {
+
+    Q_OBJECT
+
+public:
+    static constexpr int tileWidth = 256;
+    static constexpr int minZoom = 0; /*!< 1 pixel per quarter note */
+    static constexpr int maxZoom = 8; /*!< 256 pixels per quarter note */
+
+    explicit PianoRoll(QWidget* parent);
+    ~PianoRoll();
+
+    void setChannelEditor(ChannelEditor* channelEditor);
+    void setReader(const SequenceReader* reader);
+    void setSequence(std::shared_ptr<const Sequence> sequence); /*!< index is built asynchronously */
+
+    int zoom() const;
+    void setZoom(int zoom);
+
+signals:
+    void positionSelected(timestamp_t timestamp, Qt::MouseButton button);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+private slots:
+    void onFrame();
+    void clearTiles();
+
+private:
+    void updateFrameTimer(); /*!< frames are only needed while visible with a reader or a pending index */
+    void cancelIndex();
+    double pixelsPerQuarter() const;
+    double originPixel() const; /*!< absolute pixel displayed at the left of the widget */
+    const QPixmap& tile(int index);
+    void renderTile(QPixmap& pixmap, int index) const;
+    void renderNotes(QPainter& painter, timestamp_t first, timestamp_t last, double ticksPerPixel, double rowHeight) const;
+    void renderDensity(QPainter& painter, timestamp_t first, timestamp_t last, double ticksPerPixel, double rowHeight) const;
+    QColor channelColor(channel_t channel) const;
+
+private:
+    ChannelEditor* mChannelEditor {nullptr};
+    const SequenceReader* mReader {nullptr};
+    std::shared_ptr<const PianoRollIndex> mIndex;
+    std::future<std::shared_ptr<const PianoRollIndex>> mPendingIndex;
+    std::shared_ptr<std::atomic_bool> mCancelIndex; /*!< set when the pending index is no longer wanted */
+    QCache<quint64, QPixmap> mTiles {64};
+    QTimer* mFrameTimer;
+    timestamp_t mPosition {0.};
+    int mZoom {5};
+
+};
+
+#endif // QHANDLERS_PIANOROLL_H
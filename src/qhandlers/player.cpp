@@ -19,6 +19,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include <QHeaderView>
+#include <QLineEdit>
 #include <QMessageBox>
 #include <QMimeData>
 #include <QMouseEvent>
@@ -87,6 +88,30 @@ auto qstringFromTimestamp(timestamp_t timestamp, const SharedSequence& sequence,
     return qtimeFromTimestamp(timestamp, sequence, distorsion).toString(timeFormat);
 }
 
+/// Duration cell of the playlist, sorted by its value in seconds rather than by its text
+class DurationItem : public QTableWidgetItem {
+
+public:
+    DurationItem() : QTableWidgetItem{"*"} {
+        setTextAlignment(Qt::AlignCenter);
+    }
+
+    void setDuration(double seconds) {
+        setData(Qt::UserRole, seconds);
+        setText(QTime{0, 0}.addMSecs(decay_value<int>(seconds * 1.e3)).toString(timeFormat));
+    }
+
+    void setInvalid() {
+        setData(Qt::UserRole, QVariant{});
+        setText("\u00d8");
+    }
+
+    bool operator<(const QTableWidgetItem& other) const override {
+        return data(Qt::UserRole).toDouble() < other.data(Qt::UserRole).toDouble();
+    }
+
+};
+
 void showSystemTrayMessage(QSystemTrayIcon* systemTrayIcon, const QString& title, const QString& msg, const QIcon& icon, int msecs) {
 #if QT_VERSION_MAJOR > 5 || (QT_VERSION_MAJOR == 5 && QT_VERSION_MINOR >= 9)
         systemTrayIcon->showMessage(title, msg, icon, msecs);
@@ -101,114 +126,232 @@ void showSystemTrayMessage(QSystemTrayIcon* systemTrayIcon, const QString& title
 // SequenceView
 //==============
 
-SequenceViewTrackItem::SequenceViewTrackItem(track_t track, SequenceView* view, QTreeWidget* parent) :
-    QTreeWidgetItem{parent}, mTrack{track}, mView{view} {
+SequenceModel::SequenceModel(SequenceView* view) : QAbstractItemModel{view}, mView{view} {
 
 }
 
-track_t SequenceViewTrackItem::track() const {
-    return mTrack;
+void SequenceModel::setSequence(const SharedSequence& sequence) {
+    beginResetModel();
+    mSequence = sequence;
+    mTracks.clear();
+    mFamilies.clear();
+    mChannels.clear();
+    mTimestamps.clear();
+    if (mSequence) {
+        const auto size = mSequence->size();
+        mFamilies.reserve(size);
+        mChannels.reserve(size);
+        mTimestamps.reserve(size);
+        for (size_t i = 0 ; i < size ; ++i) {
+            const auto& item = (*mSequence)[i];
+            mFamilies.push_back(item.event.family());
+            mChannels.push_back(item.event.is(families_t::voice()) ? item.event.channels() : channels_t{});
+            mTimestamps.push_back(item.timestamp);
+        }
+        // track rows reuse the positions indexed by the sequence
+        const auto index = mSequence->index();
+        for (const auto& track : index->tracks) {
+            TrackData trackData{track.first, {}, {}};
+            trackData.events = track.second;
+            for (auto i : trackData.events) {
+                const auto& event = (*mSequence)[i].event;
+                if (event.is(families_t::voice())) {
+                    trackData.channels |= event.channels();
+                } else if (event.is(family_t::track_name)) {
+                    if (!trackData.rawName.isEmpty())
+                        trackData.rawName += " / ";
+                    trackData.rawName += QByteArray::fromStdString(event.description());
+                }
+            }
+            mTracks.push_back(std::move(trackData));
+        }
+    }
+    endResetModel();
+}
+
+void SequenceModel::setTrackCheckable(bool checkable) {
+    mTrackCheckable = checkable;
+    for (auto& trackData : mTracks)
+        trackData.enabled = true;
+    if (!mTracks.empty())
+        emit dataChanged(index(0, 0), index(static_cast<int>(mTracks.size()) - 1, 0), {Qt::CheckStateRole});
+}
+
+void SequenceModel::updateFilter(families_t families, channels_t channels, const range_t<timestamp_t>& limits) {
+    std::vector<uint32_t> visibleEvents;
+    for (int row = 0 ; row < static_cast<int>(mTracks.size()) ; ++row) {
+        auto& trackData = mTracks[static_cast<size_t>(row)];
+        // indices and timestamps are both sorted, limits are found by dichotomy
+        const auto first = std::lower_bound(trackData.events.begin(), trackData.events.end(), limits.min, [this](uint32_t i, timestamp_t t) { return mTimestamps[i] < t; });
+        const auto last = std::upper_bound(first, trackData.events.end(), limits.max, [this](timestamp_t t, uint32_t i) { return t < mTimestamps[i]; });
+        visibleEvents.clear();
+        for (auto it = first ; it != last ; ++it)
+            if (families.test(mFamilies[*it]) && (!mChannels[*it] || mChannels[*it].any(channels)))
+                visibleEvents.push_back(*it);
+        if (visibleEvents == trackData.visibleEvents)
+            continue;
+        const auto parent = index(row, 0);
+        if (!trackData.visibleEvents.empty()) {
+            beginRemoveRows(parent, 0, static_cast<int>(trackData.visibleEvents.size()) - 1);
+            trackData.visibleEvents.clear();
+            endRemoveRows();
+        }
+        if (!visibleEvents.empty()) {
+            beginInsertRows(parent, 0, static_cast<int>(visibleEvents.size()) - 1);
+            trackData.visibleEvents = visibleEvents;
+            endInsertRows();
+        }
+    }
 }
 
-void SequenceViewTrackItem::setTrack(track_t track) {
-    mTrack = track;
+void SequenceModel::updateEncoding() {
+    if (mTracks.empty())
+        return;
+    emit dataChanged(index(0, 0), index(static_cast<int>(mTracks.size()) - 1, 0), {Qt::DisplayRole});
+    for (int row = 0 ; row < static_cast<int>(mTracks.size()) ; ++row) {
+        const auto parent = index(row, 0);
+        if (const auto count = rowCount(parent))
+            emit dataChanged(index(0, 3, parent), index(count - 1, 3, parent), {Qt::DisplayRole});
+    }
 }
 
-SequenceView* SequenceViewTrackItem::view() const {
-    return mView;
+void SequenceModel::updateBackground(channel_t channel) {
+    for (int row = 0 ; row < static_cast<int>(mTracks.size()) ; ++row) {
+        if (mTracks[static_cast<size_t>(row)].channels.test(channel)) {
+            const auto trackIndex = index(row, 0);
+            emit dataChanged(trackIndex, trackIndex, {Qt::BackgroundRole});
+        }
+    }
 }
 
-void SequenceViewTrackItem::setTrackNames(const QByteArrayList& names) {
-    auto trackFont = font(0);
-    if (names.isEmpty()) {
-        trackFont.setWeight(QFont::Normal);
-        trackFont.setItalic(true);
-        mRawText.clear();
-        setText(0, QString{"Track #%1"}.arg(mTrack+1));
-    } else {
-        trackFont.setWeight(QFont::Bold);
-        trackFont.setItalic(false);
-        mRawText = names.join(" / ");
-        updateEncoding();
-    }
-    setFont(0, trackFont);
+bool SequenceModel::isEvent(const QModelIndex& index) const {
+    return index.isValid() && index.internalId() != 0;
+}
+
+size_t SequenceModel::eventIndex(const QModelIndex& index) const {
+    return mTracks[index.internalId() - 1].visibleEvents[static_cast<size_t>(index.row())];
 }
 
-void SequenceViewTrackItem::updateEncoding() {
-    if (!mRawText.isNull())
-        setText(0, view()->codec()->toUnicode(mRawText));
+QModelIndex SequenceModel::index(int row, int column, const QModelIndex& parent) const {
+    if (row < 0 || column < 0 || column >= 4)
+        return {};
+    // internal id is 0 for tracks and the track row + 1 for events
+    if (!parent.isValid())
+        return row < static_cast<int>(mTracks.size()) ? createIndex(row, column, quintptr{0}) : QModelIndex{};
+    if (parent.internalId() == 0 && row < static_cast<int>(mTracks[static_cast<size_t>(parent.row())].visibleEvents.size()))
+        return createIndex(row, column, static_cast<quintptr>(parent.row()) + 1);
+    return {};
 }
 
-SequenceViewItem::SequenceViewItem(size_t index, SequenceViewTrackItem* parent) :
-    QTreeWidgetItem{parent}, mIndex{index} {
+QModelIndex SequenceModel::parent(const QModelIndex& child) const {
+    if (!isEvent(child))
+        return {};
+    return createIndex(static_cast<int>(child.internalId() - 1), 0, quintptr{0});
+}
 
+int SequenceModel::rowCount(const QModelIndex& parent) const {
+    if (!parent.isValid())
+        return static_cast<int>(mTracks.size());
+    if (parent.internalId() == 0 && parent.column() == 0)
+        return static_cast<int>(mTracks[static_cast<size_t>(parent.row())].visibleEvents.size());
+    return 0;
 }
 
-SequenceView* SequenceViewItem::view() const {
-    return static_cast<SequenceViewTrackItem*>(parent())->view();
+int SequenceModel::columnCount(const QModelIndex& /*parent*/) const {
+    return 4;
 }
 
-size_t SequenceViewItem::index() const {
-    return mIndex;
+QVariant SequenceModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid())
+        return {};
+    if (isEvent(index))
+        return eventData(eventIndex(index), index.column(), role);
+    return trackData(mTracks[static_cast<size_t>(index.row())], index.column(), role);
 }
 
-void SequenceViewItem::setIndex(size_t index) {
-    mIndex = index;
-    emitDataChanged();
+bool SequenceModel::setData(const QModelIndex& index, const QVariant& value, int role) {
+    if (role != Qt::CheckStateRole || !index.isValid() || isEvent(index) || index.column() != 0)
+        return false;
+    auto& trackData = mTracks[static_cast<size_t>(index.row())];
+    trackData.enabled = value.toInt() == Qt::Checked;
+    emit dataChanged(index, index, {Qt::CheckStateRole});
+    emit trackToggled(trackData.track, trackData.enabled);
+    return true;
 }
 
-void SequenceViewItem::updateEncoding() {
-    if (view()->timedEvent(mIndex).event.is(families_t::string()))
-        emitDataChanged();
+Qt::ItemFlags SequenceModel::flags(const QModelIndex& index) const {
+    auto result = QAbstractItemModel::flags(index);
+    if (mTrackCheckable && index.isValid() && !isEvent(index) && index.column() == 0)
+        result |= Qt::ItemIsUserCheckable;
+    return result;
 }
 
-void SequenceViewItem::updateVisibiliy(families_t families, channels_t channels, const range_t<timestamp_t>& limits) {
-    const auto& item = view()->timedEvent(mIndex);
-    const bool familiesVisible = item.event.is(families);
-    const bool channelsVisible = !item.event.is(families_t::voice()) || item.event.channels().any(channels);
-    const bool boundsVisible = limits.min <= item.timestamp && item.timestamp <= limits.max;
-    setHidden(!(familiesVisible && channelsVisible && boundsVisible));
+QVariant SequenceModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    static const QStringList labels{"Timestamp", "Channel", "Type", "Data"};
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < labels.size())
+        return labels[section];
+    if (orientation == Qt::Horizontal && role == Qt::TextAlignmentRole)
+        return Qt::AlignCenter;
+    return {};
+}
+
+QVariant SequenceModel::trackData(const TrackData& trackData, int column, int role) const {
+    if (column != 0)
+        return {};
+    switch (role) {
+    case Qt::DisplayRole:
+        return trackData.rawName.isEmpty() ? QString{"Track #%1"}.arg(trackData.track+1) : mView->codec()->toUnicode(trackData.rawName);
+    case Qt::FontRole: {
+        QFont trackFont;
+        trackFont.setWeight(trackData.rawName.isEmpty() ? QFont::Normal : QFont::Bold);
+        trackFont.setItalic(trackData.rawName.isEmpty());
+        return trackFont;
+    }
+    case Qt::CheckStateRole:
+        return mTrackCheckable ? QVariant{trackData.enabled ? Qt::Checked : Qt::Unchecked} : QVariant{};
+    case Qt::BackgroundRole:
+        return mView->channelEditor() ? QVariant{mView->channelEditor()->brush(trackData.channels, Qt::Horizontal)} : QVariant{};
+    }
+    return {};
 }
 
-QVariant SequenceViewItem::data(int column, int role) const {
-    const auto& item = view()->timedEvent(mIndex);
+QVariant SequenceModel::eventData(size_t index, int column, int role) const {
+    const auto& item = (*mSequence)[index];
     if (column == 0 && role == Qt::ToolTipRole)
-        return qstringFromTimestamp(item.timestamp, view()->sequence(), view()->distorsion());
-    if (column == 0 && role == Qt::DisplayRole)
-        return QString::number(decay_value<long>(item.timestamp));
-    if (column == 1 && role == Qt::DisplayRole)
-        return ChannelsSelector::channelsToStringList(item.event.channels()).join(' ');
-    if (column == 2 && role == Qt::DisplayRole)
-        return eventName(item.event);
-    if (column == 3 && role == Qt::DisplayRole) {
+        return qstringFromTimestamp(item.timestamp, mSequence, mView->distorsion());
+    if (role != Qt::DisplayRole)
+        return {};
+    switch (column) {
+    case 0: return QString::number(decay_value<long>(item.timestamp));
+    case 1: return ChannelsSelector::channelsToStringList(item.event.channels()).join(' ');
+    case 2: return eventName(item.event);
+    case 3: {
         QByteArray rawText = QByteArray::fromStdString(item.event.description());  // Qt 5.4+ only
         rawText.replace("\n", "\\n");
         rawText.replace("\r", "\\r");
         rawText.replace("\t", "\\t");
-        if (item.event.is(families_t::string())) {
-            return view()->codec()->toUnicode(rawText);
-        } else {
-            return rawText;
-        }
+        if (item.event.is(families_t::string()))
+            return mView->codec()->toUnicode(rawText);
+        return rawText;
+    }
     }
-    return QTreeWidgetItem::data(column, role);
+    return {};
 }
 
 SequenceView::SequenceView(QWidget *parent) : QWidget{parent} {
 
-    mSequenceUpdater = new QTimer{this};
-    connect(mSequenceUpdater, &QTimer::timeout, this, &SequenceView::onSequenceUpdate);
+    mModel = new SequenceModel{this};
+    connect(mModel, &SequenceModel::trackToggled, this, &SequenceView::onTrackToggle);
 
-    mTreeWidget = new QTreeWidget{this};
-    mTreeWidget->setAlternatingRowColors(true);
-    mTreeWidget->setHeaderLabels(QStringList{} << "Timestamp" << "Channel" << "Type" << "Data");
-    mTreeWidget->header()->setDefaultAlignment(Qt::AlignCenter);
-    mTreeWidget->setSelectionBehavior(QAbstractItemView::SelectItems);
-    mTreeWidget->viewport()->installEventFilter(this);
-    mTreeWidget->setColumnWidth(0, 90); // ideal width for timestamp
-    mTreeWidget->setColumnWidth(1, 60); // ideal width for channel
-    connect(mTreeWidget, &QTreeWidget::itemChanged, this, &SequenceView::onItemChange);
-    connect(mTreeWidget, &QTreeWidget::itemDoubleClicked, this, &SequenceView::onItemDoubleClick);
+    mTreeView = new QTreeView{this};
+    mTreeView->setModel(mModel);
+    mTreeView->setAlternatingRowColors(true);
+    mTreeView->setUniformRowHeights(true); // no per-row measurement
+    mTreeView->setSelectionBehavior(QAbstractItemView::SelectItems);
+    mTreeView->viewport()->installEventFilter(this);
+    mTreeView->setColumnWidth(0, 90); // ideal width for timestamp
+    mTreeView->setColumnWidth(1, 60); // ideal width for channel
+    connect(mTreeView, &QTreeView::doubleClicked, this, &SequenceView::onItemDoubleClick);
 
     mFamilySelectorButton = new QPushButton{"Types", this};
     mFamilySelectorButton->setToolTip("Filter by type");
@@ -237,10 +380,10 @@ SequenceView::SequenceView(QWidget *parent) : QWidget{parent} {
     connect(codecSelector, SIGNAL(currentIndexChanged(QString)), this, SLOT(onCodecChange(QString)));
     onCodecChange(codecSelector->currentText());
 
-    auto* expandButton = new ExpandButton{mTreeWidget};
-    auto* collapseButton = new CollapseButton{mTreeWidget};
+    auto* expandButton = new ExpandButton{mTreeView};
+    auto* collapseButton = new CollapseButton{mTreeView};
 
-    setLayout(make_vbox(margin_tag{0}, mTreeWidget, make_hbox(stretch_tag{}, mChannelSelectorButton, mFamilySelectorButton, codecSelector, expandButton, collapseButton)));
+    setLayout(make_vbox(margin_tag{0}, mTreeView, make_hbox(stretch_tag{}, mChannelSelectorButton, mFamilySelectorButton, codecSelector, expandButton, collapseButton)));
 }
 
 const TimedEvent& SequenceView::timedEvent(size_t index) const {
@@ -257,71 +400,33 @@ void SequenceView::setChannelEditor(ChannelEditor* channelEditor) {
 
 void SequenceView::setTrackFilter(Handler* handler) {
     mTrackFilter = handler;
+    mModel->setTrackCheckable(handler != nullptr);
 }
 
 void SequenceView::setCodec(QTextCodec* codec) {
     Q_ASSERT(codec);
     mCodec = codec;
-    // prevent itemChanged, we want it to be emitted for checkstate only :(
-    QSignalBlocker guard{mTreeWidget};
-    Q_UNUSED(guard);
-    for (auto* trackItem : makeChildRange(mTreeWidget->invisibleRootItem())) {
-        static_cast<SequenceViewTrackItem*>(trackItem)->updateEncoding();
-        for (auto* item : makeChildRange(trackItem))
-            static_cast<SequenceViewItem*>(item)->updateEncoding();
-    }
+    mModel->updateEncoding();
 }
 
 void SequenceView::setSequence(const SharedSequence& sequence) {
     Q_ASSERT(sequence);
-    setUpdatesEnabled(false);
-    // prevent signals
-    QSignalBlocker guard{this};
-    Q_UNUSED(guard);
-    // clean previous sequence
-    cleanSequence();
     // register sequence
     mSequence = sequence;
     mLimits = {0, sequence->last_timestamp()};
     // reenable all tracks
     if (mTrackFilter)
         mTrackFilter->send_message(TrackFilter::enable_all_ext());
-    // collect tracks data
-    std::unordered_map<track_t, channels_t> trackChannels;
-    std::unordered_map<track_t, QByteArrayList> trackNames;
-    for (const auto& item : *mSequence) {
-        if (item.event.is(families_t::voice()))
-            trackChannels[item.event.track()] |= item.event.channels();
-        else if (item.event.is(family_t::track_name))
-            trackNames[item.event.track()] << QByteArray::fromStdString(item.event.description());
-    }
-    // make track items
-    for (track_t track : mSequence->tracks()) {
-        auto* trackItem = makeTrackItem(track);
-        trackItem->setFirstColumnSpanned(true);
-        // track text
-        trackItem->setTrackNames(trackNames[track]);
-        // track filter enabled
-        if (mTrackFilter)
-            trackItem->setCheckState(0, Qt::Checked);
-        // background name
-        const auto channels = trackChannels[track];
-        trackItem->setData(0, Qt::UserRole, channels.to_integral());
-        setItemBackground(trackItem, channels);
-    }
-    // start filling events
-    mSequenceUpdater->start();
+    mModel->setSequence(sequence);
+    mModel->setTrackCheckable(mTrackFilter != nullptr);
+    // the reset clears spans, track names need the whole width
+    for (int row=0 ; row < mModel->rowCount() ; ++row)
+        mTreeView->setFirstColumnSpanned(row, QModelIndex{}, true);
+    updateItemsVisibility();
 }
 
 void SequenceView::cleanSequence() {
-    mEventCount = 0;
-    auto trackItems = mTreeWidget->invisibleRootItem()->takeChildren();
-    for(auto* trackItem : trackItems) {
-        mTrackReserve.emplace_back(static_cast<SequenceViewTrackItem*>(trackItem));
-        auto eventItems = trackItem->takeChildren();
-        for(auto* eventItem : eventItems)
-            mEventReserve.emplace_back(static_cast<SequenceViewItem*>(eventItem));
-    }
+    mModel->setSequence(nullptr);
     mSequence.reset();
 }
 
@@ -341,39 +446,18 @@ bool SequenceView::eventFilter(QObject* watched, QEvent* event) {
     return QWidget::eventFilter(watched, event);
 }
 
-void SequenceView::onSequenceUpdate() {
-    Q_ASSERT(mSequence);
-    const auto n = std::min(mEventCount + 64, mSequence->size());
-    while (mEventCount < n)
-        updateItemVisibility(makeEventItem(mEventCount++));
-    if (mEventCount == mSequence->size()) {
-        mSequenceUpdater->stop();
-        setUpdatesEnabled(true);
-    }
-}
-
 void SequenceView::onColorChange(channel_t channel, const QColor& /*color*/) {
-    for (auto* trackItem : makeChildRange(mTreeWidget->invisibleRootItem())) {
-        const auto channels = channels_t::from_integral(trackItem->data(0, Qt::UserRole).toUInt());
-        if (channels.test(channel))
-            setItemBackground(trackItem, channels);
-    }
+    mModel->updateBackground(channel);
 }
 
-void SequenceView::onItemChange(QTreeWidgetItem* item, int /*column*/) {
-    // called when root checkbox is clicked
-    auto* trackItem = dynamic_cast<SequenceViewTrackItem*>(item);
-    if (trackItem && mTrackFilter) {
-        const auto track = trackItem->track();
-        const bool checked = item->checkState(0) == Qt::Checked;
-        mTrackFilter->send_message(checked ? TrackFilter::enable_ext(track) : TrackFilter::disable_ext(track));
-    }
+void SequenceView::onTrackToggle(track_t track, bool enabled) {
+    if (mTrackFilter)
+        mTrackFilter->send_message(enabled ? TrackFilter::enable_ext(track) : TrackFilter::disable_ext(track));
 }
 
-void SequenceView::onItemDoubleClick(QTreeWidgetItem* item, int column) {
-    if (column == 0) // timestamp column
-        if (auto* eventItem = dynamic_cast<SequenceViewItem*>(item))
-            emit positionSelected(timedEvent(eventItem->index()).timestamp, mLastButton);
+void SequenceView::onItemDoubleClick(const QModelIndex& index) {
+    if (index.column() == 0 && mModel->isEvent(index)) // timestamp column
+        emit positionSelected(timedEvent(mModel->eventIndex(index)).timestamp, mLastButton);
 }
 
 void SequenceView::onFamilyFilterClick() {
@@ -404,51 +488,8 @@ void SequenceView::onCodecChange(const QString& name) {
     setCodec(QTextCodec::codecForName(name.toLocal8Bit()));
 }
 
-SequenceViewTrackItem* SequenceView::itemForTrack(track_t track) const {
-    for (auto* item : makeChildRange(mTreeWidget->invisibleRootItem())) {
-        auto* trackItem = static_cast<SequenceViewTrackItem*>(item);
-        if (trackItem->track() == track)
-            return trackItem;
-    }
-    return nullptr;
-}
-
-SequenceViewTrackItem* SequenceView::makeTrackItem(track_t track) {
-    if (mTrackReserve.empty())
-        return new SequenceViewTrackItem{track, this, mTreeWidget};
-    auto* result = mTrackReserve.back().release();
-    mTreeWidget->invisibleRootItem()->addChild(result);
-    result->setTrack(track);
-    mTrackReserve.pop_back();
-    return result;
-}
-
-SequenceViewItem* SequenceView::makeEventItem(size_t index) {
-    if (auto* trackItem = itemForTrack(timedEvent(index).event.track())) {
-        if (mEventReserve.empty())
-            return new SequenceViewItem{index, trackItem};
-        auto* result = mEventReserve.back().release();
-        trackItem->addChild(result); // assuming index is always larger than the previous one
-        result->setIndex(index);
-        mEventReserve.pop_back();
-        return result;
-    }
-    return nullptr;
-}
-
 void SequenceView::updateItemsVisibility() {
-    for (auto* trackItem : makeChildRange(mTreeWidget->invisibleRootItem()))
-        for (auto* item : makeChildRange(trackItem))
-            updateItemVisibility(static_cast<SequenceViewItem*>(item));
-}
-
-void SequenceView::updateItemVisibility(SequenceViewItem* item) {
-    item->updateVisibiliy(mFamilySelector->families(), mChannelsSelector->channels(), mLimits);
-}
-
-void SequenceView::setItemBackground(QTreeWidgetItem* item, channels_t channels) {
-    if (mChannelEditor)
-        item->setBackground(0, mChannelEditor->brush(channels, Qt::Horizontal));
+    mModel->updateFilter(mFamilySelector->families(), mChannelsSelector->channels(), mLimits);
 }
 
 //===============
@@ -465,9 +506,27 @@ const QFileInfo& FileItem::fileInfo() const {
     return mFileInfo;
 }
 
+std::future<NamedSequence> PlaylistItem::preloadSequence() {
+    std::promise<NamedSequence> promise;
+    promise.set_value(loadSequence());
+    return promise.get_future();
+}
+
 NamedSequence FileItem::loadSequence() {
-    auto file = dumping::read_file(mFileInfo.absoluteFilePath().toLocal8Bit().constData());
-    return {std::make_shared<Sequence>(Sequence::from_file(std::move(file))), text()};
+    return readSequence(mFileInfo, text());
+}
+
+std::future<NamedSequence> FileItem::preloadSequence() {
+    // the task only holds copies, the item may be deleted meanwhile
+    std::packaged_task<NamedSequence()> task{[fileInfo=mFileInfo, name=text()] { return readSequence(fileInfo, name); }};
+    auto sharedTask = std::make_shared<decltype(task)>(std::move(task));
+    backgroundPool().submit([sharedTask] { (*sharedTask)(); });
+    return sharedTask->get_future();
+}
+
+NamedSequence FileItem::readSequence(const QFileInfo& fileInfo, const QString& name) {
+    auto file = dumping::read_file(fileInfo.absoluteFilePath().toLocal8Bit().constData());
+    return {std::make_shared<Sequence>(Sequence::from_file(std::move(file))), name};
 }
 
 WriterItem::WriterItem(SequenceWriter* handler) : PlaylistItem{}, mHandler{handler} {
@@ -487,7 +546,7 @@ NamedSequence WriterItem::loadSequence() {
     return {std::make_shared<Sequence>(mHandler->load_sequence()), handlerName(mHandler)};
 }
 
-PlaylistTable::PlaylistTable(QWidget* parent) : QTableWidget{0, 2, parent} {
+PlaylistTable::PlaylistTable(QWidget* parent) : QTableWidget{0, 2, parent}, mLibrary{LibraryIndex::instance()} {
 
     setHorizontalHeaderLabels(QStringList{} << "Filename" << "Duration");
 
@@ -506,6 +565,9 @@ PlaylistTable::PlaylistTable(QWidget* parent) : QTableWidget{0, 2, parent} {
 
     setContextMenuPolicy(Qt::CustomContextMenu);
     connect(this, &PlaylistTable::customContextMenuRequested, this, &PlaylistTable::showMenu);
+    connect(mLibrary, &LibraryIndex::entriesUpdated, this, &PlaylistTable::onEntriesUpdated);
+    connect(mLibrary, &LibraryIndex::filesFound, this, &PlaylistTable::onFilesFound);
+    connect(mLibrary, &LibraryIndex::filesListed, this, &PlaylistTable::onFilesListed);
     auto* trigger = new MenuDefaultTrigger{this};
     mMenu = new QMenu{this};
     mMenu->setToolTipsVisible(true);
@@ -520,6 +582,7 @@ PlaylistTable::PlaylistTable(QWidget* parent) : QTableWidget{0, 2, parent} {
     mMenu->addAction(QIcon{":/data/random.svg"}, "Shuffle", this, SLOT(shuffle()));
     mMenu->addAction(QIcon{":/data/sort-ascending.svg"}, "Sort Ascending", this, SLOT(sortAscending()));
     mMenu->addAction(QIcon{":/data/sort-descending.svg"}, "Sort Descending", this, SLOT(sortDescending()));
+    mMenu->addAction(QIcon{":/data/sort-ascending.svg"}, "Sort By Duration", this, SLOT(sortByDuration()));
     mMenu->addSeparator();
     mMenu->addAction(QIcon{":/data/delete.svg"}, "Discard", this, SLOT(removeSelection()));
     mMenu->addAction(QIcon{":/data/trash.svg"}, "Discard All", this, SLOT(removeAllRows()));
@@ -531,14 +594,24 @@ void PlaylistTable::insertItem(PlaylistItem* playlistItem) {
 }
 
 void PlaylistTable::insertItem(int row, PlaylistItem* playlistItem) {
-    QTableWidgetItem* durationItem = new QTableWidgetItem;
-    durationItem->setText("*");
-    durationItem->setTextAlignment(Qt::AlignCenter);
+    insertRow(row);
+    setRowItem(row, playlistItem);
+    emit orderChanged();
+}
+
+void PlaylistTable::setRowItem(int row, PlaylistItem* playlistItem) {
+    auto* durationItem = new DurationItem;
     playlistItem->setFlags(playlistItem->flags() & ~Qt::ItemIsDropEnabled);
     durationItem->setFlags(durationItem->flags() & ~Qt::ItemIsDropEnabled);
-    insertRow(row);
     setItem(row, 0, playlistItem);
     setItem(row, 1, durationItem);
+    // files already indexed get their duration at once, others are scanned in the background
+    const LibraryEntry* entry = nullptr;
+    if (auto* fileItem = dynamic_cast<FileItem*>(playlistItem)) {
+        mFileItems.insert(fileItem->fileInfo().absoluteFilePath(), fileItem);
+        entry = mLibrary->request(fileItem->fileInfo());
+    }
+    updateRow(row, entry);
 }
 
 QStringList PlaylistTable::paths() const {
@@ -582,20 +655,24 @@ size_t PlaylistTable::addPath(const QFileInfo& fileInfo) {
 }
 
 size_t PlaylistTable::addFile(const QFileInfo& fileInfo) {
-    insertItem(new FileItem{fileInfo});
+    if (mPendingInsertions.empty())
+        insertItem(new FileItem{fileInfo});
+    else if (mPendingInsertions.back().token == 0)
+        mPendingInsertions.back().files.append(fileInfo);
+    else
+        mPendingInsertions.push_back({0, {fileInfo}, false});
     return 1;
 }
 
 size_t PlaylistTable::addDir(const QFileInfo& fileInfo, bool recurse) {
-    static const auto nameFilters = QStringList{} << "*.mid" << "*.midi" << "*.kar";
-    QDir dir{fileInfo.filePath()};
-    size_t count = 0;
-    for(const auto& info : dir.entryInfoList(nameFilters, QDir::Files))
-        count += addFile(info);
-    if (recurse)
-        for(const auto& info : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot))
-            count += addDir(info, true);
-    return count;
+    mPendingInsertions.push_back({mLibrary->list(fileInfo.filePath(), recurse), {}, false});
+    return 1;
+}
+
+void PlaylistTable::scrollToInsertions() {
+    for (auto& pending : mPendingInsertions)
+        pending.scroll = true;
+    scrollToBottom();
 }
 
 void PlaylistTable::setCurrentStatus(SequenceStatus status) {
@@ -613,43 +690,90 @@ bool PlaylistTable::isLoaded() const {
     return mCurrentItem;
 }
 
-NamedSequence PlaylistTable::loadRow(int row) {
+NamedSequence PlaylistTable::readRow(int row) {
     NamedSequence namedSequence;
     if (auto* playlistItem = dynamic_cast<PlaylistItem*>(item(row, 0))) {
         namedSequence = playlistItem->loadSequence();
-        if (isValid(namedSequence.sequence)) {
-            // change status
-            setCurrentStatus(NO_STATUS);
-            mCurrentItem = playlistItem;
-            // set duration
-            item(row, 1)->setText(qstringFromTimestamp(namedSequence.sequence->last_timestamp(), namedSequence.sequence, 1.));
-            // ensure line is visible
-            scrollToItem(playlistItem);
-        } else {
-            item(row, 1)->setText("\u00d8");
-        }
+        showSequence(playlistItem, namedSequence);
     }
     return namedSequence;
 }
 
-NamedSequence PlaylistTable::loadRelative(int offset, bool wrap) {
+void PlaylistTable::showSequence(PlaylistItem* playlistItem, const NamedSequence& namedSequence) {
+    auto* durationItem = static_cast<DurationItem*>(item(playlistItem->row(), 1));
+    if (isValid(namedSequence.sequence)) {
+        // set duration
+        const auto& sequence = *namedSequence.sequence;
+        durationItem->setDuration(sequence.clock().timestamp2time(sequence.last_timestamp()).count() * 1.e-6);
+    } else {
+        durationItem->setInvalid();
+    }
+}
+
+void PlaylistTable::activateRow(int row) {
+    if (auto* playlistItem = dynamic_cast<PlaylistItem*>(item(row, 0)))
+        activateItem(playlistItem);
+}
+
+void PlaylistTable::activateItem(PlaylistItem* playlistItem) {
+    // change status
+    setCurrentStatus(NO_STATUS);
+    mCurrentItem = playlistItem;
+    // ensure line is visible
+    scrollToItem(playlistItem);
+}
+
+PlaylistItem* PlaylistTable::peekItem(int offset, bool wrap) const {
+    const int rows = rowCount();
+    int row = mCurrentItem ? mCurrentItem->row() + offset : 0;
+    for (int i=0 ; i < rows ; ++i, row += offset) {
+        if (wrap)
+            row = safe_modulo(row, rows);
+        else if (row < 0 || row >= rows)
+            break;
+        if (!isRowHidden(row))
+            if (auto* playlistItem = dynamic_cast<PlaylistItem*>(item(row, 0)))
+                return playlistItem;
+    }
+    return nullptr;
+}
+
+NamedSequence PlaylistTable::loadRow(int row) {
+    auto namedSequence = readRow(row);
+    if (isValid(namedSequence.sequence))
+        activateRow(row);
+    return namedSequence;
+}
+
+std::pair<int, NamedSequence> PlaylistTable::peekRelative(int offset, bool wrap) {
     NamedSequence namedSequence;
     const int rows = rowCount(); // number of rows available
     int row = mCurrentItem ? mCurrentItem->row() + offset : 0; // next row to test
     if (wrap) { // with wrapping, we check all available rows (the current one may be reloaded)
         for (int i=0 ; i < rows ; ++i, row += offset) {
-            namedSequence = loadRow(safe_modulo(row, rows));
+            if (isRowHidden(safe_modulo(row, rows)))
+                continue;
+            namedSequence = readRow(safe_modulo(row, rows));
             if (isValid(namedSequence.sequence))
-                break;
+                return {safe_modulo(row, rows), std::move(namedSequence)};
         }
     } else { // without wrapping, we continue until the row is no longer valid
         for ( ; 0 <= row && row < rows ; row += offset) {
-            namedSequence = loadRow(row);
+            if (isRowHidden(row))
+                continue;
+            namedSequence = readRow(row);
             if (isValid(namedSequence.sequence))
-                break;
+                return {row, std::move(namedSequence)};
         }
     }
-    return namedSequence;
+    return {-1, std::move(namedSequence)};
+}
+
+NamedSequence PlaylistTable::loadRelative(int offset, bool wrap) {
+    auto next = peekRelative(offset, wrap);
+    if (isValid(next.second.sequence))
+        activateRow(next.first);
+    return std::move(next.second);
 }
 
 void PlaylistTable::setContext(Context* context) {
@@ -658,9 +782,15 @@ void PlaylistTable::setContext(Context* context) {
     connect(context, &Context::handlerRenamed, this, &PlaylistTable::renameHandler);
 }
 
+void PlaylistTable::setFilter(const QString& query) {
+    mFilter = LibraryFilter{query};
+    updateRows();
+    emit orderChanged();
+}
+
 void PlaylistTable::browseFiles() {
     if (addPaths(mContext->pathRetrieverPool()->get("midi")->getReadFiles(this)))
-        scrollToBottom();
+        scrollToInsertions();
 }
 
 void PlaylistTable::browseDirsShallow() {
@@ -673,10 +803,8 @@ void PlaylistTable::browseDirsDeep() {
 
 void PlaylistTable::browseDirs(bool recursive) {
     const auto dir = mContext->pathRetrieverPool()->get("midi")->getReadDir(this);
-    setUpdatesEnabled(false);
-    if (!dir.isNull() && addDir(QFileInfo{dir}, recursive) != 0)
-        scrollToBottom();
-    setUpdatesEnabled(true);
+    if (!dir.isNull() && addDir(QFileInfo{dir}, recursive))
+        scrollToInsertions();
 }
 
 void PlaylistTable::browseRecorders() {
@@ -721,6 +849,8 @@ void PlaylistTable::shuffle() {
     for (int r=0 ; r < rows ; r++)
         for (int c=0 ; c < cols ; c++)
             setItem(order[r], c, itemsCache[std::make_pair(r, c)]);
+    updateRows();
+    emit orderChanged();
 }
 
 void PlaylistTable::sortAscending() {
@@ -731,6 +861,10 @@ void PlaylistTable::sortDescending() {
     sortByColumn(0, Qt::DescendingOrder);
 }
 
+void PlaylistTable::sortByDuration() {
+    sortByColumn(1, Qt::AscendingOrder);
+}
+
 void PlaylistTable::removeSelection() {
     removeRows(selectedRows());
 }
@@ -761,6 +895,63 @@ void PlaylistTable::showMenu(const QPoint& point) {
     mMenu->exec(mapToGlobal(point));
 }
 
+void PlaylistTable::onEntriesUpdated(const QStringList& paths) {
+    setUpdatesEnabled(false);
+    for (const auto& path : paths)
+        for (auto it = mFileItems.constFind(path) ; it != mFileItems.constEnd() && it.key() == path ; ++it)
+            updateRow((*it)->row(), mLibrary->find((*it)->fileInfo()));
+    setUpdatesEnabled(true);
+    // metadata may change the visibility of rows
+    if (!mFilter.isEmpty())
+        emit orderChanged();
+}
+
+void PlaylistTable::onFilesFound(quint64 token, const QList<QFileInfo>& files) {
+    for (auto& pending : mPendingInsertions) {
+        if (pending.token == token) {
+            pending.files.append(files);
+            flushInsertions();
+            return;
+        }
+    }
+}
+
+void PlaylistTable::onFilesListed(quint64 token) {
+    for (auto& pending : mPendingInsertions) {
+        if (pending.token == token) {
+            pending.token = 0;
+            flushInsertions();
+            return;
+        }
+    }
+}
+
+void PlaylistTable::flushInsertions() {
+    QList<QFileInfo> files;
+    bool scroll = false;
+    while (!mPendingInsertions.empty()) {
+        auto& pending = mPendingInsertions.front();
+        files.append(pending.files);
+        pending.files.clear();
+        scroll |= pending.scroll;
+        // files of the following insertions must wait for the end of the listing
+        if (pending.token != 0)
+            break;
+        mPendingInsertions.pop_front();
+    }
+    if (files.empty())
+        return;
+    setUpdatesEnabled(false);
+    int row = rowCount();
+    setRowCount(row + files.size());
+    for (const auto& info : files)
+        setRowItem(row++, new FileItem{info});
+    setUpdatesEnabled(true);
+    emit orderChanged();
+    if (scroll)
+        scrollToBottom();
+}
+
 QStringList PlaylistTable::mimeTypes() const {
     return QTableWidget::mimeTypes() << "text/uri-list";
 }
@@ -769,7 +960,7 @@ void PlaylistTable::dropEvent(QDropEvent* event) {
     // drop from filesystem, sort urls as they are never ordered
     if (event->mimeData()->hasFormat("text/uri-list")) {
         if (addPaths(event->mimeData()->urls()))
-            scrollToBottom();
+            scrollToInsertions();
         event->accept();
         return;
     }
@@ -785,6 +976,14 @@ void PlaylistTable::dropEvent(QDropEvent* event) {
 void PlaylistTable::rowsAboutToBeRemoved(const QModelIndex& parent, int start, int end) {
     if (mCurrentItem && start <= mCurrentItem->row() && mCurrentItem->row() <= end)
         mCurrentItem = nullptr;
+    // moved rows have been taken and are empty
+    for (int row=start ; row <= end ; ++row) {
+        if (auto* playlistItem = dynamic_cast<PlaylistItem*>(item(row, 0))) {
+            if (auto* fileItem = dynamic_cast<FileItem*>(playlistItem))
+                mFileItems.remove(fileItem->fileInfo().absoluteFilePath(), fileItem);
+            emit itemAboutToBeRemoved(playlistItem);
+        }
+    }
     QTableWidget::rowsAboutToBeRemoved(parent, start, end);
 }
 
@@ -812,6 +1011,7 @@ void PlaylistTable::moveRows(std::vector<int> rows, int location) {
     }
     // remove inner rows
     removeRows(std::move(rows));
+    updateRows();
 }
 
 void PlaylistTable::removeRows(std::vector<int> rows) {
@@ -820,6 +1020,35 @@ void PlaylistTable::removeRows(std::vector<int> rows) {
         removeRow(row);
 }
 
+void PlaylistTable::updateRow(int row) {
+    const LibraryEntry* entry = nullptr;
+    if (auto* fileItem = dynamic_cast<FileItem*>(item(row, 0)))
+        entry = mLibrary->find(fileItem->fileInfo());
+    updateRow(row, entry);
+}
+
+void PlaylistTable::updateRow(int row, const LibraryEntry* entry) {
+    auto* playlistItem = item(row, 0);
+    if (!playlistItem)
+        return;
+    // the exact duration is known once the file has been loaded
+    if (entry && playlistItem != mCurrentItem) {
+        auto* durationItem = static_cast<DurationItem*>(item(row, 1));
+        if (entry->isValid())
+            durationItem->setDuration(entry->duration);
+        else
+            durationItem->setInvalid();
+    }
+    setRowHidden(row, !mFilter.accepts(playlistItem->text(), entry));
+}
+
+void PlaylistTable::updateRows() {
+    setUpdatesEnabled(false);
+    for (int row=0 ; row < rowCount() ; ++row)
+        updateRow(row);
+    setUpdatesEnabled(true);
+}
+
 int PlaylistTable::rowAt(const QPoint& pos) const {
     const auto index = indexAt(pos);
     // append item if it is dropped in the viewport
@@ -1135,9 +1364,9 @@ void Trackbar::setSequence(const SharedSequence& sequence) {
     mLastEdit->initialize(sequence, lastTimestamp, lastTimestamp);
     // reinitialize markers
     cleanMarkers();
-    for (const auto& item : *sequence)
-        if (item.event.is(family_t::marker))
-            addMarker(item.timestamp, QString::fromStdString(item.event.description()), false);
+    const auto index = sequence->index();
+    for (auto i : index->family(family_t::marker))
+        addMarker((*sequence)[i].timestamp, QString::fromStdString((*sequence)[i].event.description()), false);
 }
 
 void Trackbar::setDistorsion(double distorsion) {
@@ -1254,10 +1483,27 @@ Player::Player() : HandlerEditor{} {
 
     mPlaylist = new PlaylistTable{this};
     connect(mPlaylist, &PlaylistTable::itemActivated, this, &Player::launch);
+    // the preloaded item must follow the playlist
+    connect(mPlaylist, &PlaylistTable::orderChanged, this, &Player::updateNextSequence);
+    connect(mPlaylist->model(), &QAbstractItemModel::layoutChanged, this, &Player::updateNextSequence);
+    connect(mPlaylist->model(), &QAbstractItemModel::rowsRemoved, this, &Player::updateNextSequence);
+    connect(mPlaylist, &PlaylistTable::itemAboutToBeRemoved, this, &Player::forgetItem);
+
+    auto* playlistFilter = new QLineEdit{this};
+    playlistFilter->setClearButtonEnabled(true);
+    playlistFilter->setPlaceholderText("Filter (text, tempo>120, length<3:00, program:25, drums)");
+    connect(playlistFilter, &QLineEdit::textChanged, mPlaylist, &PlaylistTable::setFilter);
+
+    auto* playlistWidget = new QWidget{this};
+    playlistWidget->setLayout(make_vbox(margin_tag{0}, spacing_tag{0}, playlistFilter, mPlaylist));
 
     mSequenceView = new SequenceView{this};
     connect(mSequenceView, &SequenceView::positionSelected, this, &Player::onPositionSelected);
 
+    mPianoRoll = new PianoRoll{this};
+    mPianoRoll->setReader(&mHandler);
+    connect(mPianoRoll, &PianoRoll::positionSelected, this, &Player::onPositionSelected);
+
     mTracker = new Trackbar{this};
     connect(mTracker, &Trackbar::positionChanged, this, &Player::changePosition);
     connect(mTracker, &Trackbar::lowerChanged, this, &Player::changeLower);
@@ -1271,8 +1517,9 @@ Player::Player() : HandlerEditor{} {
     connect(mRefreshTimer, &QTimer::timeout, this, &Player::refreshPosition);
 
     auto* tab = new QTabWidget{this};
-    tab->addTab(mPlaylist, "Playlist");
+    tab->addTab(playlistWidget, "Playlist");
     tab->addTab(mSequenceView, "Events");
+    tab->addTab(mPianoRoll, "Roll");
 
     connect(makeAction(QIcon{":/data/media-step-backward.svg"}, "Play Previous", this), &QAction::triggered, this, &Player::playLastSequence);
     connect(makeAction(QIcon{":/data/media-play.svg"}, "Play", this), &QAction::triggered, this, &Player::playSequence);
@@ -1284,15 +1531,28 @@ Player::Player() : HandlerEditor{} {
     mMetronomeAction = makeAction(QIcon{":/data/metronome.svg"}, "Metronome", this);
     mMetronomeAction->setCheckable(true);
     connect(mMetronomeAction, &QAction::toggled, this, &Player::setMetronome);
+    auto* countInAction = makeAction(QIcon{":/data/metronome.svg"}, "Count In", this);
+    countInAction->setCheckable(true);
+    connect(countInAction, &QAction::toggled, this, &Player::setCountIn);
     makeSeparator(this);
     mLoopAction = new MultiStateAction{this};
     mLoopAction->addState(QIcon{":/data/move-down.svg"}, "No Loop"); /// @todo get a thinner arrow
     mLoopAction->addState(QIcon{":/data/loop-square.svg"}, "Loop");
+    mLoopAction->addState(QIcon{":/data/loop-square.svg"}, "Loop & Chase State");
+    connect(mLoopAction, &MultiStateAction::stateChanged, this, &Player::updateTransitions);
     addAction(mLoopAction);
     mModeAction = new MultiStateAction{this};
     mModeAction->addState(QIcon{":/data/lines.svg"}, "Play All");
     mModeAction->addState(QIcon{":/data/highlighted-lines.svg"}, "Play Current");
+    connect(mModeAction, &MultiStateAction::stateChanged, this, &Player::updateTransitions);
     addAction(mModeAction);
+    mSyncAction = new MultiStateAction{this};
+    mSyncAction->addState(QIcon{":/data/power-standby.svg"}, "Internal Clock");
+    mSyncAction->addState(QIcon{":/data/cloud-upload.svg"}, "Clock Master");
+    mSyncAction->addState(QIcon{":/data/cloud-download.svg"}, "Clock Slave");
+    connect(mSyncAction, &MultiStateAction::stateChanged, this, &Player::updateSync);
+    connect(mSyncAction, &QAction::hovered, this, &Player::showJitter); // statistics are only refreshed when looked at
+    addAction(mSyncAction);
     makeSeparator(this);
     connect(makeAction(QIcon{":/data/save.svg"}, "Save Current Sequence", this), &QAction::triggered, this, &Player::saveSequence);
 
@@ -1308,7 +1568,11 @@ bool Player::isSingle() const {
 }
 
 bool Player::isLooping() const {
-    return mLoopAction->state() == 1;
+    return mLoopAction->state() != 0;
+}
+
+bool Player::isChasing() const {
+    return mLoopAction->state() == 2;
 }
 
 HandlerView::Parameters Player::getParameters() const {
@@ -1341,6 +1605,7 @@ Handler* Player::getHandler() {
 
 void Player::updateContext(Context* context) {
     mSequenceView->setChannelEditor(context->channelEditor());
+    mPianoRoll->setChannelEditor(context->channelEditor());
     mPlaylist->setContext(context);
     context->quickToolBar()->addActions(actions());
 }
@@ -1389,6 +1654,9 @@ void Player::updatePosition() {
 
 void Player::refreshPosition() {
     updatePosition();
+    collectNextSequence();
+    if (followSequence())
+        updateNextSequence();
     if (mHandler.is_completed()) {
         playNextSequence();
     } else if (!mHandler.is_playing()) { // stopped by an event
@@ -1404,18 +1672,105 @@ void Player::refreshPosition() {
 bool Player::setSequence(NamedSequence sequence) {
     if (!isValid(sequence.sequence))
         return false;
+    showSequence(sequence);
+    mHandler.set_sequence(sequence.sequence);
+    updateTransitions();
+    return true;
+}
+
+void Player::showSequence(const NamedSequence& sequence) {
     if (auto* systemTrayIcon = context()->systemTrayIcon())
         showSystemTrayMessage(systemTrayIcon, handlerName(&mHandler), sequence.name, QIcon{":/data/media-play.svg"}, 2000);
     mTempoView->setSequence(sequence.sequence);
     mSequenceView->setSequence(sequence.sequence);
+    mPianoRoll->setSequence(sequence.sequence);
     mTracker->setSequence(sequence.sequence);
-    auto seq{*sequence.sequence};
-    if (mMetronomeAction->isChecked())
-        seq.insert_items(seq.make_metronome());
-    mHandler.set_sequence(std::move(seq));
+}
+
+void Player::updateTransitions() {
+    const bool single = isSingle();
+    mHandler.set_looping(single && isLooping());
+    mHandler.set_chasing(isChasing());
+    updateNextSequence();
+}
+
+void Player::updateNextSequence() {
+    // preload the next entry in the background so that the reader continues without gap
+    PlaylistItem* nextItem = nullptr;
+    if (!isSingle() && mPlaylist->isLoaded())
+        nextItem = mPlaylist->peekItem(1, isLooping());
+    if (nextItem == mNextItem)
+        return;
+    // the reader may have switched just before, it can't anymore once the call returns
+    mHandler.set_next_sequence(nullptr);
+    if (followSequence()) {
+        updateNextSequence(); // the current item changed
+        return;
+    }
+    mNextItem = nextItem;
+    mNextSequence = NamedSequence{};
+    mNextLoading = mNextItem ? mNextItem->preloadSequence() : std::future<NamedSequence>{};
+    collectNextSequence();
+}
+
+void Player::forgetItem(PlaylistItem* playlistItem) {
+    if (playlistItem != mNextItem)
+        return;
+    // views still follow the reader if it switched, rowsRemoved will preload the new next item
+    mNextItem = nullptr;
+    mHandler.set_next_sequence(nullptr);
+    if (!followSequence()) {
+        mNextSequence = NamedSequence{};
+        mNextLoading = {};
+    }
+}
+
+bool Player::followSequence() {
+    if (!mNextSequence.sequence || mHandler.sequence() != mNextSequence.sequence)
+        return false;
+    // the reader continued with the preloaded sequence, its item may have been removed meanwhile
+    if (mNextItem) {
+        mPlaylist->activateItem(mNextItem);
+        mPlaylist->setCurrentStatus(PLAYING);
+    }
+    showSequence(std::exchange(mNextSequence, NamedSequence{}));
+    mNextItem = nullptr;
+    mNextLoading = {};
     return true;
 }
 
+void Player::collectNextSequence() {
+    if (!mNextLoading.valid() || mNextLoading.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+        return;
+    auto namedSequence = mNextLoading.get();
+    mPlaylist->showSequence(mNextItem, namedSequence);
+    if (isValid(namedSequence.sequence)) {
+        mNextSequence = std::move(namedSequence);
+        mHandler.set_next_sequence(mNextSequence.sequence);
+    }
+}
+
+void Player::updateSync(int state) {
+    mHandler.set_sync(static_cast<SequenceReader::Sync>(state));
+    showJitter();
+}
+
+void Player::showJitter() {
+    const auto sync = mHandler.sync();
+    if (sync == SequenceReader::Sync::internal) {
+        mSyncAction->setToolTip(QString{}); // falls back to the text
+        return;
+    }
+    const auto jitter = sync == SequenceReader::Sync::master ? mHandler.master_jitter() : mHandler.slave_jitter();
+    const auto text = QString{"%1\n%2 pulses, jitter: %3 us (mean) %4 us (deviation) %5 us (max)"}
+        .arg(sync == SequenceReader::Sync::master ? "Clock Master" : "Clock Slave")
+        .arg(jitter.count)
+        .arg(jitter.mean, 0, 'f', 1)
+        .arg(jitter.deviation, 0, 'f', 1)
+        .arg(jitter.max, 0, 'f', 1);
+    mSyncAction->setToolTip(text);
+}
+
 void Player::saveSequence() {
     const auto seq = sequence();
     if (!isValid(seq)) {
@@ -1432,12 +1787,17 @@ void Player::saveSequence() {
 }
 
 void Player::setMetronome(bool enabled) {
-    if (isValid(sequence())) {
-        auto seq{*sequence()};
-        if (enabled)
-            seq.insert_items(seq.make_metronome());
-        mHandler.replace_sequence(std::move(seq));
-    }
+    if (enabled)
+        mHandler.insert_overlay(mMetronome);
+    else
+        mHandler.remove_overlay(mMetronome);
+}
+
+void Player::setCountIn(bool enabled) {
+    if (enabled)
+        mHandler.insert_overlay(mCountIn);
+    else
+        mHandler.remove_overlay(mCountIn);
 }
 
 void Player::launch(QTableWidgetItem* item) {
@@ -1476,7 +1836,7 @@ void Player::playCurrentSequence(bool resetStepping) {
 }
 
 void Player::pauseSequence() {
-    if (mHandler.stop_playing(Event::controller(channels_t::full(), controller_ns::all_sound_off_controller), false, false)) {
+    if (mHandler.stop_playing(SequenceReader::Silence::sounds, false, false)) {
         mIsStepping = false;
         mRefreshTimer->stop();
         mPlaylist->setCurrentStatus(PAUSED);
@@ -1484,7 +1844,7 @@ void Player::pauseSequence() {
 }
 
 void Player::resetSequence() {
-    mHandler.stop_playing(Event::reset(), true, true);
+    mHandler.stop_playing(SequenceReader::Silence::all, true, true);
     mIsStepping = false;
     mRefreshTimer->stop();
     mPlaylist->setCurrentStatus(STOPPED);
@@ -1504,8 +1864,8 @@ void Player::playLastSequence() {
 void Player::stepForward() {
     mIsStepping = false;
     const auto pos = mHandler.position();
-    const auto& seq = mHandler.sequence();
-    auto first = seq.begin(), last = seq.end();
+    const auto seq = mHandler.sequence();
+    auto first = seq->begin(), last = seq->end();
     for (auto it = std::lower_bound(first, last, pos) ; it != last ; ++it) {
         if (it->event.is(family_t::note_on)) {
             mNextStep = it->timestamp;
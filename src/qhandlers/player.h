@@ -21,16 +21,20 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef QHANDLERS_PLAYER_H
 #define QHANDLERS_PLAYER_H
 
+#include <deque>
+#include <future>
 #include <random>
 #include <QDoubleSpinBox>
 #include <QMenu>
 #include <QTableWidget>
 #include <QTextCodec>
 #include <QTimeEdit>
-#include <QTreeWidget>
+#include <QTreeView>
 #include "handlers/sequencereader.h"
 #include "handlers/sequencewriter.h"
 #include "qhandlers/common.h"
+#include "qhandlers/library.h"
+#include "qhandlers/pianoroll.h"
 #include "qtools/misc.h"
 
 using SharedSequence = std::shared_ptr<const Sequence>;
@@ -46,43 +50,59 @@ struct NamedSequence {
 
 class SequenceView;
 
-class SequenceViewTrackItem : public QTreeWidgetItem {
+/// Two-level model indexing directly into the shared sequence
+/// Top-level rows are tracks, their children are the visible events of that track
+/// Filters only walk precomputed columns (family, channels, timestamp), descriptions are formatted on demand
 
-public:
-    explicit SequenceViewTrackItem(track_t track, SequenceView* view, QTreeWidget* parent);
-
-    track_t track() const;
-    void setTrack(track_t track);
-
-    SequenceView* view() const;
-
-    void setTrackNames(const QByteArrayList& names);
-    void updateEncoding();
-
-private:
-    track_t mTrack;
-    SequenceView* mView;
-    QByteArray mRawText;
-
-};
+class SequenceModel : public QAbstractItemModel {
 
-class SequenceViewItem : public QTreeWidgetItem {
+    Q_OBJECT
 
 public:
-    explicit SequenceViewItem(size_t index, SequenceViewTrackItem* parent);
+    explicit SequenceModel(SequenceView* view);
 
-    SequenceView* view() const;
+    void setSequence(const SharedSequence& sequence);
+    void setTrackCheckable(bool checkable);
+    void updateFilter(families_t families, channels_t channels, const range_t<timestamp_t>& limits);
+    void updateEncoding();
+    void updateBackground(channel_t channel);
 
-    size_t index() const;
-    void setIndex(size_t index);
+    bool isEvent(const QModelIndex& index) const;
+    size_t eventIndex(const QModelIndex& index) const; /*!< precondition: isEvent(index) */
 
-    void updateEncoding();
-    void updateVisibiliy(families_t families, channels_t channels, const range_t<timestamp_t>& limits);
+    QModelIndex index(int row, int column, const QModelIndex& parent = {}) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = {}) const override;
+    int columnCount(const QModelIndex& parent = {}) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    bool setData(const QModelIndex& index, const QVariant& value, int role = Qt::EditRole) override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
 
-    QVariant data(int column, int role) const override;
+signals:
+    void trackToggled(track_t track, bool enabled);
 
 private:
-    size_t mIndex;
+    struct TrackData {
+        track_t track;
+        QByteArray rawName;
+        channels_t channels;
+        bool enabled {true};
+        std::vector<uint32_t> events; /*!< indices of all events in the track */
+        std::vector<uint32_t> visibleEvents; /*!< subset of events matching filters */
+    };
+
+    QVariant trackData(const TrackData& trackData, int column, int role) const;
+    QVariant eventData(size_t index, int column, int role) const;
+
+    SequenceView* mView;
+    SharedSequence mSequence;
+    bool mTrackCheckable {false};
+    std::vector<TrackData> mTracks;
+    // precomputed columns
+    std::vector<family_t> mFamilies;
+    std::vector<channels_t> mChannels;
+    std::vector<timestamp_t> mTimestamps;
 
 };
 
@@ -122,10 +142,9 @@ protected:
     bool eventFilter(QObject* watched, QEvent* event) override;
 
 private slots:
-    void onSequenceUpdate();
     void onColorChange(channel_t channel, const QColor& color);
-    void onItemChange(QTreeWidgetItem* item, int column);
-    void onItemDoubleClick(QTreeWidgetItem* item, int column);
+    void onTrackToggle(track_t track, bool enabled);
+    void onItemDoubleClick(const QModelIndex& index);
     void onFamilyFilterClick();
     void onChannelFilterClick();
     void onFamiliesChanged(families_t families);
@@ -133,31 +152,22 @@ private slots:
     void onCodecChange(const QString& name);
 
 private:
-    SequenceViewTrackItem* itemForTrack(track_t track) const;
-    SequenceViewTrackItem* makeTrackItem(track_t track);
-    SequenceViewItem* makeEventItem(size_t index);
     void updateItemsVisibility();
-    void updateItemVisibility(SequenceViewItem* item);
-    void setItemBackground(QTreeWidgetItem* item, channels_t channels);
 
 private:
-    QTreeWidget* mTreeWidget;
+    SequenceModel* mModel;
+    QTreeView* mTreeView;
     ChannelEditor* mChannelEditor {nullptr};
     FamilySelector* mFamilySelector;
     ChannelsSelector* mChannelsSelector;
     QPushButton* mFamilySelectorButton;
     QPushButton* mChannelSelectorButton;
-    QTimer* mSequenceUpdater; /*!< timer filling sequence event asynchronously */
     SharedSequence mSequence;
-    size_t mEventCount {0}; /*!< the number of event items properly initialized */
     QTextCodec* mCodec {QTextCodec::codecForLocale()};
     Handler* mTrackFilter {nullptr};
     double mDistorsion {1.};
     Qt::MouseButton mLastButton {Qt::NoButton};
     range_t<timestamp_t> mLimits {0., 0.};
-    std::vector<std::unique_ptr<SequenceViewTrackItem>> mTrackReserve;
-    std::vector<std::unique_ptr<SequenceViewItem>> mEventReserve;
-
 
 };
 
@@ -178,6 +188,7 @@ public:
     using QTableWidgetItem::QTableWidgetItem;
 
     virtual NamedSequence loadSequence() = 0;
+    virtual std::future<NamedSequence> preloadSequence(); /*!< loads the sequence in the background if possible, synchronously by default */
 
 };
 
@@ -189,8 +200,11 @@ public:
     const QFileInfo& fileInfo() const;
 
     NamedSequence loadSequence() override;
+    std::future<NamedSequence> preloadSequence() override;
 
 private:
+    static NamedSequence readSequence(const QFileInfo& fileInfo, const QString& name);
+
     QFileInfo mFileInfo;
 
 };
@@ -220,6 +234,8 @@ public:
     void insertItem(int row, PlaylistItem* playlistItem);
 
     QStringList paths() const;
+    /// adding paths returns the number of files inserted or pending,
+    /// files follow the listing of directories added before them so that the order is kept
     size_t addPaths(const QStringList& paths);
     size_t addPaths(QList<QUrl> urls);
 
@@ -227,17 +243,29 @@ public:
     size_t addPath(const QString& path);
     size_t addPath(const QFileInfo& fileInfo);
     size_t addFile(const QFileInfo& fileInfo);
-    size_t addDir(const QFileInfo& fileInfo, bool recurse = false);
+    size_t addDir(const QFileInfo& fileInfo, bool recurse = false); /*!< files are listed in the background, counts as one pending file */
+    void scrollToInsertions(); /*!< scroll to the bottom now and each time pending files are inserted */
 
     void setCurrentStatus(SequenceStatus status);
 
     bool isLoaded() const;
+    NamedSequence readRow(int row); /*!< load the sequence of the row without making it current */
+    void activateRow(int row); /*!< make the row current */
+    void activateItem(PlaylistItem* playlistItem);
+    void showSequence(PlaylistItem* playlistItem, const NamedSequence& sequence); /*!< update the duration of the item */
+    PlaylistItem* peekItem(int offset, bool wrap) const; /*!< next visible item, its sequence is not loaded */
     NamedSequence loadRow(int row);
+    std::pair<int, NamedSequence> peekRelative(int offset, bool wrap); /*!< like loadRelative but the current row is unchanged */
     NamedSequence loadRelative(int offset, bool wrap);
 
     void setContext(Context* context);
 
+signals:
+    void orderChanged(); /*!< items have been inserted, reordered or their visibility changed */
+    void itemAboutToBeRemoved(PlaylistItem* playlistItem); /*!< the item is deleted once its row is removed */
+
 public slots:
+    void setFilter(const QString& query); /*!< hides rows rejected by the filter, see LibraryFilter */
     void browseFiles();
     void browseDirsShallow();
     void browseDirsDeep();
@@ -246,6 +274,7 @@ public slots:
     void shuffle();
     void sortAscending();
     void sortDescending();
+    void sortByDuration();
     void removeSelection();
     void removeAllRows();
 
@@ -253,6 +282,9 @@ protected slots:
     void renameHandler(Handler* handler);
     void removeHandler(Handler* handler);
     void showMenu(const QPoint& point);
+    void onEntriesUpdated(const QStringList& paths);
+    void onFilesFound(quint64 token, const QList<QFileInfo>& files);
+    void onFilesListed(quint64 token);
 
 protected:
     QStringList mimeTypes() const override;
@@ -264,10 +296,25 @@ private:
     void moveRows(std::vector<int> rows, int location);
     void removeRows(std::vector<int> rows);
     int rowAt(const QPoint& pos) const;
+    void setRowItem(int row, PlaylistItem* playlistItem); /*!< fills an empty row */
+    void flushInsertions(); /*!< insert pending files up to the first listing still running */
+    void updateRow(int row);
+    void updateRow(int row, const LibraryEntry* entry);
+    void updateRows();
 
 private:
     Context* mContext {nullptr};
+    LibraryIndex* mLibrary;
+    LibraryFilter mFilter;
     PlaylistItem* mCurrentItem {nullptr};
+    QMultiHash<QString, FileItem*> mFileItems; /*!< rows of each file by absolute path */
+    struct PendingInsertion {
+        quint64 token; /*!< listing filling the files, 0 once complete */
+        QList<QFileInfo> files;
+        bool scroll;
+    };
+
+    std::deque<PendingInsertion> mPendingInsertions; /*!< files waiting for a listing, in order of addition */
     std::default_random_engine mRandomEngine;
     QMenu* mMenu;
 
@@ -460,6 +507,7 @@ public:
 
     bool isSingle() const; /*!< end the playlist after the current one */
     bool isLooping() const; /*!< restart from begining when playlist os over */
+    bool isChasing() const; /*!< restore the state of the loop point when looping */
 
     bool setNextSequence(int offset); /*!< returns true if a sequence has been set */
     bool setSequence(NamedSequence sequence); /*!< returns true if the sequence has been set */
@@ -476,6 +524,11 @@ protected:
 protected slots:
     void saveSequence();
     void setMetronome(bool enabled);
+    void setCountIn(bool enabled);
+    void updateTransitions(); /*!< configure looping & preload the next sequence */
+    void updateNextSequence(); /*!< preload the next item if it changed */
+    void forgetItem(PlaylistItem* playlistItem); /*!< stop referring to an item about to be deleted */
+    void updateSync(int state);
 
     void launch(QTableWidgetItem *item);
     void onPositionSelected(timestamp_t timestamp, Qt::MouseButton button);
@@ -498,19 +551,31 @@ protected slots:
     void refreshPosition();
 
 private:
+    void showSequence(const NamedSequence& sequence); /*!< update views with the sequence played */
+    void collectNextSequence(); /*!< give the preloaded sequence to the reader once ready */
+    bool followSequence(); /*!< update views if the reader continued with the preloaded sequence */
+    void showJitter(); /*!< update the tooltip of the sync action with the clock statistics */
+
     Trackbar* mTracker;
     TempoView* mTempoView;
     SequenceView* mSequenceView;
+    PianoRoll* mPianoRoll;
     PlaylistTable* mPlaylist;
     QTimer* mRefreshTimer;
     MultiStateAction* mModeAction;
     MultiStateAction* mLoopAction;
+    MultiStateAction* mSyncAction;
     QAction* mMetronomeAction;
 
     SequenceReader mHandler;
+    SequenceReader::overlay_type mMetronome {std::make_shared<MetronomeOverlay>()};
+    SequenceReader::overlay_type mCountIn {std::make_shared<CountInOverlay>()};
 
     bool mIsStepping {false};
     timestamp_t mNextStep;
+    PlaylistItem* mNextItem {nullptr}; /*!< item preloaded, cleared when it is removed */
+    std::future<NamedSequence> mNextLoading;
+    NamedSequence mNextSequence; /*!< sequence handed to the reader, kept until it switched or can't anymore */
 
 };
 
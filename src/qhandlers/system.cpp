@@ -28,7 +28,7 @@ public:
 
     QStringList instantiables() override {
         QStringList result;
-        mFactory.update();
+        mFactory.update(); // does not block, the cached list is returned meanwhile
         for (const auto& name : mFactory.available())
             result.append(QString::fromStdString(name));
         return result;
@@ -40,6 +40,10 @@ public:
         return proxy;
     }
 
+    bool isConcurrent() const override {
+        return true; // devices are opened independently
+    }
+
 private:
     SystemHandlerFactory mFactory;
 
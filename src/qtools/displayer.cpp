@@ -374,6 +374,18 @@ void SingleDisplayer::setWidget(QWidget* widget) {
     connect(mWidget, &QWidget::destroyed, this, &SingleDisplayer::deleteLaterRecursive);
 }
 
+QWidget* SingleDisplayer::takeWidget() {
+    auto* widget = mWidget;
+    if (widget) {
+        disconnect(widget, &QWidget::destroyed, this, &SingleDisplayer::deleteLaterRecursive);
+        layout()->removeWidget(widget);
+        widget->setParent(nullptr);
+        mWidget = nullptr;
+        deleteLaterRecursive();
+    }
+    return widget;
+}
+
 void SingleDisplayer::onPress() {
     mMove->setDown(false);
     drag();
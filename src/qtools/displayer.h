@@ -199,6 +199,7 @@ public:
 
     QWidget* widget();
     void setWidget(QWidget* widget);
+    QWidget* takeWidget(); /*!< removes the widget without deleting it, this displayer is deleted afterwards */
 
 private slots:
     void onPress();
@@ -204,7 +204,7 @@ void Graph::doLayout() {
 //======
 
 Edge::Edge(ArrowPolicy policy) :
-    mTail(nullptr), mHead(nullptr), mPolicy(policy), mColor(Qt::black), mArrowSize(5) {
+    mTail(nullptr), mHead(nullptr), mPolicy(policy), mColor(Qt::black), mWidth(1), mArrowSize(5) {
 
     setFlag(ItemIsSelectable);
     setFlag(ItemIsFocusable);
@@ -238,6 +238,17 @@ void Edge::setArrowColor(const QColor& color) {
     update();
 }
 
+qreal Edge::width() const {
+    return mWidth;
+}
+
+void Edge::setWidth(qreal width) {
+    if (qFuzzyCompare(mWidth, width))
+        return;
+    prepareGeometryChange();
+    mWidth = width;
+}
+
 const QString& Edge::label() const {
     return mLabel;
 }
@@ -317,7 +328,7 @@ void Edge::breakLink() {
 QRectF Edge::boundingRect() const {
     if (!isLinked())
         return {};
-    qreal penWidth = 5;
+    qreal penWidth = qMax(qreal(5), mWidth);
     qreal margin = (penWidth + mArrowSize) / 2.0;
     QRectF pathRect = mPath.controlPointRect().adjusted(-margin, -margin, margin, margin);
     return pathRect | mLabelRect;
@@ -325,14 +336,14 @@ QRectF Edge::boundingRect() const {
 
 QPainterPath Edge::shape() const {
     QPainterPathStroker stroker;
-    stroker.setWidth(5);
+    stroker.setWidth(qMax(qreal(5), mWidth));
     return stroker.createStroke(mPath);
 }
 
 void Edge::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*option*/, QWidget* /*widget*/) {
     if (isLinked()) {
         QBrush brush(mColor);
-        painter->setPen(QPen(brush, 1, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+        painter->setPen(QPen(brush, mWidth, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
         painter->drawPath(mPath);
         painter->setBrush(brush);
         // painter->setFont();
@@ -495,6 +506,17 @@ void Node::setLabel(const QString& label) {
     update();
 }
 
+const QString& Node::badge() const {
+    return mBadge;
+}
+
+void Node::setBadge(const QString& badge) {
+    if (mBadge == badge)
+        return;
+    mBadge = badge;
+    update();
+}
+
 void Node::setWidth(int width) {
     setSize(QSize(width, mRect.height()));
 }
@@ -550,6 +572,18 @@ void Node::paint(QPainter* painter, const QStyleOptionGraphicsItem* /*option*/,
     // aligned text with "color"
     painter->setPen(QPen(mColor, 0));
     painter->drawText(mRect, Qt::AlignCenter | Qt::TextWordWrap, mLabel);
+    // badge within the top-right corner so that edges are not affected
+    if (!mBadge.isEmpty()) {
+        QFont font = painter->font();
+        font.setPointSizeF(font.pointSizeF() * .7);
+        painter->setFont(font);
+        QRect badgeRect = QFontMetrics(font).boundingRect(mBadge).adjusted(-1, 0, 1, 0);
+        badgeRect.moveTopRight(mRect.topRight());
+        painter->setBrush(Qt::yellow);
+        painter->setPen(QPen(Qt::black, 0));
+        painter->drawRect(badgeRect);
+        painter->drawText(badgeRect, Qt::AlignCenter, mBadge);
+    }
 }
 
 void Node::mouseMoveEvent(QGraphicsSceneMouseEvent* event) {
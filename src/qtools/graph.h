@@ -127,6 +127,9 @@ public:
     const QColor& arrowColor() const;
     void setArrowColor(const QColor& color);
 
+    qreal width() const;
+    void setWidth(qreal width); /*!< width of the path, 1 by default */
+
     const QString& label() const;
     void setLabel(const QString& label);
 
@@ -165,6 +168,7 @@ private:
     QString mLabel;
     ArrowPolicy mPolicy;
     QColor mColor;
+    qreal mWidth;
     qreal mArrowSize;
     std::vector<QPointF> mControlPoints;
     // internal
@@ -229,6 +233,9 @@ public:
     const QString& label() const;
     void setLabel(const QString& label);
 
+    const QString& badge() const;
+    void setBadge(const QString& badge); /*!< small text drawn at the top-right corner, hidden if empty */
+
     enum { Type = UserType + 1 };
     int type() const override { return Type; }
 
@@ -247,6 +254,7 @@ private:
     void changeNode(Node* node);
 
     QString mLabel;
+    QString mBadge;
     QRect mRect;
     bool mIsConnecting;
     Node* mLastNode;
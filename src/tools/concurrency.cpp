@@ -19,6 +19,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "concurrency.h"
+#include <algorithm>
 #include <iostream>
 #include "trace.h"
 
@@ -117,3 +118,93 @@ void set_thread_priority(std::thread& thread, priority_t priority) {
 }
 
 #endif
+
+//==========
+// TaskPool
+//==========
+
+TaskPool::TaskPool(size_t workers) {
+    if (workers == 0)
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i=0 ; i < workers ; ++i)
+        m_workers.push_back(std::make_unique<Worker>());
+    for (size_t i=0 ; i < workers ; ++i)
+        m_threads.emplace_back([this, i] { run(i); });
+}
+
+TaskPool::~TaskPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> guard{m_mutex};
+        m_stopping = true;
+    }
+    m_task_available.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+size_t TaskPool::size() const {
+    return m_workers.size();
+}
+
+void TaskPool::submit(task_type task) {
+    std::lock_guard<std::mutex> guard{m_mutex};
+    auto& worker = *m_workers[m_next++ % m_workers.size()];
+    {
+        std::lock_guard<std::mutex> worker_guard{worker.mutex};
+        worker.tasks.push_back(std::move(task));
+    }
+    ++m_pending;
+    ++m_queued;
+    m_task_available.notify_one();
+}
+
+void TaskPool::wait() {
+    std::unique_lock<std::mutex> lock{m_mutex};
+    m_tasks_done.wait(lock, [this] { return m_pending == 0; });
+}
+
+bool TaskPool::pop(size_t index, task_type& task) {
+    // own tasks first, from the front
+    {
+        auto& worker = *m_workers[index];
+        std::lock_guard<std::mutex> guard{worker.mutex};
+        if (!worker.tasks.empty()) {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+            --m_queued;
+            return true;
+        }
+    }
+    // steal from the back of the others, starting with the next worker to spread contention
+    for (size_t offset=1 ; offset < m_workers.size() ; ++offset) {
+        auto& victim = *m_workers[(index + offset) % m_workers.size()];
+        std::lock_guard<std::mutex> guard{victim.mutex};
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            --m_queued;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::run(size_t index) {
+    task_type task;
+    while (true) {
+        if (pop(index, task)) {
+            task();
+            task = nullptr;
+            std::lock_guard<std::mutex> guard{m_mutex};
+            if (--m_pending == 0)
+                m_tasks_done.notify_all();
+            continue;
+        }
+        // nothing to steal, sleep until a task is submitted (m_queued is incremented under the lock)
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_task_available.wait(lock, [this] { return m_stopping || m_queued != 0; });
+        if (m_stopping && m_queued == 0)
+            return;
+    }
+}
@@ -26,6 +26,10 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <condition_variable>
 #include <mutex>
 #include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
 
 //==========
 // Priority
@@ -178,6 +182,8 @@ private:
  * The queue is considered busy while there are produced values that have not been consumed yet.
  *
  * 'produce' will return false if the queue was not busy before producing the value.
+ * Bounded producers may use 'size' and 'wait_for' to wait for the consumer,
+ * and give an admission callable to 'produce' to decide how the value enters the pending values.
  *
  * ContainerT may be any objects providing methods 'push_back', 'empty' and 'clear'.
  * It should also be swappable and default constructible.
@@ -194,6 +200,11 @@ public:
         return m_busy;
     }
 
+    size_t size() const { /*!< number of values waiting for the next consumption */
+        std::lock_guard<std::mutex> guard{m_mutex};
+        return m_frontend.size();
+    }
+
     template<typename U>
     bool produce(U&& value) {
         std::lock_guard<std::mutex> guard{m_mutex};
@@ -201,6 +212,22 @@ public:
         return std::exchange(m_busy, true);
     }
 
+    template<typename U, typename AdmitT>
+    bool produce(U&& value, AdmitT&& admit) { /*!< admit(container, value) is responsible for inserting (or not) the value */
+        std::lock_guard<std::mutex> guard{m_mutex};
+        admit(m_frontend, std::forward<U>(value));
+        return std::exchange(m_busy, true);
+    }
+
+    template<typename DurationT, typename PredicateT>
+    bool wait_for(const DurationT& timeout, PredicateT&& predicate) { /*!< waits until predicate(container) holds, checked after each consumption */
+        std::unique_lock<std::mutex> lock{m_mutex};
+        ++m_waiters;
+        const bool result = m_condition_variable.wait_for(lock, timeout, [&] { return predicate(m_frontend); });
+        --m_waiters;
+        return result;
+    }
+
     template<typename CallableT>
     void consume(CallableT&& callable) {
         while (stash()) {
@@ -213,6 +240,8 @@ public:
         using std::swap;
         std::lock_guard<std::mutex> guard{m_mutex};
         swap(m_frontend, m_backend);
+        if (m_waiters != 0)
+            m_condition_variable.notify_all();
         return ( m_busy = !m_backend.empty() );
     }
 
@@ -220,7 +249,57 @@ private:
     ContainerT m_frontend;
     ContainerT m_backend;
     bool m_busy {false};
+    size_t m_waiters {0};
     mutable std::mutex m_mutex;
+    std::condition_variable m_condition_variable;
+
+};
+
+//==========
+// TaskPool
+//==========
+
+/**
+ * A pool of threads executing independent tasks.
+ *
+ * Each worker owns a deque: tasks are distributed in a round-robin fashion,
+ * a worker pops its own tasks from the front and steals from the back of the others
+ * when it runs dry, so that a few long tasks do not leave the other threads idle.
+ *
+ * Tasks must not throw, the pool is stopped and joined on destruction after remaining tasks are done.
+ */
+
+class TaskPool {
+
+public:
+    using task_type = std::function<void()>;
+
+    explicit TaskPool(size_t workers = 0); /*!< 0 means one worker per hardware thread */
+    ~TaskPool();
+
+    size_t size() const;
+
+    void submit(task_type task);
+    void wait(); /*!< blocks until all submitted tasks are done */
+
+private:
+    struct Worker {
+        std::deque<task_type> tasks;
+        std::mutex mutex;
+    };
+
+    bool pop(size_t index, task_type& task);
+    void run(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    size_t m_next {0}; /*!< worker receiving the next task */
+    size_t m_pending {0}; /*!< tasks submitted and not finished yet */
+    std::atomic<size_t> m_queued {0}; /*!< tasks submitted and not popped yet */
+    bool m_stopping {false};
+    std::mutex m_mutex;
+    std::condition_variable m_task_available;
+    std::condition_variable m_tasks_done;
 
 };
 
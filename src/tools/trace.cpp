@@ -18,12 +18,201 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 */
 
+#include <array>
+#include <tuple>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cstdlib>
 #include "trace.h"
 
-std::recursive_mutex logging_tools::mutex;
+namespace {
+
+using record_type = std::tuple<logging_tools::level_type, std::string, size_t>;
+
+void write_record(const record_type& record) {
+    std::cout << '[' << std::get<0>(record) << "] " << std::get<1>(record);
+    if (std::get<2>(record))
+        std::cout << " (" << std::get<2>(record) << " similar messages suppressed)";
+    std::cout << '\n';
+}
+
+//======
+// Ring
+//======
+
+/// single-producer single-consumer ring owned by a thread
+
+struct ring_t {
+
+    bool push(record_type&& record) {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        const auto next = (tail + 1) % m_records.size();
+        if (next == m_head.load(std::memory_order_acquire))
+            return false;
+        m_records[tail] = std::move(record);
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(record_type& record) {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        record = std::move(m_records[head]);
+        m_head.store((head + 1) % m_records.size(), std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<record_type, logging_tools::ring_capacity + 1> m_records;
+    std::atomic<size_t> m_head {0};
+    std::atomic<size_t> m_tail {0};
+
+};
+
+//=========
+// Backend
+//=========
+
+/// the backend is never destroyed so that traces emitted during static destruction remain valid
+/// once stopped at exit, records are written synchronously
+
+struct backend_t {
+
+    static backend_t& instance() {
+        static auto backend = new backend_t;
+        return *backend;
+    }
+
+    backend_t() : m_worker{[this] { run(); }} {
+        std::atexit([] { instance().stop(); });
+    }
+
+    std::shared_ptr<ring_t> attach() {
+        auto ring = std::make_shared<ring_t>();
+        std::lock_guard<std::mutex> guard{m_rings_mutex};
+        m_rings.push_back(ring);
+        return ring;
+    }
+
+    void push(ring_t& ring, record_type&& record) {
+        if (!m_running.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard{m_drain_mutex};
+            write_record(record);
+            std::cout.flush();
+        } else if (!ring.push(std::move(record))) {
+            m_pending_drops.fetch_add(1, std::memory_order_relaxed);
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void drain() {
+        std::lock_guard<std::mutex> drain_guard{m_drain_mutex};
+        bool written = false;
+        record_type record;
+        {
+            std::lock_guard<std::mutex> guard{m_rings_mutex};
+            for (auto it = m_rings.begin() ; it != m_rings.end() ; ) {
+                // checked before draining, a thread may push its last records while exiting
+                const bool orphan = it->use_count() == 1;
+                while ((*it)->pop(record)) {
+                    write_record(record);
+                    written = true;
+                }
+                if (orphan)
+                    it = m_rings.erase(it);
+                else
+                    ++it;
+            }
+        }
+        if (auto drops = m_pending_drops.exchange(0, std::memory_order_relaxed)) {
+            write_record(record_type{logging_tools::level_type::warning, std::to_string(drops) + " messages dropped", 0});
+            written = true;
+        }
+        if (written)
+            std::cout.flush();
+    }
+
+    size_t dropped() const {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    void run() {
+        while (m_running.load(std::memory_order_acquire)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds{10});
+            drain();
+        }
+    }
+
+    void stop() {
+        m_running.store(false, std::memory_order_release);
+        if (m_worker.joinable())
+            m_worker.join();
+        drain();
+    }
+
+    std::mutex m_rings_mutex; /*!< guards the list of rings */
+    std::mutex m_drain_mutex; /*!< ensures rings have a single consumer */
+    std::vector<std::shared_ptr<ring_t>> m_rings;
+    std::atomic<size_t> m_pending_drops {0};
+    std::atomic<size_t> m_dropped {0};
+    std::atomic<bool> m_running {true};
+    std::thread m_worker;
+
+};
+
+}
+
+//===============
+// logging_tools
+//===============
+
+constexpr size_t logging_tools::ring_capacity;
+constexpr size_t logging_tools::rate_limit;
+constexpr size_t logging_tools::limiter_slots;
 
 bool logging_tools::enable = true;
 
+bool logging_tools::limiter_type::acquire(level_type level, const std::string& text, size_t& suppressed) {
+    const auto key = std::hash<std::string>{}(text);
+    auto& slot = m_slots[key % limiter_slots];
+    const auto window = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    // another text takes over the slot, its counters start afresh and copies discarded so far are reported
+    auto current_key = slot.key.load(std::memory_order_relaxed);
+    if (current_key != key && slot.key.compare_exchange_strong(current_key, key, std::memory_order_relaxed)) {
+        slot.window.store(window, std::memory_order_relaxed);
+        slot.count.store(0, std::memory_order_relaxed);
+        if (auto evicted = slot.suppressed.exchange(0, std::memory_order_relaxed))
+            push(level, std::to_string(evicted) + " similar messages suppressed");
+    }
+    auto current = slot.window.load(std::memory_order_relaxed);
+    if (current != window && slot.window.compare_exchange_strong(current, window, std::memory_order_relaxed))
+        slot.count.store(0, std::memory_order_relaxed);
+    if (slot.count.fetch_add(1, std::memory_order_relaxed) < rate_limit) {
+        suppressed = slot.suppressed.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void logging_tools::push(level_type level, std::string text, size_t suppressed) {
+    auto& backend = backend_t::instance();
+    thread_local auto ring = backend.attach();
+    backend.push(*ring, record_type{level, std::move(text), suppressed});
+}
+
+void logging_tools::flush() {
+    backend_t::instance().drain();
+}
+
+size_t logging_tools::dropped() {
+    return backend_t::instance().dropped();
+}
+
 std::ostream& operator<<(std::ostream& os, logging_tools::level_type level) {
     switch (level) {
     case logging_tools::level_type::debug: os << "debug"; break;
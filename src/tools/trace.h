@@ -21,14 +21,29 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef TOOLS_TRACE_H
 #define TOOLS_TRACE_H
 
+#include <array>
 #include <iostream>
-#include <mutex>
+#include <sstream>
+#include <atomic>
 #include <chrono>
 
 //========
 // Traces
 //========
 
+/**
+ * Traces are formatted on the calling thread but never written there:
+ * each thread pushes its records into its own fixed-size ring buffer,
+ * and a background thread drains all rings and writes them to std::cout.
+ * A full ring drops the record and increments a counter reported later,
+ * so a burst of traces on a realtime thread never blocks on terminal I/O.
+ *
+ * Repeated records are also rate limited: each call site keeps a small table
+ * of recent texts, extra copies of a text are counted and the count is appended
+ * to the next copy emitted, or reported alone if another text evicts it first.
+ * Distinct texts from the same site are not limited.
+ */
+
 struct logging_tools {
 
     enum class level_type {
@@ -40,16 +55,52 @@ struct logging_tools {
 
     friend std::ostream& operator<<(std::ostream& os, level_type level);
 
+    static constexpr size_t ring_capacity = 256; /*!< number of pending records per thread */
+    static constexpr size_t rate_limit = 10; /*!< maximum number of identical records per second per call site */
+    static constexpr size_t limiter_slots = 16; /*!< texts tracked per call site, colliding texts evict each other */
+
+    class limiter_type {
+
+    public:
+        bool acquire(level_type level, const std::string& text, size_t& suppressed); /*!< returns false if the text exceeded its rate, suppressed is set to the number of copies previously discarded */
+
+    private:
+        struct slot_type {
+            std::atomic<size_t> key {0}; /*!< hash of the text */
+            std::atomic<long long> window {0};
+            std::atomic<size_t> count {0};
+            std::atomic<size_t> suppressed {0};
+        };
+
+        std::array<slot_type, limiter_slots> m_slots;
+
+    };
+
+    static void push(level_type level, std::string text, size_t suppressed = 0);
+    static void flush(); /*!< synchronously writes all pending records */
+    static size_t dropped(); /*!< number of records discarded because of full rings */
+
     static bool enable;
-    static std::recursive_mutex mutex;
 
 };
 
+#define TRACE_PUSH(level, suppressed, ...)\
+    do {\
+        std::ostringstream __trace_stream;\
+        __trace_stream << __VA_ARGS__;\
+        logging_tools::push(logging_tools::level_type::level, __trace_stream.str(), suppressed);\
+    } while (false)
+
 #define TRACE(level, ...)\
     do {\
         if (logging_tools::enable) {\
-            std::lock_guard<std::recursive_mutex> __trace_lock(logging_tools::mutex);\
-            std::cout << '[' << logging_tools::level_type::level << "] " << __VA_ARGS__ << std::endl;\
+            static logging_tools::limiter_type __trace_limiter;\
+            std::ostringstream __trace_stream;\
+            __trace_stream << __VA_ARGS__;\
+            auto __trace_text = __trace_stream.str();\
+            size_t __trace_suppressed = 0;\
+            if (__trace_limiter.acquire(logging_tools::level_type::level, __trace_text, __trace_suppressed))\
+                logging_tools::push(logging_tools::level_type::level, std::move(__trace_text), __trace_suppressed);\
         }\
     } while (false)
 
@@ -67,7 +118,8 @@ struct measure_t {
     inline ~measure_t() {
         auto t1 = clock_type::now();
         auto dt = std::chrono::duration_cast<duration_type>(t1-t0);
-        TRACE(debug, text << ": " << dt.count() << " ms");
+        if (logging_tools::enable)
+            TRACE_PUSH(debug, 0, text << ": " << dt.count() << " ms"); // measures share the same call site, they must not be rate limited
     }
 
     const char* text;